@@ -1069,7 +1069,7 @@ void clock_init(void)
 #endif
 }
 
-#ifdef CONFIG_SECURE_BOOT
+#if defined(CONFIG_SECURE_BOOT) || defined(CONFIG_FSL_CAAM)
 void hab_caam_clock_enable(unsigned char enable)
 {
 	if (enable)
@@ -14,6 +14,7 @@
 #include <asm/imx-common/hab.h>
 #include <asm/arch/crm_regs.h>
 #include <dm.h>
+#include <fsl_sec.h>
 #include <imx_thermal.h>
 
 #if defined(CONFIG_IMX_THERMAL)
@@ -197,6 +198,21 @@ int arch_cpu_init(void)
 	return 0;
 }
 
+#ifdef CONFIG_ARCH_MISC_INIT
+int arch_misc_init(void)
+{
+#ifdef CONFIG_FSL_CAAM
+	/* Job ring and RNG need malloc(), so not from arch_cpu_init() */
+	hab_caam_clock_enable(1);
+	/* On failure hw_sha1()/hw_sha256() hash in software */
+	if (sec_init())
+		puts("CAAM: not available, hashing in software\n");
+#endif
+
+	return 0;
+}
+#endif
+
 #ifdef CONFIG_SERIAL_TAG
 void get_board_serial(struct tag_serialnr *serialnr)
 {
@@ -100,6 +100,16 @@ ulong get_timer(ulong base)
 	return get_timer_masked() - base;
 }
 
+/* Microseconds since the system counter started, for bootstage */
+ulong timer_get_boot_us(void)
+{
+	unsigned long long us = get_ticks() * 1000000ULL;
+
+	do_div(us, get_tbclk());
+
+	return us;
+}
+
 void __udelay(unsigned long usec)
 {
 	unsigned long long tmp;
@@ -166,6 +166,8 @@
 #define SAI3_IPS_BASE_ADDR              (AIPS_TZ3_BASE_ADDR+0xC0000)
 #define SPBA_IPS_BASE_ADDR              (AIPS_TZ3_BASE_ADDR+0xF0000)
 #define CAAM_IPS_BASE_ADDR              (AIPS_TZ3_BASE_ADDR+0x100000)
+#define CONFIG_SYS_FSL_SEC_ADDR         CAAM_IPS_BASE_ADDR
+#define CONFIG_SYS_FSL_JR0_ADDR         (CAAM_IPS_BASE_ADDR+0x1000)
 
 /* AIPS_TZ#3- On Platform */
 #define AIPS3_ON_BASE_ADDR              (AIPS_TZ3_BASE_ADDR+0x1F0000)
@@ -154,6 +154,7 @@ static iomux_v3_cfg_t const usdhc1_pads[] = {
 
 	MX7D_PAD_SD1_CD_B__SD1_CD_B | MUX_PAD_CTRL(USDHC_PAD_CTRL),
 	MX7D_PAD_SD1_RESET_B__GPIO5_IO2 | MUX_PAD_CTRL(USDHC_PAD_CTRL),
+	MX7D_PAD_GPIO1_IO08__SD1_VSELECT | MUX_PAD_CTRL(USDHC_PAD_CTRL),
 };
 
 static iomux_v3_cfg_t const usdhc3_emmc_pads[] = {
@@ -435,8 +436,8 @@ static void setup_iomux_uart(void)
 #define USDHC3_PWR_GPIO IMX_GPIO_NR(6, 11)
 
 static struct fsl_esdhc_cfg usdhc_cfg[3] = {
-	{USDHC1_BASE_ADDR, 0, 4},
-	{USDHC3_BASE_ADDR},
+	{USDHC1_BASE_ADDR, 0, 4, 1},	/* microSD, UHS-I through SD1_VSELECT */
+	{USDHC3_BASE_ADDR, 0, 0, 1},	/* eMMC on 1.8V VCCQ, HS200 */
 };
 
 static int mmc_get_env_devno(void)
@@ -482,6 +483,49 @@ int board_mmc_getcd(struct mmc *mmc)
 	return ret;
 }
 
+#ifdef CONFIG_POWER
+int board_mmc_set_signal_voltage(struct mmc *mmc, uint voltage)
+{
+	struct fsl_esdhc_cfg *cfg = (struct fsl_esdhc_cfg *)mmc->priv;
+	struct pmic *p;
+	unsigned int reg;
+
+	if (cfg->esdhc_base != USDHC1_BASE_ADDR)
+		return 0;
+
+	/*
+	 * SD1_VSELECT drives the VSD_VSEL pin of the PFUZE3000, so VCCSD
+	 * follows the uSDHC between its 3.3V and 1.8V ranges. Only make sure
+	 * the regulator is really there and give it time to settle.
+	 */
+	p = pmic_get("PFUZE3000");
+	if (!p || pmic_reg_read(p, PFUZE3000_VCC_SDCTL, &reg))
+		return -ENODEV;
+
+	debug("VCCSD: ctl 0x%x, going to %s\n", reg,
+	      voltage == MMC_SIGNAL_VOLTAGE_180 ? "1.8V" : "3.3V");
+	udelay(1000);
+
+	return 0;
+}
+#endif
+
+int board_mmc_power_cycle(struct mmc *mmc)
+{
+	struct fsl_esdhc_cfg *cfg = (struct fsl_esdhc_cfg *)mmc->priv;
+
+	if (cfg->esdhc_base != USDHC1_BASE_ADDR)
+		return -ENOSYS;
+
+	/* SD1_RESET_B switches VCC_SD; let it drain before powering up */
+	gpio_direction_output(USDHC1_PWR_GPIO, 0);
+	mdelay(10);
+	gpio_direction_output(USDHC1_PWR_GPIO, 1);
+	mdelay(10);
+
+	return 0;
+}
+
 int board_mmc_init(bd_t *bis)
 {
 	int i, ret;
@@ -22,6 +22,7 @@ DECLARE_GLOBAL_DATA_PTR;
 struct bootstage_record {
 	ulong time_us;
 	uint32_t start_us;
+	ulong bytes;		/* bytes moved by an accumulated activity */
 	const char *name;
 	int flags;		/* see enum bootstage_flags */
 	enum bootstage_id id;
@@ -150,6 +151,23 @@ uint32_t bootstage_accum(enum bootstage_id id)
 	return duration;
 }
 
+uint32_t bootstage_accum_bytes(enum bootstage_id id, ulong bytes)
+{
+	record[id].bytes += bytes;
+
+	return bootstage_accum(id);
+}
+
+uint32_t bootstage_get_accum(enum bootstage_id id, ulong *bytes)
+{
+	struct bootstage_record *rec = &record[id];
+
+	if (bytes)
+		*bytes = rec->bytes;
+
+	return rec->start_us ? rec->time_us : 0;
+}
+
 /**
  * Get a record name as a printable string
  *
@@ -245,6 +263,10 @@ static int add_bootstages_devicetree(struct fdt_header *blob)
 				rec->start_us ? "accum" : "mark",
 				rec->time_us))
 			return -1;
+
+		if (rec->bytes &&
+		    fdt_setprop_cell(blob, node, "bytes", rec->bytes))
+			return -1;
 	}
 
 	return 0;
@@ -52,7 +52,6 @@ unsigned char test_pattern_byte[6] = {0x00, 0x55, 0x5A, 0xAA, 0xA5, 0xFF};
 unsigned short test_pattern_short[6] = {0x0000, 0x5555, 0x5A5A, 0xAAAA, 0xA5A5, 0xFFFF};
 unsigned long test_pattern_long[6] = {0x00000000, 0x55555555, 0x5A5A5A5A, 0xAAAAAAAA, 0xA5A5A5A5, 0xFFFFFFFF};
 int usb_init_state = 0;
-extern unsigned  int fw_tftp_size;
 extern int usb_signal_init(struct usb_device *dev, struct _rf_info *rf_info, int init_state);
 void diag_do_nothing(void){printf("\r\nNot Support!\r\n");return;}
 board_infos sys_info;
@@ -169,6 +168,9 @@ void diag_do_set_OS_cmdline(void)
 burnin_cmd BIOS_config_cmd_value [] = {
         {1, 1, "TPM2 Setting", diag_do_tpm2_config, 1},
 	{1, 1, "Update Firmware from Tftp", diag_do_tftp_download_firmware, 1},
+#ifdef CONFIG_MOXA_HTTP_UPGRADE
+	{1, 1, "Update Firmware from Http", diag_do_http_download_firmware, 1},
+#endif
         {1, 1, "Set OS cmdline", diag_do_set_OS_cmdline, 1},
 	{1, 1, "Go To OS", diag_do_run_mmc_func, BIOS_ITEM_FOR_BASIC_FUNC},
  	{99, 'q', "UBoot Command Line", diag_do_uboot, BIOS_ITEM_FOR_BASIC_FUNC},	
@@ -451,7 +453,7 @@ int bios_manual_config(burnin_cmd *cmd_list)
 	return ret;
 }
 
-int do_tftp_download_firmware (void)
+static int do_net_download_firmware (int (*download)(char *fw_name))
 {
 	char *fw_name = "firmware.img";
 	int ret = 0;
@@ -489,7 +491,7 @@ int do_tftp_download_firmware (void)
 
 	printf ("\n");
 
-	ret = tftp_download_firmware(buf);
+	ret = download(buf);
 
 EXIT:
 
@@ -497,27 +499,49 @@ EXIT:
 
 }
 
-void diag_do_tftp_download_firmware (void)
+int do_tftp_download_firmware (void)
 {
-	int ret = 0;
-
-	ret = do_tftp_download_firmware();
-
+	return do_net_download_firmware(tftp_download_firmware);
+}
 
+static void diag_print_download_result (const char *proto, int ret)
+{
 	printf("**************************************************\n");
 	printf("*                                                *\n");
 	
 	if(ret)
-		printf("*          TFTP FIRMWARE file transfer fail.     *\n");
+		printf("*          %s FIRMWARE file transfer fail.     *\n", proto);
         else
-		printf("*          TFTP FIRMWARE file transfer success   *\n");
+		printf("*          %s FIRMWARE file transfer success   *\n", proto);
 	
 	printf("*                                                *\n");
 	printf("**************************************************\n");
+}
+
+void diag_do_tftp_download_firmware (void)
+{
+	int ret = 0;
+
+	ret = do_tftp_download_firmware();
+
+	diag_print_download_result("TFTP", ret);
 
 	return;
 }
 
+#ifdef CONFIG_MOXA_HTTP_UPGRADE
+void diag_do_http_download_firmware (void)
+{
+	int ret = 0;
+
+	ret = do_net_download_firmware(http_download_firmware);
+
+	diag_print_download_result("HTTP", ret);
+
+	return;
+}
+#endif
+
 int do_get_hw_verison(char *s) {
 
 	i2c_set_bus_num(0);
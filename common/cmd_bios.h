@@ -50,7 +50,6 @@
 #define DATA_PATTERN4			(0x00000000L)
 #define DATA_PATTERN5			(0xFFFFFFFFL)		// *** Be careful !
 
-#define EMMC_COPY_LIMIT_SIZE		31457280        
 #define MAX_SIZE_16BYTE			16
 #define MAX_SIZE_32BYTE			32
 #define MAX_SIZE_64BYTE			64
@@ -249,6 +248,7 @@ void diag_do_extend_usb_port_control(void);
 int diag_do_uart_232_RTS_CTS_test (void);
 void diag_do_copy_download_firmware_to_emmc(void);
 void diag_do_tftp_download_firmware(void);
+void diag_do_http_download_firmware(void);
 // ----------- WDT Menu --------------
 void diag_do_wdt_func (void);
 int OLED_Test(void);
@@ -8,6 +8,7 @@
 #include <common.h>
 #include <command.h>
 #include <console.h>
+#include <malloc.h>
 #include <mmc.h>
 
 static int curr_device = -1;
@@ -72,8 +73,33 @@ U_BOOT_CMD(
 );
 #else /* !CONFIG_GENERIC_MMC */
 
+/* Time a read from the start of the card, in KiB/s */
+static ulong mmc_read_speed(struct mmc *mmc)
+{
+	lbaint_t blks = (4 << 20) / mmc->read_bl_len;
+	ulong start, ms;
+	void *buf;
+
+	if (blks > mmc->block_dev.lba)
+		blks = mmc->block_dev.lba;
+
+	buf = memalign(ARCH_DMA_MINALIGN, blks * mmc->read_bl_len);
+	if (!buf)
+		return 0;
+
+	start = get_timer(0);
+	if (mmc->block_dev.block_read(mmc->block_dev.dev, 0, blks, buf) != blks)
+		blks = 0;
+	ms = max(get_timer(start), 1UL);
+
+	free(buf);
+
+	return blks * (mmc->read_bl_len / 512) * 500 / ms;
+}
+
 static void print_mmcinfo(struct mmc *mmc)
 {
+	ulong speed;
 	int i;
 
 	printf("Device: %s\n", mmc->cfg->name);
@@ -99,10 +125,21 @@ static void print_mmcinfo(struct mmc *mmc)
 
 	printf("Bus Width: %d-bit%s\n", mmc->bus_width,
 			mmc->ddr_mode ? " DDR" : "");
+	printf("Bus Mode: %s, %d MHz\n", mmc_mode_name(mmc),
+			mmc->clock / 1000000);
+	speed = mmc_read_speed(mmc);
+	if (speed)
+		printf("Read Speed: %lu.%02lu MB/s\n", speed / 1024,
+				(speed % 1024) * 100 / 1024);
 
 	puts("Erase Group Size: ");
 	print_size(((u64)mmc->erase_grp_size) << 9, "\n");
 
+	if (mmc->cache_size) {
+		puts("Cache Size: ");
+		print_size(((u64)mmc->cache_size) << 10, "\n");
+	}
+
 	if (!IS_SD(mmc) && mmc->version >= MMC_VERSION_4_41) {
 		bool has_enh = (mmc->part_support & ENHNCD_SUPPORT) != 0;
 		bool usr_enh = has_enh && (mmc->part_attr & EXT_CSD_ENH_USR);
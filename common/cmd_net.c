@@ -110,6 +110,20 @@ U_BOOT_CMD(
 );
 #endif
 
+#if defined(CONFIG_CMD_HTTPGET)
+static int do_httpget(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
+{
+	return netboot_common(HTTPGET, cmdtp, argc, argv);
+}
+
+U_BOOT_CMD(
+	httpget,	3,	1,	do_httpget,
+	"load a file via network using HTTP GET",
+	"[loadAddress] [[hostIPaddr:]path]\n"
+	"The server port is taken from 'httpport' (default 80)."
+);
+#endif
+
 static void netboot_update_env(void)
 {
 	char tmp[22];
@@ -1185,6 +1185,8 @@ int tpm2_init(void) {
 		printf("The tpm2 has been initialized.\n");
 		return -1;
 	}
+
+	bootstage_start(BOOTSTAGE_ID_MOXA_TPM2, "tpm2_init");
 	
 //	gpio_request (PIO_TPM_RST, "TPM_RST");
 //	gpio_direction_output (PIO_TPM_RST, 1);
@@ -1242,6 +1244,7 @@ int tpm2_init(void) {
 	tpm2_init_ok = 1;
 	
 out_err:
+	bootstage_accum(BOOTSTAGE_ID_MOXA_TPM2);
 	
 	if (rc)
 		printf("TPM2 Init Fail![%d]\n", rc);
@@ -1518,6 +1521,19 @@ static int do_##cmd(cmd_tbl_t *cmdtp, int flag,         \
 TPM_COMMAND_NO_ARG(tpm2_init)
 TPM_COMMAND_NO_ARG(tpm2_force_clear)
 
+static int do_tpm2_spi_stats(cmd_tbl_t *cmdtp, int flag,
+		int argc, char * const argv[])
+{
+	if (!slave) {
+		printf("TPM SPI is not set up\n");
+		return CMD_RET_FAILURE;
+	}
+
+	mxc_spi_print_stats(slave);
+
+	return CMD_RET_SUCCESS;
+}
+
 
 static cmd_tbl_t tpm2_commands[] = {
 	U_BOOT_CMD_MKENT(init, 0, 1, 
@@ -1532,6 +1548,8 @@ static cmd_tbl_t tpm2_commands[] = {
 			do_tpm2_hierarchy_disable, "", ""),
 	U_BOOT_CMD_MKENT(get_capability, 0, 1,
 			do_tpm2_get_capability, "", ""),
+	U_BOOT_CMD_MKENT(spi_stats, 0, 1,
+			do_tpm2_spi_stats, "", ""),
 };
 
 static int do_tpm2(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
@@ -1578,4 +1596,8 @@ U_BOOT_CMD(tpm2, CONFIG_SYS_MAXARGS, 1, do_tpm2,
 "       - This function takes a capability_opts_t structure as a parameter.\n"
 "          Issue TPM2_Capability command.  <property> The value is either\n"
 "          properties-fixed and properties-variable .\n"
+"\n"
+"Diagnostics:\n"
+"	spi_stats\n"
+"       - Show bits moved over the TPM SPI bus and the bus utilisation.\n"
 );
@@ -36,6 +36,36 @@ static ulong env_new_offset	= CONFIG_ENV_OFFSET_REDUND;
 
 #define ACTIVE_FLAG	1
 #define OBSOLETE_FLAG	0
+
+#ifdef CONFIG_ENV_LOG_OFFSET
+/*
+ * Change log: a spare sector that collects the variables set after the
+ * active copy was written, so that a small change costs a page program
+ * instead of erasing and rewriting a whole copy. A log only applies on
+ * top of the copy whose CRC is in its header; every full save zeroes the
+ * magic so the log is discarded.
+ */
+#ifndef CONFIG_ENV_LOG_SIZE
+# define CONFIG_ENV_LOG_SIZE	CONFIG_ENV_SECT_SIZE
+#endif
+
+#define ENV_LOG_MAGIC	0x454e564c	/* "ENVL" */
+
+struct env_log_header {
+	uint32_t	magic;
+	uint32_t	base_crc;	/* CRC of the copy the log applies to */
+};
+
+/* Followed by @len bytes of "name=value\0" strings, as in env_t.data */
+struct env_log_record {
+	uint32_t	len;
+	uint32_t	crc;
+};
+
+static uint32_t env_log_crc;	/* CRC of the active copy */
+/* Offset of the next record, 0 to start a new log, -1 if full or broken */
+static int env_log_pos = -1;
+#endif /* CONFIG_ENV_LOG_OFFSET */
 #endif /* CONFIG_ENV_OFFSET_REDUND */
 
 DECLARE_GLOBAL_DATA_PTR;
@@ -45,6 +75,147 @@ char *env_name_spec = "SPI Flash";
 static struct spi_flash *env_flash;
 
 #if defined(CONFIG_ENV_OFFSET_REDUND)
+#ifdef CONFIG_ENV_LOG_OFFSET
+/*
+ * Append the variables changed since the last save to the change log.
+ * Returns 1 when they cannot be logged and a full save is needed.
+ */
+static int env_log_append(void)
+{
+	struct env_log_header hdr;
+	struct env_log_record rec;
+	char	*res = NULL;
+	ssize_t	len;
+	u32	size;
+	int	ret = 1;
+
+	/* Deletions cannot be expressed as records */
+	if (env_log_pos < 0 || env_htab.deleted)
+		return 1;
+
+	len = hexport_r(&env_htab, '\0', H_CHANGED, &res, 0, 0, NULL);
+	if (len < 0)
+		return 1;
+
+	/* hexport_r() over-estimates; find the terminating empty string */
+	for (len = 0; res[len]; len += strlen(res + len) + 1)
+		;
+	len++;
+
+	rec.len = len;
+	rec.crc = crc32(0, (uchar *)res, len);
+	size = ALIGN(sizeof(rec) + len, 4);
+
+	if (env_log_pos == 0) {
+		if (sizeof(hdr) + size > CONFIG_ENV_LOG_SIZE)
+			goto done;
+
+		puts("Erasing change log...");
+		if (spi_flash_erase(env_flash, CONFIG_ENV_LOG_OFFSET,
+				    CONFIG_ENV_LOG_SIZE))
+			goto done;
+
+		hdr.magic = ENV_LOG_MAGIC;
+		hdr.base_crc = env_log_crc;
+		if (spi_flash_write(env_flash, CONFIG_ENV_LOG_OFFSET,
+				    sizeof(hdr), &hdr))
+			goto done;
+
+		env_log_pos = sizeof(hdr);
+	} else if (env_log_pos + size > CONFIG_ENV_LOG_SIZE) {
+		goto done;
+	}
+
+	/* Data first, so a record only becomes visible once complete */
+	puts("Logging changes...");
+	if (spi_flash_write(env_flash, CONFIG_ENV_LOG_OFFSET + env_log_pos +
+			    sizeof(rec), len, res) ||
+	    spi_flash_write(env_flash, CONFIG_ENV_LOG_OFFSET + env_log_pos,
+			    sizeof(rec), &rec)) {
+		/* Do not append after a record that may be half written */
+		env_log_pos = -1;
+		goto done;
+	}
+
+	env_log_pos += size;
+	ret = 0;
+	puts("done\n");
+
+ done:
+	free(res);
+	return ret;
+}
+
+/* Apply the change log on top of the copy with CRC @crc just imported */
+static void env_log_replay(uint32_t crc)
+{
+	struct env_log_header *hdr;
+	struct env_log_record *rec;
+	char	*log;
+	u32	pos;
+
+	env_log_crc = crc;
+	env_log_pos = -1;
+
+	log = memalign(ARCH_DMA_MINALIGN, CONFIG_ENV_LOG_SIZE);
+	if (!log)
+		return;
+
+	if (spi_flash_read(env_flash, CONFIG_ENV_LOG_OFFSET,
+			   CONFIG_ENV_LOG_SIZE, log))
+		goto out;
+
+	hdr = (struct env_log_header *)log;
+	if (hdr->magic != ENV_LOG_MAGIC || hdr->base_crc != crc) {
+		/* No log for this copy yet */
+		env_log_pos = 0;
+		goto out;
+	}
+
+	for (pos = sizeof(*hdr); pos + sizeof(*rec) <= CONFIG_ENV_LOG_SIZE;
+	     pos += ALIGN(sizeof(*rec) + rec->len, 4)) {
+		rec = (struct env_log_record *)(log + pos);
+
+		if (rec->len == ~0U) {
+			/* End of the log; only append if the rest is erased */
+			env_log_pos = pos;
+			for (; pos < CONFIG_ENV_LOG_SIZE; pos++) {
+				if (log[pos] != (char)0xff) {
+					env_log_pos = -1;
+					break;
+				}
+			}
+			break;
+		}
+
+		if (rec->len > CONFIG_ENV_LOG_SIZE - pos - sizeof(*rec) ||
+		    crc32(0, (uchar *)(rec + 1), rec->len) != rec->crc) {
+			printf("Change log broken at 0x%x\n", pos);
+			break;
+		}
+
+		if (!himport_r(&env_htab, (char *)(rec + 1), rec->len, '\0',
+			       H_NOCLEAR, 0, 0, NULL))
+			break;
+	}
+
+ out:
+	free(log);
+}
+
+/* Make sure a log written for the previous copy is never replayed */
+static int env_log_discard(uint32_t crc)
+{
+	uint32_t magic = 0;
+
+	env_log_crc = crc;
+	env_log_pos = 0;
+
+	return spi_flash_write(env_flash, CONFIG_ENV_LOG_OFFSET,
+			       sizeof(magic), &magic);
+}
+#endif /* CONFIG_ENV_LOG_OFFSET */
+
 int saveenv(void)
 {
 	env_t	env_new;
@@ -52,6 +223,11 @@ int saveenv(void)
 	u32	saved_size, saved_offset, sector = 1;
 	int	ret;
 
+	if (!env_htab.changed) {
+		puts("Environment unchanged, not saved\n");
+		return 0;
+	}
+
 	if (!env_flash) {
 		env_flash = spi_flash_probe(CONFIG_ENV_SPI_BUS,
 			CONFIG_ENV_SPI_CS,
@@ -62,6 +238,13 @@ int saveenv(void)
 		}
 	}
 
+#ifdef CONFIG_ENV_LOG_OFFSET
+	if (env_log_append() == 0) {
+		hclean_r(&env_htab);
+		return 0;
+	}
+#endif
+
 	ret = env_export(&env_new);
 	if (ret)
 		return ret;
@@ -121,8 +304,16 @@ int saveenv(void)
 	if (ret)
 		goto done;
 
+#ifdef CONFIG_ENV_LOG_OFFSET
+	ret = env_log_discard(env_new.crc);
+	if (ret)
+		goto done;
+#endif
+
 	puts("done\n");
 
+	hclean_r(&env_htab);
+
 	gd->env_valid = gd->env_valid == 2 ? 1 : 2;
 
 	printf("Valid environment: %d\n", (int)gd->env_valid);
@@ -215,6 +406,11 @@ void env_relocate_spec(void)
 	if (!ret) {
 		error("Cannot import environment: errno = %d\n", errno);
 		set_default_env("env_import failed");
+	} else {
+#ifdef CONFIG_ENV_LOG_OFFSET
+		env_log_replay(ep->crc);
+#endif
+		hclean_r(&env_htab);
 	}
 
 err_read:
@@ -232,6 +428,11 @@ int saveenv(void)
 	int	ret = 1;
 	env_t	env_new;
 
+	if (!env_htab.changed) {
+		puts("Environment unchanged, not saved\n");
+		return 0;
+	}
+
 	if (!env_flash) {
 		env_flash = spi_flash_probe(CONFIG_ENV_SPI_BUS,
 			CONFIG_ENV_SPI_CS,
@@ -288,6 +489,8 @@ int saveenv(void)
 	ret = 0;
 	puts("done\n");
 
+	hclean_r(&env_htab);
+
  done:
 	if (saved_buffer)
 		free(saved_buffer);
@@ -318,8 +521,10 @@ void env_relocate_spec(void)
 	}
 
 	ret = env_import(buf, 1);
-	if (ret)
+	if (ret) {
 		gd->env_valid = 1;
+		hclean_r(&env_htab);
+	}
 out:
 	spi_flash_free(env_flash);
 	if (buf)
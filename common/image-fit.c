@@ -16,7 +16,9 @@
 #else
 #include <common.h>
 #include <errno.h>
+#include <hash.h>
 #include <mapmem.h>
+#include <watchdog.h>
 #include <asm/io.h>
 DECLARE_GLOBAL_DATA_PTR;
 #endif /* !USE_HOSTCC*/
@@ -903,6 +905,18 @@ int fit_set_timestamp(void *fit, int noffset, time_t timestamp)
 int calculate_hash(const void *data, int data_len, const char *algo,
 			uint8_t *value, int *value_len)
 {
+#if defined(CONFIG_SHA_HW_ACCEL) && !defined(USE_HOSTCC)
+	struct hash_algo *hash_algo;
+
+	/* The accelerated SHA from common/hash.c, e.g. on the CAAM */
+	if ((strcmp(algo, "sha1") == 0 || strcmp(algo, "sha256") == 0) &&
+	    hash_lookup_algo(algo, &hash_algo) == 0) {
+		hash_algo->hash_func_ws((const unsigned char *)data, data_len,
+					value, hash_algo->chunk_size);
+		*value_len = hash_algo->digest_size;
+		return 0;
+	}
+#endif
 	if (IMAGE_ENABLE_CRC32 && strcmp(algo, "crc32") == 0) {
 		*((uint32_t *)value) = crc32_wd(0, data, data_len,
 							CHUNKSZ_CRC32);
@@ -1776,3 +1790,219 @@ int boot_get_setup_fit(bootm_headers_t *images, uint8_t arch,
 
 	return ret;
 }
+
+#ifndef USE_HOSTCC
+/* Bytes read at a time while walking the structure block */
+#define FIT_READ_TREE_WINDOW	2048
+/* Bytes read and hashed at a time by fit_image_read_data() */
+#define FIT_READ_DATA_CHUNK	(1 << 20)
+
+struct fit_read_tree {
+	void *fit;
+	ulong have;		/* bytes before this offset are in memory */
+	ulong end;		/* end of the structure block */
+	fit_read_fn read;
+	void *priv;
+};
+
+/* Make sure bytes [pos, pos + len) of the structure block are in memory */
+static int fit_read_tree_ensure(struct fit_read_tree *t, ulong pos, ulong len)
+{
+	ulong start, n;
+
+	if (pos + len > t->end)
+		return -FDT_ERR_TRUNCATED;
+
+	if (pos + len <= t->have)
+		return 0;
+
+	start = max(pos, t->have);
+	n = max(pos + len - start, (ulong)FIT_READ_TREE_WINDOW);
+	n = min(n, t->end - start);
+
+	if (t->read(t->priv, start, t->fit + start, n))
+		return -EIO;
+
+	t->have = start + n;
+
+	return 0;
+}
+
+int fit_read_tree(void *fit, ulong size, fit_read_fn read, void *priv)
+{
+	struct fit_read_tree t;
+	const char *strings;
+	ulong pos, len;
+	uint32_t tag;
+	char *name;
+	int ret;
+
+	if (read(priv, 0, fit, sizeof(struct fdt_header)))
+		return -EIO;
+
+	ret = fdt_check_header(fit);
+	if (ret)
+		return ret;
+
+	if (fdt_version(fit) < 17 || fdt_totalsize(fit) > size)
+		return -FDT_ERR_BADVERSION;
+
+	/* Header and memory reservation map up to the structure block */
+	len = fdt_off_dt_struct(fit) - sizeof(struct fdt_header);
+	if (read(priv, sizeof(struct fdt_header),
+		 fit + sizeof(struct fdt_header), len))
+		return -EIO;
+
+	if (read(priv, fdt_off_dt_strings(fit),
+		 fit + fdt_off_dt_strings(fit), fdt_size_dt_strings(fit)))
+		return -EIO;
+	strings = fit + fdt_off_dt_strings(fit);
+
+	t.fit = fit;
+	t.have = fdt_off_dt_struct(fit);
+	t.end = t.have + fdt_size_dt_struct(fit);
+	t.read = read;
+	t.priv = priv;
+
+	/* Walk the tags, leaving out the value of every "data" property */
+	for (pos = t.have; ; ) {
+		ret = fit_read_tree_ensure(&t, pos, FDT_TAGSIZE);
+		if (ret)
+			return ret;
+		tag = fdt32_to_cpu(*(fdt32_t *)(fit + pos));
+		pos += FDT_TAGSIZE;
+
+		switch (tag) {
+		case FDT_BEGIN_NODE:
+			do {
+				ret = fit_read_tree_ensure(&t, pos, 1);
+				if (ret)
+					return ret;
+				name = fit + pos++;
+			} while (*name);
+			pos = ALIGN(pos, FDT_TAGSIZE);
+			break;
+		case FDT_PROP:
+			ret = fit_read_tree_ensure(&t, pos, 2 * FDT_TAGSIZE);
+			if (ret)
+				return ret;
+			len = fdt32_to_cpu(*(fdt32_t *)(fit + pos));
+			name = (char *)strings +
+			       fdt32_to_cpu(*(fdt32_t *)(fit + pos + 4));
+			pos += 2 * FDT_TAGSIZE;
+			if (strcmp(name, FIT_DATA_PROP)) {
+				ret = fit_read_tree_ensure(&t, pos, len);
+				if (ret)
+					return ret;
+			}
+			pos = ALIGN(pos + len, FDT_TAGSIZE);
+			break;
+		case FDT_END_NODE:
+		case FDT_NOP:
+			break;
+		case FDT_END:
+			return 0;
+		default:
+			return -FDT_ERR_BADSTRUCTURE;
+		}
+	}
+}
+
+int fit_image_read_data(const void *fit, int noffset, fit_read_fn read,
+			void *priv)
+{
+	struct {
+		struct hash_algo *algo;
+		void *ctx;
+		uint8_t *value;
+		int value_len;
+	} h[4];
+	uint8_t value[FIT_MAX_HASH_LEN];
+	const void *data;
+	size_t size, done, n;
+	int nhash = 0, unchecked = 0;
+	int hash_noffset;
+	char *algo;
+	int i, ret = 0;
+
+	if (fit_image_get_data(fit, noffset, &data, &size))
+		return -ENOENT;
+
+	fdt_for_each_subnode(fit, hash_noffset, noffset) {
+		const char *name = fit_get_name(fit, hash_noffset, NULL);
+
+		if (strncmp(name, FIT_HASH_NODENAME,
+			    strlen(FIT_HASH_NODENAME)))
+			continue;
+
+		if (nhash == ARRAY_SIZE(h) ||
+		    fit_image_hash_get_algo(fit, hash_noffset, &algo) ||
+		    fit_image_hash_get_value(fit, hash_noffset,
+					     &h[nhash].value,
+					     &h[nhash].value_len)) {
+			unchecked = 1;
+			continue;
+		}
+
+		h[nhash].ctx = NULL;
+#ifdef CONFIG_SHA_HW_ACCEL
+		/* Accelerated SHA takes the whole image once it is read */
+		if ((!strcmp(algo, "sha1") || !strcmp(algo, "sha256")) &&
+		    !hash_lookup_algo(algo, &h[nhash].algo)) {
+			nhash++;
+			continue;
+		}
+#endif
+		if (hash_progressive_lookup_algo(algo, &h[nhash].algo)) {
+			unchecked = 1;
+			continue;
+		}
+
+		h[nhash].algo->hash_init(h[nhash].algo, &h[nhash].ctx);
+		nhash++;
+	}
+
+	for (done = 0; done < size; done += n) {
+		n = min(size - done, (size_t)FIT_READ_DATA_CHUNK);
+		if (read(priv, (ulong)(data - fit) + done,
+			 (void *)data + done, n)) {
+			ret = -EIO;
+			goto out;
+		}
+
+		for (i = 0; i < nhash; i++)
+			if (h[i].ctx)
+				h[i].algo->hash_update(h[i].algo, h[i].ctx,
+						       data + done, n, 0);
+		WATCHDOG_RESET();
+	}
+
+out:
+	for (i = 0; i < nhash; i++) {
+		if (h[i].ctx)
+			h[i].algo->hash_finish(h[i].algo, h[i].ctx, value,
+					       sizeof(value));
+		else if (!ret)
+			h[i].algo->hash_func_ws(data, size, value,
+						h[i].algo->chunk_size);
+		if (ret)
+			continue;
+
+		/* FIT stores crc32 in image (big endian) byte order */
+		if (!strcmp(h[i].algo->name, "crc32"))
+			*(uint32_t *)value = cpu_to_uimage(*(uint32_t *)value);
+
+		if (h[i].value_len != h[i].algo->digest_size ||
+		    memcmp(value, h[i].value, h[i].value_len)) {
+			printf("Bad %s hash for '%s' image node\n",
+			       h[i].algo->name, fit_get_name(fit, noffset, NULL));
+			ret = -EBADMSG;
+		}
+	}
+
+	if (!ret && unchecked)
+		ret = -EPROTONOSUPPORT;
+
+	return ret;
+}
+#endif /* !USE_HOSTCC */
@@ -64,8 +64,12 @@ void main_loop(void)
 	int i = 500;
 
 	bootstage_mark_name(BOOTSTAGE_ID_MAIN_LOOP, "main_loop");
+
+	bootstage_start(BOOTSTAGE_ID_MOXA_BOARD_INIT, "moxa_board_init");
 	sys_board_init();
+	bootstage_accum(BOOTSTAGE_ID_MOXA_BOARD_INIT);
 
+	bootstage_start(BOOTSTAGE_ID_MOXA_USB_POWER, "usb_power_cycle");
         usb_power_config(0);
         //usb_oc_config(0);
 
@@ -76,6 +80,7 @@ void main_loop(void)
 
         usb_power_config(1);
         //usb_oc_config(1);
+	bootstage_accum(BOOTSTAGE_ID_MOXA_USB_POWER);
 
 #ifndef CONFIG_SYS_GENERIC_BOARD
 	puts("Warning: Your board does not use generic board. Please read\n");
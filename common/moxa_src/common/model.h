@@ -26,6 +26,20 @@ enum {
 	AM335X_UC5112,
 };
 
+/*
+ * Boot phases timed with bootstage, see "moxa bootstat". They use the
+ * board IDs, so CONFIG_BOOTSTAGE_BOARD_COUNT must cover them.
+ */
+enum {
+	BOOTSTAGE_ID_MOXA_BOARD_INIT = BOOTSTAGE_ID_BOARD,
+	BOOTSTAGE_ID_MOXA_USB_POWER,
+	BOOTSTAGE_ID_MOXA_USB_SIGNAL,
+	BOOTSTAGE_ID_MOXA_TPM2,
+	BOOTSTAGE_ID_MOXA_MMC_RESCAN,
+	BOOTSTAGE_ID_MOXA_FIT_LOAD,
+	BOOTSTAGE_ID_MOXA_END,
+};
+
 /*#define DDR_TYPE       K4B4G1646D
 #include <asm/arch/ddr_defs.h>*/
 
@@ -6,6 +6,7 @@
 
 #include <common.h>
 #include <command.h>
+#include <malloc.h>
 #include <memalign.h>
 #include <types.h>
 #include <bios.h>                        
@@ -20,9 +21,20 @@
 #include <cli.h>
 #include "moxa_lib.h"
 #include "moxa_boot.h"
+#include "moxa_crypt.h"
 #include "cmd_bios.h"
 #include "sys_info.h"
+#include <div64.h>
+#include <errno.h>
+#include <image.h>
 
+DECLARE_GLOBAL_DATA_PTR;
+
+#define MOXA_FIT_NAME		"imx7d-moxa-uc-8200.itb"
+#define MOXA_FIT_CONF		"uc8200"
+#define MOXA_FIT_ADDR		0x82000000
+/* Room left free below the stack when placing the FIT */
+#define MOXA_FIT_STACK_GAP	0x100000
 
 enum MMC_DEICE{
          MMC0,
@@ -67,10 +79,6 @@ int do_encryption_func(uchar sd_num, uchar re_key,unsigned long f1addr,unsigned
 	unsigned long Start_offset = 0;	//by key1
 	unsigned char direction = 0;	//by key2
 	unsigned char jump_Offset = 0;	//by key3
-	unsigned long i = 0;
-	unsigned long j = 1;
-	unsigned long size = 0;
-	unsigned long baddr = 0;
 	char cmd_msg [MAX_SIZE_64BYTE] = {0};
 	char boot_msg [MAX_SIZE_128BYTE] = {0};
 
@@ -87,7 +95,7 @@ int do_encryption_func(uchar sd_num, uchar re_key,unsigned long f1addr,unsigned
 			f1addr = 0x81000000;		
 		}
 
-		i = randkey();	
+		randkey();	
 		val = (uchar)(randkey());		//Get randkey value
 		key1 = (val & 0x0F);			//set key1 value
 
@@ -107,11 +115,6 @@ int do_encryption_func(uchar sd_num, uchar re_key,unsigned long f1addr,unsigned
 	Start_offset = start_offset[key1];
 	direction = direction_offset[key2];	
 	jump_Offset = jump_offset[key3];	
-	
-	size = (fs1 / jump_Offset);
-	
-	if (fs1 % jump_Offset)
-		size++;
 
 #ifdef Secure_boot_debug		
 	printf("key1 = %x\n",key1);
@@ -122,48 +125,8 @@ int do_encryption_func(uchar sd_num, uchar re_key,unsigned long f1addr,unsigned
 	printf("jump_Offset = %x\n",jump_Offset);
 #endif	//Secure_boot_debug		
 					
-	if (direction == 0x55) {			//UP
-		for(i=0; i < size; i++){
-			val = VPchar(f1addr+Start_offset);
-			
-			val ^= VPchar(f2addr+baddr);
-			VPchar(f1addr+Start_offset) = val;
-			
-			if (i == ((fs2*j)-1)) {
-				baddr = 0;
-				j++;
-			} else {
-				baddr++;
-			}
-			
-			if (Start_offset < jump_Offset){
-//				key1_Start_offset -= key3_jump_Offset;
-				Start_offset = (fs1 - jump_Offset);
-			} else {					
-				Start_offset -= jump_Offset;
-			}
-		}
-	}else{
-		//DOWN
-		for(i = 0; i < size; i++){
-			val = VPchar(f1addr+Start_offset);
-			val ^= VPchar(f2addr+baddr);
-			VPchar(f1addr+Start_offset) = val;
-//					VPchar(f1addr+key1_Start_offset) = 0xff;	//for debug
-			if (i == ((fs2*j)-1)) {
-				baddr = 0;
-				j++;
-			} else {
-				baddr++;
-			}
-
-			Start_offset += jump_Offset;					
-			if (Start_offset > fs1) {
-				Start_offset = (Start_offset - fs1);
-			}
-		}
-				
-	}
+	moxa_xor_keystream((uchar *)f1addr, fs1, (uchar *)f2addr, fs2,
+			   Start_offset, direction == 0x55, jump_Offset);
 
 	if(re_key) {
 //R28A		printf("Please not to Power OFF the machine.\n");
@@ -419,6 +382,8 @@ int do_run_mmc_boot(board_infos *board_info)
 	char fs_dev[MAX_SIZE_16BYTE] = {0};
 	int mmc_num = 0;
 
+	bootstage_start(BOOTSTAGE_ID_MOXA_MMC_RESCAN, "mmc_rescan");
+
 	for (mmc_num = 0; mmc_num < board_info->sys_mmc; mmc_num++) {
 
 		sprintf(fs_dev, "mmc dev %d", mmc_num);
@@ -427,6 +392,8 @@ int do_run_mmc_boot(board_infos *board_info)
 			fs_info += 1;
 	}
 
+	bootstage_accum(BOOTSTAGE_ID_MOXA_MMC_RESCAN);
+
 	//return run_mmc_func(board_info->sys_mmc, board_info->dtbname, fs_info);
 	return run_mmc_func(board_info->sys_mmc, board_info->dtbname, 2);
 }
@@ -486,6 +453,120 @@ EXIT:
 }
 #endif
 
+#ifdef CONFIG_MOXA_FIT_PARTIAL_LOAD
+struct fit_file {
+	struct fs_file *file;
+	ulong bytes;		/* read so far */
+};
+
+static int fit_file_read(void *priv, ulong offset, void *buf, ulong len)
+{
+	struct fit_file *f = priv;
+	loff_t actread;
+
+	if (fs_fseek(f->file, offset) ||
+	    fs_fread(f->file, (ulong)buf, len, &actread) || actread != len)
+		return -EIO;
+
+	f->bytes += len;
+
+	return 0;
+}
+
+/*
+ * Read only the images used by configuration MOXA_FIT_CONF from the FIT
+ * on partition 1 of @boot_mmc instead of the whole file. When the kernel
+ * is uncompressed, the FIT is placed so that its data already sits at the
+ * kernel load address and bootm does not have to move it.
+ *
+ * Returns the address of the FIT, or 0 when the caller should fall back
+ * to loading the whole file. @verified is set when every image was hashed
+ * while it was read, @bytes is the amount of data read from the card.
+ */
+static ulong load_fit_conf(int boot_mmc, int *verified, ulong *bytes)
+{
+	static const char * const props[] = {
+		FIT_KERNEL_PROP, FIT_FDT_PROP, FIT_RAMDISK_PROP,
+	};
+	char dev_part[MAX_SIZE_16BYTE];
+	struct fit_file file = { NULL, 0 };
+	void *fit = (void *)MOXA_FIT_ADDR;
+	ulong top = gd->start_addr_sp - MOXA_FIT_STACK_GAP;
+	ulong addr = 0;
+	ulong load, base;
+	const void *data;
+	size_t size;
+	uint8_t comp;
+	int conf, noffset;
+	int i, ret;
+
+	*verified = 1;
+	*bytes = 0;
+
+	sprintf(dev_part, "%d:1", boot_mmc);
+
+	if (fs_set_blk_dev("mmc", dev_part, FS_TYPE_FAT))
+		return 0;
+
+	file.file = fs_fopen(MOXA_FIT_NAME);
+
+	if (!file.file)
+		return 0;
+
+	if (fit_read_tree(fit, top - MOXA_FIT_ADDR, fit_file_read, &file))
+		goto EXIT;
+
+	conf = fit_conf_get_node(fit, MOXA_FIT_CONF);
+	noffset = fit_conf_get_prop_node(fit, conf, FIT_KERNEL_PROP);
+
+	if (conf < 0 || noffset < 0)
+		goto EXIT;
+
+	/* Move the tree so the kernel data lands on its load address */
+	if (!fit_image_get_comp(fit, noffset, &comp) && comp == IH_COMP_NONE &&
+	    !fit_image_get_load(fit, noffset, &load) &&
+	    !fit_image_get_data(fit, noffset, &data, &size)) {
+		base = load - (data - fit);
+
+		if (base != (ulong)fit && !(base & 3) &&
+		    base >= CONFIG_SYS_SDRAM_BASE && base < top &&
+		    top - base >= fdt_totalsize(fit)) {
+			fit = (void *)base;
+
+			if (fit_read_tree(fit, top - base, fit_file_read, &file))
+				goto EXIT;
+
+			conf = fit_conf_get_node(fit, MOXA_FIT_CONF);
+		}
+	}
+
+	for (i = 0; i < ARRAY_SIZE(props); i++) {
+		noffset = fit_conf_get_prop_node(fit, conf, props[i]);
+
+		if (noffset < 0) {
+			if (i == 0)
+				goto EXIT;
+			continue;
+		}
+
+		ret = fit_image_read_data(fit, noffset, fit_file_read, &file);
+
+		if (ret == -EPROTONOSUPPORT)
+			*verified = 0;
+		else if (ret)
+			goto EXIT;
+	}
+
+	addr = (ulong)fit;
+
+EXIT:
+	fs_fclose(file.file);
+	*bytes = file.bytes;
+
+	return addr;
+}
+#endif
+
 int run_mmc_func(int boot_mmc, char *dtbname, int fs_info)
 {
 	char msg[MAX_SIZE_256BYTE] = {0};
@@ -494,12 +575,30 @@ int run_mmc_func(int boot_mmc, char *dtbname, int fs_info)
 	char kernel_info[MAX_SIZE_64BYTE] = {0};
 	int ret = 0;
         char *s1;
+	char *verify = NULL;
+	ulong fit_addr = 0;
+	ulong fit_bytes = 0;
+	int verified = 0;
 
+	bootstage_start(BOOTSTAGE_ID_MOXA_FIT_LOAD, "fit_load");
 
-	sprintf(kernel_info, "fatload mmc %d:1 0x82000000 imx7d-moxa-uc-8200.itb", boot_mmc);
-        
+#ifdef CONFIG_MOXA_FIT_PARTIAL_LOAD
+	if (getenv_yesno("fit_partial") != 0)
+		fit_addr = load_fit_conf(boot_mmc, &verified, &fit_bytes);
+#endif
 
-        run_command (kernel_info, 0);
+	if (fit_addr == 0) {
+		sprintf(kernel_info, "fatload mmc %d:1 0x%x %s", boot_mmc,
+			MOXA_FIT_ADDR, MOXA_FIT_NAME);
+
+		if (run_command (kernel_info, 0) == 0)
+			fit_bytes += getenv_hex("filesize", 0);
+
+		fit_addr = MOXA_FIT_ADDR;
+		verified = 0;
+	}
+
+	bootstage_accum_bytes(BOOTSTAGE_ID_MOXA_FIT_LOAD, fit_bytes);
 
 			/*sprintf(msg, "setenv bootargs mac=${ethaddr} sd=2 ver=3 console=ttymxc0,115200n8 root=/dev/mmcblk%dp2 \
 				rw %s %s %s rootfstype=ext4 rootwait", fs_info, if_str, rb_str, fb_str);*/
@@ -531,9 +630,22 @@ int run_mmc_func(int boot_mmc, char *dtbname, int fs_info)
         }
 #endif
         //sprintf(boot_info, "bootz 0x81000000 - 0x83000000");
-        sprintf(boot_info, "bootm 0x82000000#uc8200");
+        sprintf(boot_info, "bootm 0x%lx#%s", fit_addr, MOXA_FIT_CONF);
+
+	/* Hashes were already checked while the images were read */
+	if (verified) {
+		s1 = getenv("verify");
+		verify = s1 ? strdup(s1) : NULL;
+		setenv("verify", "n");
+	}
+
         run_command(boot_info, 0);
 
+	if (verified) {
+		setenv("verify", verify);
+		free(verify);
+	}
+
         setenv("overlay_flag", "v1");
         run_command("saveenv", 0);
 EXIT:
@@ -640,3 +752,64 @@ EXIT:
 
 }
 #endif
+
+#ifdef CONFIG_BOOTSTAGE
+static int do_moxa_bootstat(cmd_tbl_t *cmdtp, int flag, int argc,
+			    char * const argv[])
+{
+	static const char * const names[] = {
+		"board init", "usb power cycle", "usb signal init", "tpm2 init",
+		"mmc rescan", "fit load",
+	};
+	uint32_t us;
+	ulong bytes;
+	int i;
+
+	BUILD_BUG_ON((int)BOOTSTAGE_ID_MOXA_END > (int)BOOTSTAGE_ID_USER);
+
+	printf("%-18s%12s%12s%10s\n", "Phase", "Time (us)", "Bytes",
+	       "KiB/s");
+
+	for (i = 0; i < ARRAY_SIZE(names); i++) {
+		us = bootstage_get_accum(BOOTSTAGE_ID_MOXA_BOARD_INIT + i,
+					 &bytes);
+
+		printf("%-18s%12u", names[i], us);
+
+		if (bytes && us)
+			printf("%12lu%10llu", bytes,
+			       lldiv((u64)bytes * 1000000 / 1024, us));
+
+		printf("\n");
+	}
+
+	printf("%-18s%12lu\n", "since reset", timer_get_boot_us());
+
+	return 0;
+}
+
+static cmd_tbl_t cmd_moxa_sub[] = {
+	U_BOOT_CMD_MKENT(bootstat, 1, 1, do_moxa_bootstat, "", ""),
+};
+
+static int do_moxa(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
+{
+	cmd_tbl_t *c;
+
+	if (argc < 2)
+		return CMD_RET_USAGE;
+
+	c = find_cmd_tbl(argv[1], cmd_moxa_sub, ARRAY_SIZE(cmd_moxa_sub));
+
+	if (c)
+		return c->cmd(cmdtp, flag, argc - 1, argv + 1);
+
+	return CMD_RET_USAGE;
+}
+
+U_BOOT_CMD(
+	moxa,	2,	1,	do_moxa,
+	"Moxa board utilities",
+	"bootstat - time spent in each Moxa boot phase"
+);
+#endif
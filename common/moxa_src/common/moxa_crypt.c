@@ -0,0 +1,118 @@
+/*  Copyright (C) MOXA Inc. All rights reserved.
+
+    This software is distributed under the terms of the
+    MOXA License.  See the file COPYING-MOXA for details.
+*/
+
+/*
+ * Keystream XOR of the secure boot uImage, shared with the host test in
+ * tools/moxa_crypt_test.c.
+ *
+ * The image is walked from @start in steps of @jump, down (UP) or up (DOWN)
+ * and wrapping at the image end, for size / jump steps (rounded up). Step i
+ * XORs in key byte i % key_size. Between two wraps of either the image
+ * offset or the key index, this is a plain strided run, so the walk is
+ * split into such runs up front and each run XORed without any per-byte
+ * wrap checks.
+ */
+
+#ifdef USE_HOSTCC
+#include "compiler.h"
+#else
+#include <common.h>
+#endif
+#include "moxa_crypt.h"
+
+/*
+ * XOR @n key bytes into every @stride-th byte from @dst upwards, taking
+ * the key bytes from @key stepping by @kstep.
+ */
+static void xor_stride(uint8_t *dst, ulong stride, const uint8_t *key,
+		       long kstep, ulong n)
+{
+	uint32_t *w;
+	uint32_t v;
+	unsigned int shift;
+
+	if (stride == 2 && n >= 4) {
+		/* Two bytes of each aligned word: start at offset 0 or 1 */
+		if ((ulong)dst & 2) {
+			*dst ^= *key;
+			dst += 2;
+			key += kstep;
+			n--;
+		}
+
+		shift = ((ulong)dst & 1) * 8;
+		w = (uint32_t *)(dst - ((ulong)dst & 1));
+
+		for (; n >= 2; n -= 2) {
+			v = key[0] | (uint32_t)key[kstep] << 16;
+			*w++ ^= cpu_to_le32(v << shift);
+			key += 2 * kstep;
+		}
+
+		dst = (uint8_t *)w + shift / 8;
+	}
+
+	for (; n >= 4; n -= 4) {
+		dst[0] ^= key[0];
+		dst[stride] ^= key[kstep];
+		dst[2 * stride] ^= key[2 * kstep];
+		dst[3 * stride] ^= key[3 * kstep];
+		dst += 4 * stride;
+		key += 4 * kstep;
+	}
+
+	for (; n; n--) {
+		*dst ^= *key;
+		dst += stride;
+		key += kstep;
+	}
+}
+
+void moxa_xor_keystream(uint8_t *img, ulong size, const uint8_t *key,
+			ulong key_size, ulong start, int up, ulong jump)
+{
+	ulong left = size / jump + (size % jump != 0);
+	ulong pos = start;
+	ulong kpos = 0;
+	ulong last;
+	ulong n;
+
+	while (left) {
+		/* Steps until the image offset wraps */
+		if (up)
+			n = pos / jump + 1;
+		else if (pos <= size)
+			n = (size - pos) / jump + 1;
+		else
+			n = 1;
+
+		/* ... or the key index does */
+		if (key_size && n > key_size - kpos)
+			n = key_size - kpos;
+		if (n > left)
+			n = left;
+
+		if (up) {
+			/* Walk the same bytes upwards with the key reversed */
+			last = pos - (n - 1) * jump;
+			xor_stride(img + last, jump, key + kpos + n - 1, -1, n);
+
+			pos = last < jump ? size - jump : last - jump;
+		} else {
+			last = pos + (n - 1) * jump;
+			xor_stride(img + pos, jump, key + kpos, 1, n);
+
+			pos = last + jump;
+			if (pos > size)
+				pos -= size;
+		}
+
+		left -= n;
+		kpos += n;
+		if (kpos == key_size)
+			kpos = 0;
+	}
+}
@@ -0,0 +1,14 @@
+/*  Copyright (C) MOXA Inc. All rights reserved.
+
+    This software is distributed under the terms of the
+    MOXA License.  See the file COPYING-MOXA for details.
+*/
+
+#ifndef _MOXA_CRYPT_H
+#define _MOXA_CRYPT_H
+
+void moxa_xor_keystream(unsigned char *img, unsigned long size,
+			const unsigned char *key, unsigned long key_size,
+			unsigned long start, int up, unsigned long jump);
+
+#endif
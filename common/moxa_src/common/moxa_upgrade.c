@@ -6,11 +6,14 @@
 
 #include <common.h>
 #include <command.h>
+#include <malloc.h>
 #include <memalign.h>
 #include <net.h>
 #include <spi.h>
 #include <rf.h>
 #include <asm/gpio.h>
+#include <asm/unaligned.h>
+#include <linux/sizes.h>
 #include <environment.h>
 #include <bios.h>                        
 #include <model.h>
@@ -20,6 +23,7 @@
 #include "fs.h"
 #include "fat.h"
 #include <pca953x.h>
+#include <image-sparse.h>
 #include <cli.h>
 #include "moxa_console.h"
 #include "moxa_lib.h"
@@ -30,10 +34,722 @@ DECLARE_GLOBAL_DATA_PTR;
 #define TFTP_DEFAULT_LOCAL_IP "192.168.30.174"
 #define TFTP_DEFAULT_SERVER_IP  "192.168.30.71"
 
+/* Bytes read from the firmware file per fs_fread() call */
+#define MOXA_FW_COPY_WINDOW	0x1000000
+
+#ifndef CONFIG_MOXA_FW_STREAM_SLOTS
+#define CONFIG_MOXA_FW_STREAM_SLOTS	4
+#endif
+#ifndef CONFIG_MOXA_FW_STREAM_SLOT_SIZE
+#define CONFIG_MOXA_FW_STREAM_SLOT_SIZE	SZ_1M
+#endif
+
 int tftp_upgrade_start = 0;
-extern unsigned  int fw_tftp_size;
 extern char console_buffer[CONFIG_SYS_CBSIZE + 1];
 
+/*
+ * Firmware stream sink.
+ *
+ * Received firmware data is copied into a ring of block aligned slots.
+ * A slot is queued once it is full and fw_stream_flush() writes queued
+ * slots to the target MMC with one multi-block write each, so the
+ * network side only has to hold CONFIG_MOXA_FW_STREAM_SLOTS slots in RAM
+ * no matter how large the image is.
+ *
+ * An image starting with the Android sparse magic is decoded on the fly:
+ * RAW chunks go through the ring, FILL chunks are written from a single
+ * pattern slot and DONT_CARE chunks only move the write position (or are
+ * erased, with CONFIG_MOXA_FW_SPARSE_ERASE), so the free space of a
+ * filesystem image is never transferred nor written.
+ *
+ * A gzip or LZ4 frame image is inflated on the fly first, so compressed
+ * sparse images work as well. Slots are written without waiting for the
+ * card to finish programming them; the card programs one slot while the
+ * next one is received or inflated.
+ *
+ * With CONFIG_MOXA_FW_MMC_CACHE the eMMC volatile cache is turned on
+ * for the session and flushed and turned off again when it is closed.
+ */
+enum fw_sparse_state {
+	FW_SPARSE_FILE,		/* collecting the file header */
+	FW_SPARSE_CHUNK,	/* collecting a chunk header */
+	FW_SPARSE_RAW,		/* passing chunk data to the ring */
+	FW_SPARSE_FILL,		/* collecting the fill pattern */
+	FW_SPARSE_DONE,		/* all chunks seen */
+};
+
+struct fw_stream {
+	struct mmc *mmc;
+	block_dev_desc_t *dev;
+	uchar *ring;
+	ulong slot_size;
+	int head;		/* slot currently being filled */
+	int tail;		/* oldest queued slot */
+	int queued;		/* full slots waiting for flush */
+	ulong fill;		/* bytes in the head slot */
+	lbaint_t start_blk;	/* first block of the image on target */
+	lbaint_t next_blk;	/* next block to be written */
+	lbaint_t max_blk;	/* one past the last usable block */
+	unsigned long long offset;	/* bytes accepted so far */
+	unsigned long long image;	/* bytes after decompression */
+	ulong time_start;
+	int active;
+	int cache;		/* we turned the eMMC cache on */
+	int err;
+
+	/* compressed image decoding */
+	struct gzstream *gz;
+#ifdef CONFIG_LZ4
+	struct ulz4stream *lz4;
+#endif
+	uchar magic[4];		/* first bytes, for the compression magic */
+	ulong magic_len;	/* bytes collected in magic */
+	int zip_known;		/* decompressor chosen from magic */
+
+	/* sparse image decoding */
+	int sparse;
+	int sp_known;		/* sparse decided from the first bytes */
+	enum fw_sparse_state sp_state;
+	uchar sp_hdr[sizeof(sparse_header_t)];
+	ulong sp_hlen;		/* bytes collected in sp_hdr */
+	ulong sp_want;		/* bytes still expected in this state */
+	ulong sp_skip;		/* bytes to drop before going on */
+	u32 sp_blk_sz;		/* sparse block size in bytes */
+	u32 sp_chunk_hdr_sz;
+	u32 sp_chunks;		/* chunks not parsed yet */
+	lbaint_t sp_fill_blks;	/* target blocks of the pending FILL chunk */
+	lbaint_t skipped;	/* target blocks not written */
+};
+
+static struct fw_stream fw_stream;
+
+static uchar *fw_stream_slot(struct fw_stream *s, int slot)
+{
+	return s->ring + slot * s->slot_size;
+}
+
+static int fw_stream_write_blocks(struct fw_stream *s, const uchar *buf,
+				  lbaint_t blkcnt)
+{
+	if (s->next_blk + blkcnt > s->max_blk) {
+		printf("Firmware image is larger than target MMC\n");
+		return -1;
+	}
+
+	if (mmc_bwrite_nowait(s->mmc, s->next_blk, blkcnt, buf) != blkcnt) {
+		printf("MMC write fail at block 0x" LBAF "\n", s->next_blk);
+		return -1;
+	}
+
+	s->next_blk += blkcnt;
+
+	return 0;
+}
+
+/* Write out everything buffered, including a partial head slot */
+static int fw_stream_drain(struct fw_stream *s)
+{
+	if (fw_stream_flush(1))
+		return s->err;
+
+	if (s->fill) {
+		if (fw_stream_write_blocks(s, fw_stream_slot(s, s->head),
+					   s->fill / s->dev->blksz)) {
+			s->err = -1;
+			return s->err;
+		}
+		s->fill = 0;
+	}
+
+	return 0;
+}
+
+/* Copy image data into the ring, flushing a slot when the ring is full */
+static int fw_stream_put(struct fw_stream *s, const uchar *src, ulong len)
+{
+	ulong n;
+
+	while (len) {
+		n = min(len, s->slot_size - s->fill);
+		memcpy(fw_stream_slot(s, s->head) + s->fill, src, n);
+		s->fill += n;
+		src += n;
+		len -= n;
+
+		if (s->fill < s->slot_size)
+			break;
+
+		s->head = (s->head + 1) % CONFIG_MOXA_FW_STREAM_SLOTS;
+		s->fill = 0;
+		s->queued++;
+
+		/* Ring is full, make room for the next slot now */
+		if (s->queued == CONFIG_MOXA_FW_STREAM_SLOTS &&
+		    fw_stream_flush(0))
+			return s->err;
+	}
+
+	return 0;
+}
+
+/* Leave @blkcnt target blocks untouched (DONT_CARE chunk) */
+static int fw_stream_skip(struct fw_stream *s, lbaint_t blkcnt)
+{
+#ifdef CONFIG_MOXA_FW_SPARSE_ERASE
+	struct mmc *mmc = find_mmc_device(s->dev->dev);
+	lbaint_t grp, start, end;
+#endif
+
+	if (fw_stream_drain(s))
+		return s->err;
+
+	if (s->next_blk + blkcnt > s->max_blk) {
+		printf("Firmware image is larger than target MMC\n");
+		s->err = -1;
+		return s->err;
+	}
+
+#ifdef CONFIG_MOXA_FW_SPARSE_ERASE
+	/* Only whole erase groups, the card would round anything else */
+	grp = mmc->erase_grp_size;
+	start = roundup(s->next_blk, grp);
+	end = rounddown(s->next_blk + blkcnt, grp);
+
+	if (end > start &&
+	    s->dev->block_erase(s->dev->dev, start, end - start) !=
+	    end - start) {
+		printf("MMC erase fail at block 0x" LBAF "\n", start);
+		s->err = -1;
+		return s->err;
+	}
+#endif
+
+	s->next_blk += blkcnt;
+	s->skipped += blkcnt;
+
+	return 0;
+}
+
+/* Write @blkcnt target blocks of a repeated 32-bit @pattern (FILL chunk) */
+static int fw_stream_fill(struct fw_stream *s, u32 pattern, lbaint_t blkcnt)
+{
+	u32 *slot;
+	lbaint_t n;
+	ulong i;
+
+	if (fw_stream_drain(s))
+		return s->err;
+
+	slot = (u32 *)fw_stream_slot(s, s->head);
+	for (i = 0; i < s->slot_size / sizeof(u32); i++)
+		slot[i] = pattern;
+
+	while (blkcnt) {
+		n = min(blkcnt, (lbaint_t)(s->slot_size / s->dev->blksz));
+		if (fw_stream_write_blocks(s, (uchar *)slot, n)) {
+			s->err = -1;
+			return s->err;
+		}
+		blkcnt -= n;
+	}
+
+	return 0;
+}
+
+static int fw_stream_sparse_bad(struct fw_stream *s)
+{
+	printf("Firmware stream: corrupt sparse image at 0x%llx\n", s->image);
+	s->err = -1;
+	return s->err;
+}
+
+/* Act on a completely collected file header, chunk header or fill pattern */
+static int fw_stream_sparse_header(struct fw_stream *s)
+{
+	sparse_header_t *file = (sparse_header_t *)s->sp_hdr;
+	chunk_header_t *chunk = (chunk_header_t *)s->sp_hdr;
+	ulong blksz = s->dev->blksz;
+	lbaint_t blkcnt;
+	u32 total_sz, data_sz, pattern;
+
+	switch (s->sp_state) {
+	case FW_SPARSE_FILE:
+		s->sp_blk_sz = le32_to_cpu(file->blk_sz);
+		s->sp_chunk_hdr_sz = le16_to_cpu(file->chunk_hdr_sz);
+		s->sp_chunks = le32_to_cpu(file->total_chunks);
+
+		if (!s->sp_blk_sz || s->sp_blk_sz % blksz ||
+		    s->sp_chunk_hdr_sz < sizeof(chunk_header_t) ||
+		    le16_to_cpu(file->file_hdr_sz) < sizeof(sparse_header_t))
+			return fw_stream_sparse_bad(s);
+
+		s->sp_skip = le16_to_cpu(file->file_hdr_sz) -
+			     sizeof(sparse_header_t);
+
+		printf("Sparse image: %u blocks of %u bytes in %u chunks\n",
+		       le32_to_cpu(file->total_blks), s->sp_blk_sz,
+		       s->sp_chunks);
+		break;
+
+	case FW_SPARSE_CHUNK:
+		blkcnt = (lbaint_t)le32_to_cpu(chunk->chunk_sz) *
+			 (s->sp_blk_sz / blksz);
+		total_sz = le32_to_cpu(chunk->total_sz);
+
+		if (total_sz < s->sp_chunk_hdr_sz)
+			return fw_stream_sparse_bad(s);
+
+		data_sz = total_sz - s->sp_chunk_hdr_sz;
+		s->sp_skip = s->sp_chunk_hdr_sz - sizeof(chunk_header_t);
+		s->sp_chunks--;
+
+		switch (le16_to_cpu(chunk->chunk_type)) {
+		case CHUNK_TYPE_RAW:
+			if (data_sz != blkcnt * blksz)
+				return fw_stream_sparse_bad(s);
+			if (data_sz) {
+				s->sp_state = FW_SPARSE_RAW;
+				s->sp_want = data_sz;
+				return 0;
+			}
+			break;
+
+		case CHUNK_TYPE_FILL:
+			if (data_sz != sizeof(u32))
+				return fw_stream_sparse_bad(s);
+			s->sp_state = FW_SPARSE_FILL;
+			s->sp_want = sizeof(u32);
+			s->sp_fill_blks = blkcnt;
+			return 0;
+
+		case CHUNK_TYPE_DONT_CARE:
+			if (fw_stream_skip(s, blkcnt))
+				return s->err;
+			s->sp_skip += data_sz;
+			break;
+
+		case CHUNK_TYPE_CRC32:
+			s->sp_skip += data_sz;
+			break;
+
+		default:
+			return fw_stream_sparse_bad(s);
+		}
+		break;
+
+	case FW_SPARSE_FILL:
+		memcpy(&pattern, s->sp_hdr, sizeof(pattern));
+		if (fw_stream_fill(s, pattern, s->sp_fill_blks))
+			return s->err;
+		break;
+
+	default:
+		return fw_stream_sparse_bad(s);
+	}
+
+	/* Next chunk header, if any */
+	if (s->sp_chunks) {
+		s->sp_state = FW_SPARSE_CHUNK;
+		s->sp_want = sizeof(chunk_header_t);
+	} else {
+		s->sp_state = FW_SPARSE_DONE;
+	}
+
+	return 0;
+}
+
+static int fw_stream_sparse(struct fw_stream *s, const uchar *src, ulong len)
+{
+	ulong n;
+
+	while (len) {
+		if (s->sp_skip) {
+			n = min(len, s->sp_skip);
+			s->sp_skip -= n;
+		} else if (s->sp_state == FW_SPARSE_DONE) {
+			/* Trailing bytes after the last chunk are ignored */
+			n = len;
+		} else if (s->sp_state == FW_SPARSE_RAW) {
+			n = min(len, s->sp_want);
+			if (fw_stream_put(s, src, n))
+				return s->err;
+			s->sp_want -= n;
+			if (!s->sp_want) {
+				s->sp_state = s->sp_chunks ? FW_SPARSE_CHUNK :
+							     FW_SPARSE_DONE;
+				s->sp_want = sizeof(chunk_header_t);
+			}
+		} else {
+			n = min(len, s->sp_want - s->sp_hlen);
+			memcpy(s->sp_hdr + s->sp_hlen, src, n);
+			s->sp_hlen += n;
+			if (s->sp_hlen == s->sp_want) {
+				s->sp_hlen = 0;
+				if (fw_stream_sparse_header(s))
+					return s->err;
+			}
+		}
+
+		s->image += n;
+		src += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+/* Take decoded image data, from the decompressor or straight from input */
+static int fw_stream_image(void *priv, const void *buf, ulong len)
+{
+	struct fw_stream *s = priv;
+	ulong n;
+	int ret;
+
+	/* The first chunk may be short; collect a whole file header first */
+	if (!s->sp_known) {
+		n = min(len, sizeof(sparse_header_t) - s->sp_hlen);
+		memcpy(s->sp_hdr + s->sp_hlen, buf, n);
+		s->sp_hlen += n;
+		s->image += n;
+		buf += n;
+		len -= n;
+		if (s->sp_hlen < sizeof(sparse_header_t))
+			return 0;
+
+		s->sp_known = 1;
+		s->sp_hlen = 0;
+		s->sparse = is_sparse_image(s->sp_hdr);
+		if (s->sparse) {
+			s->sp_state = FW_SPARSE_FILE;
+			s->sp_want = sizeof(sparse_header_t);
+			s->sp_skip = 0;
+			if (fw_stream_sparse_header(s))
+				return s->err;
+		} else if (fw_stream_put(s, s->sp_hdr,
+					 sizeof(sparse_header_t))) {
+			return s->err;
+		}
+	}
+
+	if (s->sparse)
+		return fw_stream_sparse(s, buf, len);
+
+	ret = fw_stream_put(s, buf, len);
+	if (!ret)
+		s->image += len;
+
+	return ret;
+}
+
+static void fw_stream_unzip_end(struct fw_stream *s)
+{
+	if (s->gz)
+		gzstream_close(s->gz);
+	s->gz = NULL;
+#ifdef CONFIG_LZ4
+	if (s->lz4)
+		ulz4stream_close(s->lz4);
+	s->lz4 = NULL;
+#endif
+}
+
+/* Start a decompressor if the image begins with a gzip or LZ4 magic */
+static int fw_stream_unzip_start(struct fw_stream *s, const uchar *buf,
+				 ulong len)
+{
+	if (len >= 2 && buf[0] == 0x1f && buf[1] == 0x8b) {
+		printf("Firmware stream: gzip image\n");
+		s->gz = gzstream_open(s->slot_size, fw_stream_image, s);
+		if (!s->gz)
+			goto nomem;
+	}
+#ifdef CONFIG_LZ4
+	else if (len >= 4 && get_unaligned_le32(buf) == 0x184D2204) {
+		printf("Firmware stream: LZ4 image\n");
+		s->lz4 = ulz4stream_open(fw_stream_image, s);
+		if (!s->lz4)
+			goto nomem;
+	}
+#endif
+
+	return 0;
+
+nomem:
+	printf("Firmware stream: out of memory\n");
+	return -1;
+}
+
+/* Pass stored data on to the decompressor, if any, or to the image */
+static int fw_stream_decode(struct fw_stream *s, const uchar *buf, ulong len)
+{
+	if (s->gz)
+		return gzstream_write(s->gz, buf, len);
+#ifdef CONFIG_LZ4
+	if (s->lz4)
+		return ulz4stream_write(s->lz4, buf, len);
+#endif
+	return fw_stream_image(s, buf, len);
+}
+
+int fw_stream_open(int mmc_dev, lbaint_t start_blk)
+{
+	struct fw_stream *s = &fw_stream;
+	struct mmc *mmc;
+	ulong grp;
+
+	if (s->active)
+		fw_stream_abort();
+
+	mmc = find_mmc_device(mmc_dev);
+
+	if (!mmc || mmc_init(mmc)) {
+		printf("no mmc device at MMC%d\n", mmc_dev);
+		return -1;
+	}
+
+	memset(s, 0, sizeof(*s));
+	s->mmc = mmc;
+	s->dev = &mmc->block_dev;
+	s->slot_size = CONFIG_MOXA_FW_STREAM_SLOT_SIZE;
+	s->slot_size -= s->slot_size % s->dev->blksz;
+
+	/* Whole erase groups per slot, the card programs them fastest */
+	grp = mmc->erase_grp_size * s->dev->blksz;
+	if (grp && s->slot_size >= grp)
+		s->slot_size -= s->slot_size % grp;
+	s->ring = memalign(ARCH_DMA_MINALIGN,
+			   s->slot_size * CONFIG_MOXA_FW_STREAM_SLOTS);
+
+	if (!s->ring) {
+		printf("Firmware stream: out of memory\n");
+		return -1;
+	}
+
+	s->start_blk = start_blk;
+	s->next_blk = start_blk;
+	s->max_blk = s->dev->lba;
+	s->time_start = get_timer(0);
+	s->active = 1;
+
+#ifdef CONFIG_MOXA_FW_MMC_CACHE
+	if (mmc_cache_ctrl(mmc, 1) == 0)
+		s->cache = 1;
+#endif
+
+	return 0;
+}
+
+/* Write at most one queued slot, or all of them when @all is set. */
+int fw_stream_flush(int all)
+{
+	struct fw_stream *s = &fw_stream;
+
+	if (!s->active || s->err)
+		return s->err;
+
+	while (s->queued) {
+		if (fw_stream_write_blocks(s, fw_stream_slot(s, s->tail),
+					   s->slot_size / s->dev->blksz)) {
+			s->err = -1;
+			break;
+		}
+
+		s->tail = (s->tail + 1) % CONFIG_MOXA_FW_STREAM_SLOTS;
+		s->queued--;
+
+		if (!all)
+			break;
+	}
+
+	return s->err;
+}
+
+/*
+ * Start over at the beginning of the image, for a transfer that is run
+ * again from its first byte, e.g. TFTP after a timeout.
+ */
+void fw_stream_restart(void)
+{
+	struct fw_stream *s = &fw_stream;
+
+	if (!s->active || s->err || !s->offset)
+		return;
+
+	fw_stream_unzip_end(s);
+	s->head = s->tail = s->queued = 0;
+	s->fill = 0;
+	s->offset = 0;
+	s->image = 0;
+	s->next_blk = s->start_blk;
+	s->skipped = 0;
+	s->sp_known = 0;
+	s->sp_hlen = 0;
+	s->zip_known = 0;
+	s->magic_len = 0;
+}
+
+/*
+ * Accept @len bytes which belong at byte @offset of the image. Data has
+ * to arrive in order, from offset 0 or from fw_stream_restart() on.
+ */
+int fw_stream_store(unsigned long long offset, const void *buf, ulong len)
+{
+	struct fw_stream *s = &fw_stream;
+	ulong n;
+
+	if (!s->active || s->err)
+		return -1;
+
+	if (offset != s->offset) {
+		printf("Firmware stream: unexpected offset 0x%llx\n", offset);
+		s->err = -1;
+		return s->err;
+	}
+
+	/* The first chunk may be short; collect the whole magic first */
+	if (!s->zip_known) {
+		n = min(len, sizeof(s->magic) - s->magic_len);
+		memcpy(s->magic + s->magic_len, buf, n);
+		s->magic_len += n;
+		s->offset += n;
+		buf += n;
+		len -= n;
+		if (s->magic_len < sizeof(s->magic))
+			return 0;
+
+		s->zip_known = 1;
+		if (fw_stream_unzip_start(s, s->magic, s->magic_len) ||
+		    fw_stream_decode(s, s->magic, s->magic_len)) {
+			s->err = -1;
+			return s->err;
+		}
+	}
+
+	if (len && fw_stream_decode(s, buf, len)) {
+		s->err = -1;
+		return s->err;
+	}
+
+	s->offset += len;
+
+	return 0;
+}
+
+void fw_stream_abort(void)
+{
+	struct fw_stream *s = &fw_stream;
+
+	fw_stream_unzip_end(s);
+	if (s->mmc)
+		mmc_wait_prog(s->mmc);
+	if (s->cache)
+		mmc_cache_ctrl(s->mmc, 0);
+	free(s->ring);
+	memset(s, 0, sizeof(*s));
+}
+
+int fw_stream_close(void)
+{
+	struct fw_stream *s = &fw_stream;
+	ulong blksz;
+	ulong elapsed;
+	int ret;
+
+	if (!s->active)
+		return -1;
+
+	/*
+	 * The transfer leaves the file size at 0 for a streamed image, so
+	 * its success alone does not show that any data arrived.
+	 */
+	if (!s->offset) {
+		printf("Firmware stream: no data received\n");
+		ret = -1;
+		goto EXIT;
+	}
+
+	/* An image shorter than the magic cannot be compressed */
+	if (!s->zip_known && s->magic_len) {
+		s->zip_known = 1;
+		ret = fw_stream_image(s, s->magic, s->magic_len);
+		if (ret)
+			goto EXIT;
+	}
+
+	if (s->gz) {
+		ret = gzstream_close(s->gz);
+		s->gz = NULL;
+		if (ret)
+			goto EXIT;
+	}
+#ifdef CONFIG_LZ4
+	if (s->lz4) {
+		ret = ulz4stream_close(s->lz4);
+		s->lz4 = NULL;
+		if (ret)
+			goto EXIT;
+	}
+#endif
+
+	/* An image shorter than a sparse header is written as it is */
+	if (!s->sp_known && s->sp_hlen) {
+		s->sp_known = 1;
+		ret = fw_stream_put(s, s->sp_hdr, s->sp_hlen);
+		if (ret)
+			goto EXIT;
+	}
+
+	if (s->sparse && s->sp_state != FW_SPARSE_DONE) {
+		printf("Firmware stream: sparse image is truncated\n");
+		ret = -1;
+		goto EXIT;
+	}
+
+	ret = fw_stream_flush(1);
+
+	/* Pad the partial tail slot up to a whole block */
+	if (!ret && s->fill) {
+		blksz = s->dev->blksz;
+		memset(fw_stream_slot(s, s->head) + s->fill, 0,
+		       roundup(s->fill, blksz) - s->fill);
+		ret = fw_stream_write_blocks(s, fw_stream_slot(s, s->head),
+					     DIV_ROUND_UP(s->fill, blksz));
+	}
+
+	if (!ret && mmc_wait_prog(s->mmc)) {
+		printf("MMC programming fail\n");
+		ret = -1;
+	}
+
+	/* Nothing is on the flash before the cache is written back */
+	if (!ret && s->cache) {
+		s->cache = 0;
+		if (mmc_cache_ctrl(s->mmc, 0)) {
+			printf("MMC cache flush fail\n");
+			ret = -1;
+		}
+	}
+
+	if (!ret) {
+		elapsed = get_timer(s->time_start);
+		printf("Firmware stream: %llu bytes to block 0x" LBAF
+		       " in %lu ms\n", s->image, s->start_blk, elapsed);
+		if (s->image != s->offset)
+			printf("Firmware stream: %llu bytes received\n",
+			       s->offset);
+		if (s->sparse)
+			printf("Firmware stream: wrote " LBAFU
+			       " blocks, skipped " LBAFU "\n",
+			       s->next_blk - s->start_blk - s->skipped,
+			       s->skipped);
+	}
+
+EXIT:
+	fw_stream_abort();
+
+	return ret;
+}
+
 int download_bios(const char *name)
 {
 	int ret = 0;
@@ -81,48 +797,32 @@ EXIT:
 
 int mirror_mmc_to_mmc (int from_mmc, int dest_mmc, u32 total_blk)
 {
+	struct mmc *src;
+	struct mmc *dst;
+	int cache = 0;
 	int ret = 0;
-	u32 remain_blk = total_blk;
-	u32 finish_blk = 0;
-	u32 mirror_size = 0x60000;
-	char cmd[MAX_SIZE_256BYTE];
-	int retry;
-
-	retry = 0;
 
-	while (remain_blk > 0) {
-		
-		if (retry > 3) {
-			printf ("Mirror MMC%d to MMC%d Fail...\n", from_mmc, dest_mmc);
-			ret = (-1);
-			break;
-		}
+	src = find_mmc_device (from_mmc);
+	dst = find_mmc_device (dest_mmc);
 
-		sprintf (cmd, "mmc rescan && mmc dev %d && mmc read 0x80000000 0x%x 0x%x && mmc dev %d\
-			 && mmc write	0x80000000 0x%x 0x%x", from_mmc, dest_mmc, finish_blk, mirror_size,\
-								 finish_blk, mirror_size);
-	
-		printf ("%s\n", cmd);
-		
-		ret = run_command (cmd, 0);
-		
-		if (ret != 0) {
-			retry++;
-			continue;
-		}
+	if (!src || !dst)
+		return -1;
 
-		finish_blk += mirror_size;
-		
-		if (finish_blk == total_blk)
-			break;
+	printf ("Mirror MMC%d to MMC%d, 0x%x blocks\n", from_mmc, dest_mmc,
+		total_blk);
 
-		if (remain_blk > mirror_size)
-			remain_blk -= mirror_size;
+#ifdef CONFIG_MOXA_FW_MMC_CACHE
+	cache = (mmc_cache_ctrl (dst, 1) == 0);
+#endif
 
-		if (remain_blk < mirror_size)
-			mirror_size = remain_blk;
+	if (mmc_bcopy (src, dst, 0, total_blk) != total_blk) {
+		printf ("Mirror MMC%d to MMC%d Fail...\n", from_mmc, dest_mmc);
+		ret = -1;
+	}
 
-		retry = 0;
+	if (cache && mmc_cache_ctrl (dst, 0)) {
+		printf ("MMC%d cache flush fail\n", dest_mmc);
+		ret = -1;
 	}
 
 	return ret;
@@ -193,54 +893,79 @@ int do_download_firmware_mirror_mmc(void)
 }
 
 
-int copy_file_to_mmc(char *fw_name, signed long long fw_size, int fw_blk, uint mmc_blk_len, int from_mmc, int to_mmc)
+/*
+ * Copy a firmware file from the FAT partition of @from_mmc to @to_mmc.
+ * The file is opened once and read window by window through the FAT file
+ * handle, so every window continues from the cluster the previous one
+ * stopped at instead of walking the FAT chain from the start again.
+ */
+int copy_file_to_mmc(char *fw_name, signed long long fw_size, int from_mmc, int to_mmc)
 {
 	int ret = 0;
-	char cmd[MAX_SIZE_256BYTE];
-	u32 rlen = 0xC000000;
-	u32 wlen = rlen / mmc_blk_len;
-	u32 roffset = 0;
-	u32 woffset = 0;
-	signed long long remain_len = fw_size;
-	signed long long finish_len = 0;
+	char dev_part[MAX_SIZE_16BYTE];
+	struct fs_file *file = NULL;
+	ulong buf = 0x80000000;
+	loff_t rlen = MOXA_FW_COPY_WINDOW;
+	loff_t offset = 0;
+	loff_t len;
+	loff_t actread;
 	int retry = 0;
 
-	while (remain_len > 0) {
+	sprintf (dev_part, "%d:1", from_mmc);
+
+	if (fs_set_blk_dev ("mmc", dev_part, FS_TYPE_FAT)) {
+		printf ("no mmc device at MMC%d...\n", from_mmc);
+		return -1;
+	}
+
+	file = fs_fopen (fw_name);
+
+	if (!file) {
+		printf ("Open %s fail...\n", fw_name);
+		return -1;
+	}
+
+	if (fw_stream_open (to_mmc, 0)) {
+		ret = -1;
+		goto EXIT;
+	}
+
+	while (offset < fw_size) {
 
 		if (retry > 3) {
 			printf ("Copy file ERROR...\n");
 			ret = (-1);
 			break;
 		}
-		
-		sprintf (cmd, "mmc rescan && mmc dev %d && fatload mmc %d:1 0x80000000 %s 0x%x 0x%x \
-			&& mmc write 0x80000000 0x%x 0x%x", to_mmc, from_mmc, fw_name, rlen, roffset, woffset, wlen);
 
-		printf ("%lld %lld\n", finish_len, remain_len);
-		printf ("%s\n", cmd);
+		len = min(rlen, fw_size - offset);
 
-		ret = run_command (cmd, 0);
-		
-		if (ret != 0) {
+		printf ("\r%lld %lld", offset, fw_size - offset);
+
+		if (fs_fseek (file, offset) ||
+		    fs_fread (file, buf, len, &actread) || actread != len) {
 			retry++;
 			continue;
 		}
 
-		finish_len += rlen;
-		roffset += rlen;
-		woffset += wlen;
-		remain_len -= rlen;
-
-		if (remain_len < rlen) {
-			rlen = remain_len;
-			wlen = remain_len / mmc_blk_len;
-			
-			if (remain_len % mmc_blk_len)
-				wlen++;
-			
-		}
+		ret = fw_stream_store (offset, (void *)buf, len);
+
+		if (ret != 0)
+			break;
+
+		offset += len;
 	}
 
+	printf ("\n");
+
+	if (ret == 0)
+		ret = fw_stream_close ();
+	else
+		fw_stream_abort ();
+
+EXIT:
+	fs_fclose (file);
+
 	return ret;
 }
 
@@ -283,7 +1008,13 @@ int mmc_firmware_upgrade (char *fw_name, int from_mmc, int dest_mmc)
 	mmc = find_mmc_device (1);
 
 	if (mmc) {
-		mmc_init (mmc);
+		ret = mmc_init (mmc);
+
+		if (ret) {
+			printf ("no mmc device at MOXA_MMC2\n");
+			goto EXIT;
+		}
+
 		emmc_blk = mmc->capacity / mmc->read_bl_len;
 		fw_blk = fw_size / mmc->read_bl_len;
 		
@@ -292,13 +1023,15 @@ int mmc_firmware_upgrade (char *fw_name, int from_mmc, int dest_mmc)
 
 		if (fw_blk > emmc_blk) {
 			printf ("Firmware File size is larger than eMMC size\n");
+			ret = -1;
 			goto EXIT;
 		}
 
-		copy_file_to_mmc (fw_name, fw_size, fw_blk, mmc->read_bl_len, MOXA_MMC0, MOXA_MMC1);
+		ret = copy_file_to_mmc (fw_name, fw_size, MOXA_MMC0, MOXA_MMC1);
 
 	} else {
 		printf ("no mmc device at MOXA_MMC2\n");
+		ret = -1;
 	}
 
 EXIT:
@@ -311,52 +1044,8 @@ int download_firmware_copy_from_file (char *fw_name)
 	return mmc_firmware_upgrade(fw_name, MOXA_MMC0, MOXA_MMC1);
 }
 
-int copy_file_to_emmc (unsigned int fw_size)
-{
-
-	int ret = 0;
-	char cmd[MAX_SIZE_128BYTE];
-	u32 wlen = 0;
-	unsigned int w_size = 0;
-	
-	wlen = fw_size % EMMC_COPY_LIMIT_SIZE;
-
-	if (fw_size > EMMC_COPY_LIMIT_SIZE){
-		w_size = fw_size - EMMC_COPY_LIMIT_SIZE;
-	}
-
-	if (wlen == 0){
-		w_size = (fw_size - EMMC_COPY_LIMIT_SIZE) / 512;
-		wlen = (EMMC_COPY_LIMIT_SIZE / 512);
-	}else{
-		w_size = (fw_size - wlen) / 512;
-		wlen = (wlen / 512) ;
-	}
-
-	sprintf (cmd, "mmc rescan");
-	ret = run_command (cmd, 0);
-
-	sprintf (cmd, "mmc dev 1");
-	ret = run_command (cmd, 0);
-	
-	sprintf (cmd, "mmc write 0x81000000 0x%x 0x%x", w_size, wlen);
-	ret = run_command (cmd, 0);
-	
-	printf("cmd:%s, w_size:%d, wlen:%x\n", cmd, w_size, wlen);
-	
-	return ret;
-}
-
-int copy_tftp_firmware_to_emmc (void)
-{
-	int ret = 0;
-
-	ret = copy_file_to_emmc (fw_tftp_size);
-
-	return ret;
-}
-
-int tftp_download_firmware (char *fw_name)
+/* Fetch fw_name with the network command proto straight into MMC1 */
+static int net_download_firmware (const char *proto, char *fw_name)
 {
 	int ret = 0;
 	char cmd[MAX_SIZE_256BYTE] = {0};
@@ -374,25 +1063,40 @@ int tftp_download_firmware (char *fw_name)
 		goto EXIT;
 	}
 
+	if ((ret = fw_stream_open(MOXA_MMC1, 0)) != 0)
+		goto EXIT;
+
 	tftp_upgrade_start = 1;
 	
-	sprintf (cmd, "tftp 0x81000000 %s", fw_name);
+	sprintf (cmd, "%s 0x81000000 %s", proto, fw_name);
 
 	if ((ret = run_command (cmd, 0)) != 0) {
-                printf ("TFTP BIOS file transfer fail.\r\n");
-		fw_tftp_size = 0;
+                printf ("%s BIOS file transfer fail.\r\n", proto);
                 tftp_upgrade_start = 0;
+		fw_stream_abort();
 		goto EXIT;
 	}
 
-	fw_tftp_size = 0;
 	tftp_upgrade_start = 0;
+	ret = fw_stream_close();
 
 EXIT:
 	return ret;
 
 }
 
+int tftp_download_firmware (char *fw_name)
+{
+	return net_download_firmware("tftp", fw_name);
+}
+
+#ifdef CONFIG_MOXA_HTTP_UPGRADE
+int http_download_firmware (char *fw_name)
+{
+	return net_download_firmware("httpget", fw_name);
+}
+#endif
+
 int tftp_setting_default(void)
 {
 	int ret;
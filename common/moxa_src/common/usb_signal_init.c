@@ -6,6 +6,7 @@
 
 #include <common.h>
 #include <command.h>
+#include <errno.h>
 #include <memalign.h>
 #include <usb.h>
 #include <gps.h>
@@ -47,13 +48,176 @@ int check_modules_init_time(const char model_name[]){
 
 }
 
-int usb_signal_init(struct usb_device *dev, int init_type)
+/* Upper bound for a cellular module to show up after power on, in ms */
+#define USB_SIGNAL_ENUM_TIMEOUT		13000
+#define USB_SIGNAL_POLL_MS		50
+
+extern struct _rf_info rf_info[];
+
+/* Does interface @ifd have bulk endpoints @out and @in? (0 = any) */
+static int usb_signal_has_bulk(struct usb_interface *ifd, int out, int in)
 {
+	struct usb_endpoint_descriptor *ep;
+	int found_out = 0;
+	int found_in = 0;
+	int i;
 
-	int cnt = 0;
-	int time = 0;
+	for (i = 0; i < ifd->no_of_ep; i++) {
+		ep = &ifd->ep_desc[i];
+
+		if ((ep->bmAttributes & USB_ENDPOINT_XFERTYPE_MASK) !=
+		    USB_ENDPOINT_XFER_BULK)
+			continue;
+
+		if (ep->bEndpointAddress & USB_DIR_IN) {
+			if (!in || (ep->bEndpointAddress & 0xf) == in)
+				found_in = 1;
+		} else {
+			if (!out || (ep->bEndpointAddress & 0xf) == out)
+				found_out = 1;
+		}
+	}
+
+	return found_out && found_in;
+}
+
+/*
+ * A module is ready once it exposes the AT command endpoints listed for
+ * it in rf_info[]. For modules not in the table, any interface with a
+ * bulk pair will do.
+ */
+static int usb_signal_ready(struct usb_device *udev)
+{
+	struct usb_interface *ifd;
+	int known = 0;
+	int i, j;
+
+	for (i = 0; rf_info[i].vendor; i++) {
+		if (rf_info[i].vendor != udev->descriptor.idVendor ||
+		    rf_info[i].product != udev->descriptor.idProduct)
+			continue;
+
+		known = 1;
+
+		for (j = 0; j < udev->config.no_of_if; j++) {
+			ifd = &udev->config.if_desc[j];
+
+			if (usb_signal_has_bulk(ifd, rf_info[i].out_bulk,
+						rf_info[i].in_bulk))
+				return 1;
+		}
+	}
+
+	if (known)
+		return 0;
+
+	for (j = 0; j < udev->config.no_of_if; j++) {
+		if (usb_signal_has_bulk(&udev->config.if_desc[j], 0, 0))
+			return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * Drop the device left on the root hub port by a previous enumeration.
+ * Legacy USB can only free the most recently allocated node, which is
+ * the module itself as nothing else hangs off the port.
+ */
+static void usb_signal_release_child(struct usb_device *root)
+{
+	struct usb_device *old = root->children[0];
+
+	root->children[0] = NULL;
+	if (old == NULL)
+		return;
+
+	if (old->devnum == USB_MAX_DEVICE || !usb_get_dev_index(old->devnum))
+		usb_free_device(old->controller);
+}
+
+/*
+ * Wait for the cellular module on root port 1 of the cellular controller.
+ *
+ * Rather than sleeping for the worst case, poll the EHCI root port and
+ * enumerate only that port whenever its connection changes, which also
+ * catches modules that re-enumerate after switching their composition.
+ * Return as soon as the module's interfaces are present. The per-model
+ * time from check_modules_init_time() only bounds how long that may take.
+ * Returns -ETIMEDOUT if the module enumerated but never became ready.
+ */
+static int usb_signal_wait_module(struct usb_device *dev, int restart)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(struct usb_port_status, portsts, 1);
+	struct usb_device *root;
+	struct usb_device *udev = NULL;
+	ulong start = get_timer(0);
+	ulong timeout = USB_SIGNAL_ENUM_TIMEOUT;
+	unsigned short status, change;
+	int ready = 0;
+
+	root = usb_get_dev_index(0);
+
+	if (restart || root == NULL) {
+		usb_stop();
+		usb_init();
+		root = usb_get_dev_index(0);
+	}
+
+	if (root == NULL)
+		return -1;
+
+	printf("Waiting for Module Init...");
+
+	while (get_timer(start) < timeout) {
+		if (usb_get_port_status(root, 1, portsts) < 0)
+			break;
+
+		status = le16_to_cpu(portsts->wPortStatus);
+		change = le16_to_cpu(portsts->wPortChange);
+
+		if ((change & USB_PORT_STAT_C_CONNECTION) ||
+		    ((status & USB_PORT_STAT_CONNECTION) && !root->children[0])) {
+			usb_signal_release_child(root);
+			udev = NULL;
+			usb_hub_port_connect_change(root, 0);
+		}
+
+		if (root->children[0] && root->children[0] != udev) {
+			udev = root->children[0];
+			printf("%s...", udev->prod);
+			/* Now enumerated, give it the per-model time at most */
+			timeout = get_timer(start) +
+				  check_modules_init_time(udev->prod) * 1000;
+		}
+
+		if (udev && usb_signal_ready(udev)) {
+			ready = 1;
+			break;
+		}
+
+		mdelay(USB_SIGNAL_POLL_MS);
+	}
+
+	if (udev == NULL) {
+		printf("not found\n");
+		return -1;
+	}
+
+	if (!ready) {
+		printf("timed out (%lu ms)\n", get_timer(start));
+		return -ETIMEDOUT;
+	}
+
+	printf("Ready! (%lu ms)\n", get_timer(start));
+	*dev = *udev;
+
+	return 0;
+}
+
+static int do_usb_signal_init(struct usb_device *dev, int init_type)
+{
 	int ret = 0;	
-        int delay = 13;
 
 	if(init_type == USB_CELLULAR) {
 		usb_start_port = 0;
@@ -63,26 +227,24 @@ int usb_signal_init(struct usb_device *dev, int init_type)
 		usb_stop_port = 2;
 	}
 
+	if (init_type == USB_CELLULAR) {
+		ret = usb_signal_wait_module(dev, init_type != PRE_USB_INIT);
+
+		if (ret == 0)
+			PRE_USB_INIT = init_type;
+
+		return ret;
+	}
+
 	if((init_type != PRE_USB_INIT) || (init_type == USB_UART) || (usb_get_dev_index(0) == NULL)) {
 		
-		if(init_type == USB_CELLULAR){
-			for (cnt = 0; cnt < delay; cnt++){
-			        printf("wait Cellular module initial. %02d s\r", delay - cnt - 1);
-				udelay(1000*1000);
-			}
-			printf("\n");
-
-//                        do{
-//                        } while (usb_get_dev_index(1) == NULL || (usb_stor_exist() == 0 && usb_get_dev_index(2) == NULL)) ;
-		}else{
-                        if (init_type == USB_FLASH){
-                                PRE_USB_INIT = init_type;
-                                if (usb_stor_exist() == 0)
-                                        return 0;
-                                else
-                                        return -1;
-                        }
-	        }
+                if (init_type == USB_FLASH){
+                        PRE_USB_INIT = init_type;
+                        if (usb_stor_exist() == 0)
+                                return 0;
+                        else
+                                return -1;
+                }
 
                 run_command("usb reset", 0);
                 if(init_type == USB_UART){
@@ -100,19 +262,6 @@ int usb_signal_init(struct usb_device *dev, int init_type)
                 }
 
                 printf("name : %s\n", dev->prod);
-		if(init_type == USB_CELLULAR)
-			printf("Waiting for Module Init...");
-
-		if (init_type == USB_CELLULAR)
-		        time = check_modules_init_time(dev->prod);	
-		else
-			time = 0;
-		
-		for (cnt = 0; cnt < time; cnt++)
-			udelay(1000*1000);
-	
-		if (init_type == USB_CELLULAR)
-			printf("Ready!\n");
 
 		PRE_USB_INIT = init_type;
 	}
@@ -131,14 +280,6 @@ int usb_signal_init(struct usb_device *dev, int init_type)
 
 	if(dev->devnum == 0){
 		run_command("usb start", 0);
-		printf("Waiting for Module Init...");
-		
-		time = check_modules_init_time(dev->prod);
-		
-		for( cnt = 0; cnt < time; cnt++)
-			udelay(1000*1000);
-		
-		printf("Ready!\n");
 		PRE_USB_INIT = init_type;
 	}
 
@@ -155,6 +296,16 @@ int usb_signal_init(struct usb_device *dev, int init_type)
         
 	printf("\n");
 
-EXIT:
+	return ret;
+}
+
+int usb_signal_init(struct usb_device *dev, int init_type)
+{
+	int ret;
+
+	bootstage_start(BOOTSTAGE_ID_MOXA_USB_SIGNAL, "usb_signal_init");
+	ret = do_usb_signal_init(dev, init_type);
+	bootstage_accum(BOOTSTAGE_ID_MOXA_USB_SIGNAL);
+
 	return ret;
 }
@@ -34,6 +34,7 @@
 
 
 #include <common.h>
+#include <blkcache.h>
 #include <command.h>
 #include <dm.h>
 #include <errno.h>
@@ -96,6 +97,10 @@ struct us_data {
 	ccb		*srb;			/* current srb */
 	trans_reset	transport_reset;	/* reset routine */
 	trans_cmnd	transport;		/* transport routine */
+#ifdef CONFIG_USB_EHCI_BULK_QUEUE
+	struct bulk_queue *bulk_in;		/* BBB queues during a read */
+	struct bulk_queue *bulk_out;		/* or write, see below */
+#endif
 };
 
 #ifdef CONFIG_USB_EHCI
@@ -251,6 +256,7 @@ int usb_stor_scan(int mode)
 	usb_disable_asynch(1); /* asynch transfer not allowed */
 
 	usb_stor_reset();
+	blkcache_invalidate(IF_TYPE_USB, -1);
 	for (i = 0; i < USB_MAX_DEVICE; i++) {
 		struct usb_device *dev;
 
@@ -389,6 +395,44 @@ static int us_one_transfer(struct us_data *us, int pipe, char *buf, int length)
 	return 0;
 }
 
+#ifdef CONFIG_USB_EHCI_BULK_QUEUE
+/*
+ * Keep the bulk endpoints of a BBB device on the EHCI schedule for the
+ * commands of one read or write, so they run back to back. While the
+ * queues exist every bulk transfer of the device has to go through them,
+ * as they hold the data toggles; without them usb_bulk_msg() is used.
+ */
+static void usb_stor_queue_stop(struct us_data *us)
+{
+	if (us->bulk_in)
+		destroy_bulk_queue(us->pusb_dev, us->bulk_in);
+	if (us->bulk_out)
+		destroy_bulk_queue(us->pusb_dev, us->bulk_out);
+	us->bulk_in = NULL;
+	us->bulk_out = NULL;
+}
+
+static void usb_stor_queue_start(struct us_data *us, int inlen, int outlen)
+{
+	struct usb_device *dev = us->pusb_dev;
+
+	if (us->protocol != US_PR_BULK)
+		return;
+
+	us->bulk_in = create_bulk_queue(dev, usb_rcvbulkpipe(dev, us->ep_in),
+					inlen + UMASS_BBB_CSW_SIZE);
+	us->bulk_out = create_bulk_queue(dev,
+					 usb_sndbulkpipe(dev, us->ep_out),
+					 outlen + UMASS_BBB_CBW_SIZE);
+	if (!us->bulk_in || !us->bulk_out)
+		usb_stor_queue_stop(us);
+}
+#else
+static inline void usb_stor_queue_start(struct us_data *us, int inlen,
+					int outlen) {}
+static inline void usb_stor_queue_stop(struct us_data *us) {}
+#endif
+
 static int usb_stor_BBB_reset(struct us_data *us)
 {
 	int result;
@@ -409,6 +453,8 @@ static int usb_stor_BBB_reset(struct us_data *us)
 	 * This comment stolen from FreeBSD's /sys/dev/usb/umass.c.
 	 */
 	debug("BBB_reset\n");
+	/* The queues would keep the toggles usb_clear_halt() resets */
+	usb_stor_queue_stop(us);
 	result = usb_control_msg(us->pusb_dev, usb_sndctrlpipe(us->pusb_dev, 0),
 				 US_BBB_RESET,
 				 USB_TYPE_CLASS | USB_RECIP_INTERFACE,
@@ -512,6 +558,17 @@ static int usb_stor_BBB_comdat(ccb *srb, struct us_data *us)
 	/* DST SRC LEN!!! */
 
 	memcpy(cbw->CBWCDB, srb->cmd, srb->cmdlen);
+#ifdef CONFIG_USB_EHCI_BULK_QUEUE
+	if (us->bulk_out) {
+		result = submit_bulk_queue(us->pusb_dev, us->bulk_out, cbw,
+					   UMASS_BBB_CBW_SIZE);
+		if (!result)
+			result = wait_bulk_queue(us->pusb_dev, us->bulk_out,
+						 &actlen);
+		if (result < 0)
+			usb_stor_queue_stop(us);
+	} else
+#endif
 	result = usb_bulk_msg(us->pusb_dev, pipe, cbw, UMASS_BBB_CBW_SIZE,
 			      &actlen, USB_CNTL_TIMEOUT * 5);
 	if (result < 0)
@@ -649,6 +706,53 @@ static int usb_stor_BBB_clear_endpt_stall(struct us_data *us, __u8 endpt)
 	return result;
 }
 
+#ifdef CONFIG_USB_EHCI_BULK_QUEUE
+/*
+ * DATA and STATUS phase on the bulk queues. For reads the CSW is queued
+ * right behind the data on the same QH, so the device can send it without
+ * waiting for the host. Returns 1 with the CSW read, 0 if an endpoint
+ * stalled and the CSW still has to be read with usb_bulk_msg(), or -1.
+ */
+static int usb_stor_BBB_queued(ccb *srb, struct us_data *us, int dir_in,
+			       struct umass_bbb_csw *csw, int *data_actlen)
+{
+	struct usb_device *dev = us->pusb_dev;
+	struct bulk_queue *queue = dir_in ? us->bulk_in : us->bulk_out;
+	__u8 endpt = dir_in ? us->ep_in : us->ep_out;
+	int actlen;
+
+	if (srb->datalen) {
+		if (submit_bulk_queue(dev, queue, srb->pdata, srb->datalen))
+			goto fail;
+		if (dir_in && submit_bulk_queue(dev, us->bulk_in, csw,
+						UMASS_BBB_CSW_SIZE))
+			goto fail;
+		if (wait_bulk_queue(dev, queue, data_actlen))
+			goto stall;
+	}
+
+	endpt = us->ep_in;
+	if ((!dir_in || !srb->datalen) &&
+	    submit_bulk_queue(dev, us->bulk_in, csw, UMASS_BBB_CSW_SIZE))
+		goto fail;
+	if (wait_bulk_queue(dev, us->bulk_in, &actlen))
+		goto stall;
+
+	return 1;
+
+stall:
+	if (dev->status & USB_ST_STALLED) {
+		debug("queued:stall\n");
+		usb_stor_queue_stop(us);
+		return usb_stor_BBB_clear_endpt_stall(us, endpt) < 0 ? -1 : 0;
+	}
+fail:
+	debug("queued bulk error status %ld\n", dev->status);
+	usb_stor_queue_stop(us);
+	return -1;
+}
+#endif
+
 static int usb_stor_BBB_transport(ccb *srb, struct us_data *us)
 {
 	int result, retry;
@@ -678,6 +782,20 @@ static int usb_stor_BBB_transport(ccb *srb, struct us_data *us)
 	pipeout = usb_sndbulkpipe(us->pusb_dev, us->ep_out);
 	/* DATA phase + error handling */
 	data_actlen = 0;
+#ifdef CONFIG_USB_EHCI_BULK_QUEUE
+	if (us->bulk_in) {
+		result = usb_stor_BBB_queued(srb, us, dir_in, csw,
+					     &data_actlen);
+		if (result > 0) {
+			result = 0;
+			goto csw;
+		}
+		if (result == 0)
+			goto st;
+		usb_stor_BBB_reset(us);
+		return USB_STOR_TRANSPORT_FAILED;
+	}
+#endif
 	/* no data, go immediately to the STATUS phase */
 	if (srb->datalen == 0)
 		goto st;
@@ -734,6 +852,9 @@ again:
 		usb_stor_BBB_reset(us);
 		return USB_STOR_TRANSPORT_FAILED;
 	}
+#ifdef CONFIG_USB_EHCI_BULK_QUEUE
+csw:
+#endif
 #ifdef BBB_XPORT_TRACE
 	ptr = (unsigned char *)csw;
 	for (index = 0; index < UMASS_BBB_CSW_SIZE; index++)
@@ -1060,12 +1181,19 @@ unsigned long usb_stor_read(int device, lbaint_t blknr,
 	}
 	ss = (struct us_data *)dev->privptr;
 
+	if (blkcache_read(IF_TYPE_USB, device, blknr, blkcnt,
+			  usb_dev_desc[device].blksz, buffer))
+		return blkcnt;
+
 	usb_disable_asynch(1); /* asynch transfer not allowed */
 	srb->lun = usb_dev_desc[device].lun;
 	buf_addr = (uintptr_t)buffer;
 	start = blknr;
 	blks = blkcnt;
 
+	usb_stor_queue_start(ss, min(blkcnt, (lbaint_t)USB_MAX_XFER_BLK) *
+				 usb_dev_desc[device].blksz, 0);
+
 	debug("\nusb_read: dev %d startblk " LBAF ", blccnt " LBAF
 	      " buffer %" PRIxPTR "\n", device, start, blks, buf_addr);
 
@@ -1096,6 +1224,8 @@ retry_it:
 	} while (blks != 0);
 	ss->flags &= ~USB_READY;
 
+	usb_stor_queue_stop(ss);
+
 	debug("usb_read: end startblk " LBAF
 	      ", blccnt %x buffer %" PRIxPTR "\n",
 	      start, smallblks, buf_addr);
@@ -1103,6 +1233,9 @@ retry_it:
 	usb_disable_asynch(0); /* asynch transfer allowed */
 	if (blkcnt >= USB_MAX_XFER_BLK)
 		debug("\n");
+	if (!blks)
+		blkcache_fill(IF_TYPE_USB, device, blknr, blkcnt,
+			      usb_dev_desc[device].blksz, buffer);
 	return blkcnt;
 }
 
@@ -1128,6 +1261,8 @@ unsigned long usb_stor_write(int device, lbaint_t blknr,
 		return 0;
 	ss = (struct us_data *)dev->privptr;
 
+	blkcache_invalidate(IF_TYPE_USB, device);
+
 	usb_disable_asynch(1); /* asynch transfer not allowed */
 
 	srb->lun = usb_dev_desc[device].lun;
@@ -1135,6 +1270,9 @@ unsigned long usb_stor_write(int device, lbaint_t blknr,
 	start = blknr;
 	blks = blkcnt;
 
+	usb_stor_queue_start(ss, 0, min(blkcnt, (lbaint_t)USB_MAX_XFER_BLK) *
+				    usb_dev_desc[device].blksz);
+
 	debug("\nusb_write: dev %d startblk " LBAF ", blccnt " LBAF
 	      " buffer %" PRIxPTR "\n", device, start, blks, buf_addr);
 
@@ -1167,6 +1305,8 @@ retry_it:
 	} while (blks != 0);
 	ss->flags &= ~USB_READY;
 
+	usb_stor_queue_stop(ss);
+
 	debug("usb_write: end startblk " LBAF ", blccnt %x buffer %"
 	      PRIxPTR "\n", start, smallblks, buf_addr);
 
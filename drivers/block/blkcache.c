@@ -0,0 +1,164 @@
+/*
+ * Block device read cache
+ *
+ * Keeps the last small reads of each block device in an LRU list, so that
+ * the partition tables, boot sectors, FATs and directories every fatload,
+ * ext4load or part command starts with are only read from the card once.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <blkcache.h>
+#include <linux/list.h>
+
+#ifndef CONFIG_BLOCK_CACHE_BLOCKS
+#define CONFIG_BLOCK_CACHE_BLOCKS	16	/* per entry */
+#endif
+#ifndef CONFIG_BLOCK_CACHE_ENTRIES
+#define CONFIG_BLOCK_CACHE_ENTRIES	32
+#endif
+
+struct block_cache_node {
+	struct list_head lh;
+	int iftype;
+	int dev;
+	lbaint_t start;
+	lbaint_t blkcnt;
+	unsigned long blksz;
+	char *cache;
+};
+
+static LIST_HEAD(block_cache);
+
+static struct block_cache_stats _stats = {
+	.max_blocks_per_entry = CONFIG_BLOCK_CACHE_BLOCKS,
+	.max_entries = CONFIG_BLOCK_CACHE_ENTRIES,
+};
+
+/* Entry holding all of the requested blocks, moved to the list head */
+static struct block_cache_node *cache_find(int iftype, int dev,
+					   lbaint_t start, lbaint_t blkcnt,
+					   unsigned long blksz)
+{
+	struct block_cache_node *node;
+
+	list_for_each_entry(node, &block_cache, lh) {
+		if (node->iftype == iftype && node->dev == dev &&
+		    node->blksz == blksz && node->start <= start &&
+		    node->start + node->blkcnt >= start + blkcnt) {
+			if (block_cache.next != &node->lh)
+				list_move(&node->lh, &block_cache);
+			return node;
+		}
+	}
+
+	return NULL;
+}
+
+int blkcache_read(int iftype, int dev, lbaint_t start, lbaint_t blkcnt,
+		  unsigned long blksz, void *buffer)
+{
+	struct block_cache_node *node;
+
+	if (blkcnt > _stats.max_blocks_per_entry)
+		return 0;
+
+	node = cache_find(iftype, dev, start, blkcnt, blksz);
+	if (!node) {
+		_stats.misses++;
+		return 0;
+	}
+
+	memcpy(buffer, node->cache + (start - node->start) * blksz,
+	       blkcnt * blksz);
+	_stats.hits++;
+
+	return 1;
+}
+
+void blkcache_fill(int iftype, int dev, lbaint_t start, lbaint_t blkcnt,
+		   unsigned long blksz, void const *buffer)
+{
+	struct block_cache_node *node;
+	size_t bytes = blkcnt * blksz;
+
+	if (!blkcnt || blkcnt > _stats.max_blocks_per_entry ||
+	    !_stats.max_entries)
+		return;
+
+	if (_stats.entries >= _stats.max_entries) {
+		/* Recycle the least recently used entry */
+		node = list_entry(block_cache.prev, struct block_cache_node,
+				  lh);
+		list_del(&node->lh);
+		_stats.entries--;
+		if (node->blkcnt * node->blksz != bytes) {
+			free(node->cache);
+			node->cache = NULL;
+		}
+	} else {
+		node = malloc(sizeof(*node));
+		if (!node)
+			return;
+		node->cache = NULL;
+	}
+
+	if (!node->cache) {
+		node->cache = malloc(bytes);
+		if (!node->cache) {
+			free(node);
+			return;
+		}
+	}
+
+	debug("%s: %d:%d 0x" LBAF " + " LBAF "\n", __func__, iftype, dev,
+	      start, blkcnt);
+
+	node->iftype = iftype;
+	node->dev = dev;
+	node->start = start;
+	node->blkcnt = blkcnt;
+	node->blksz = blksz;
+	memcpy(node->cache, buffer, bytes);
+	list_add(&node->lh, &block_cache);
+	_stats.entries++;
+}
+
+void blkcache_invalidate(int iftype, int dev)
+{
+	struct block_cache_node *node, *n;
+
+	list_for_each_entry_safe(node, n, &block_cache, lh) {
+		if (node->iftype != iftype || (dev >= 0 && node->dev != dev))
+			continue;
+
+		list_del(&node->lh);
+		free(node->cache);
+		free(node);
+		_stats.entries--;
+	}
+}
+
+void blkcache_configure(unsigned blocks, unsigned entries)
+{
+	struct block_cache_node *node, *n;
+
+	list_for_each_entry_safe(node, n, &block_cache, lh) {
+		list_del(&node->lh);
+		free(node->cache);
+		free(node);
+	}
+
+	_stats.entries = 0;
+	_stats.max_blocks_per_entry = blocks;
+	_stats.max_entries = entries;
+	_stats.hits = 0;
+	_stats.misses = 0;
+}
+
+void blkcache_stats(struct block_cache_stats *stats)
+{
+	memcpy(stats, &_stats, sizeof(*stats));
+}
@@ -7,11 +7,16 @@
 
 #include <common.h>
 #include <malloc.h>
+#include <memalign.h>
+#include <watchdog.h>
 #include "jobdesc.h"
 #include "desc.h"
 #include "jr.h"
 #include "fsl_hash.h"
 #include <hw_sha.h>
+#include <fsl_sec.h>
+#include <u-boot/sha1.h>
+#include <u-boot/sha256.h>
 #include <asm-generic/errno.h>
 
 #define CRYPTO_MAX_ALG_NAME	80
@@ -58,14 +63,44 @@ static enum caam_hash_algos get_hash_type(struct hash_algo *algo)
  */
 static int caam_hash_init(void **ctxp, enum caam_hash_algos caam_algo)
 {
-	*ctxp = calloc(1, sizeof(struct sha_ctx));
+	/* The descriptor, sg table and hash in it are read/written by DMA */
+	*ctxp = memalign(ARCH_DMA_MINALIGN, sizeof(struct sha_ctx));
 	if (*ctxp == NULL) {
 		debug("Cannot allocate memory for context\n");
 		return -ENOMEM;
 	}
+	memset(*ctxp, 0, sizeof(struct sha_ctx));
 	return 0;
 }
 
+/*
+ * Write the buffer back from the data cache so that CAAM reads what the
+ * CPU wrote. Done in chunks with the watchdog kicked in between, as for
+ * the software hashes.
+ *
+ * @buf: Pointer to the buffer being hashed
+ * @size: Size of the buffer being hashed
+ * @chunk_size: Bytes between watchdog kicks
+ */
+static void caam_hash_flush(const void *buf, unsigned int size,
+			    unsigned int chunk_size)
+{
+	unsigned long start = (unsigned long)buf & ~(ARCH_DMA_MINALIGN - 1);
+	unsigned long end = ALIGN((unsigned long)buf + size, ARCH_DMA_MINALIGN);
+	unsigned long chunk;
+
+	if (!chunk_size)
+		chunk_size = size;
+	chunk_size = ALIGN(chunk_size, ARCH_DMA_MINALIGN);
+
+	while (start < end) {
+		chunk = min_t(unsigned long, end - start, chunk_size);
+		flush_dcache_range(start, start + chunk);
+		start += chunk;
+		WATCHDOG_RESET();
+	}
+}
+
 /*
  * Update sg table for progressive hashing using h/w acceleration
  *
@@ -103,6 +138,7 @@ static int caam_hash_update(void *hash_ctx, const void *buf,
 		  (size & SG_ENTRY_LENGTH_MASK));
 
 	ctx->sg_num++;
+	caam_hash_flush(buf, size, 0);
 
 	if (is_last) {
 		final = sec_in32(&ctx->sg_tbl[ctx->sg_num - 1].len_flag) |
@@ -146,53 +182,91 @@ static int caam_hash_finish(void *hash_ctx, void *dest_buf,
 				  driver_hash[caam_algo].alg_type,
 				  driver_hash[caam_algo].digestsize,
 				  1);
+	flush_dcache_range((unsigned long)ctx,
+			   (unsigned long)ctx + sizeof(struct sha_ctx));
 
 	ret = run_descriptor_jr(ctx->sha_desc);
 
-	if (ret)
+	if (ret) {
 		debug("Error %x\n", ret);
-	else
-		memcpy(dest_buf, ctx->hash, sizeof(ctx->hash));
+	} else {
+		invalidate_dcache_range((unsigned long)ctx->hash,
+					(unsigned long)ctx->hash +
+					ALIGN(sizeof(ctx->hash),
+					      ARCH_DMA_MINALIGN));
+		memcpy(dest_buf, ctx->hash, driver_hash[caam_algo].digestsize);
+	}
 
 	free(ctx);
 	return ret;
 }
 
 int caam_hash(const unsigned char *pbuf, unsigned int buf_len,
-	      unsigned char *pout, enum caam_hash_algos algo)
+	      unsigned char *pout, enum caam_hash_algos algo,
+	      unsigned int chunk_size)
 {
+	ALLOC_CACHE_ALIGN_BUFFER(u8, digest, HASH_MAX_DIGEST_SIZE);
 	int ret = 0;
 	uint32_t *desc;
 
-	desc = malloc(sizeof(int) * MAX_CAAM_DESCSIZE);
+	desc = memalign(ARCH_DMA_MINALIGN, sizeof(int) * MAX_CAAM_DESCSIZE);
 	if (!desc) {
 		debug("Not enough memory for descriptor allocation\n");
 		return -ENOMEM;
 	}
 
-	inline_cnstr_jobdesc_hash(desc, pbuf, buf_len, pout,
+	/* The whole image goes in one job; only the cache work is chunked */
+	caam_hash_flush(pbuf, buf_len, chunk_size);
+
+	inline_cnstr_jobdesc_hash(desc, pbuf, buf_len, digest,
 				  driver_hash[algo].alg_type,
 				  driver_hash[algo].digestsize,
 				  0);
+	flush_dcache_range((unsigned long)desc,
+			   (unsigned long)desc +
+			   ALIGN(sizeof(int) * MAX_CAAM_DESCSIZE,
+				 ARCH_DMA_MINALIGN));
+	/* No dirty line may be evicted over what CAAM writes */
+	flush_dcache_range((unsigned long)digest,
+			   (unsigned long)digest +
+			   ALIGN(HASH_MAX_DIGEST_SIZE, ARCH_DMA_MINALIGN));
 
 	ret = run_descriptor_jr(desc);
 
+	if (!ret) {
+		invalidate_dcache_range((unsigned long)digest,
+					(unsigned long)digest +
+					ALIGN(HASH_MAX_DIGEST_SIZE,
+					      ARCH_DMA_MINALIGN));
+		memcpy(pout, digest, driver_hash[algo].digestsize);
+	}
+
 	free(desc);
 	return ret;
 }
 
+/*
+ * Without a working CAAM the digest is computed in software, so that
+ * image verification does not depend on the CAAM coming up.
+ */
 void hw_sha256(const unsigned char *pbuf, unsigned int buf_len,
 			unsigned char *pout, unsigned int chunk_size)
 {
-	if (caam_hash(pbuf, buf_len, pout, SHA256))
-		printf("CAAM was not setup properly or it is faulty\n");
+	if (sec_ready() && !caam_hash(pbuf, buf_len, pout, SHA256, chunk_size))
+		return;
+
+	debug("CAAM not available, SHA256 in software\n");
+	sha256_csum_wd(pbuf, buf_len, pout, chunk_size);
 }
 
 void hw_sha1(const unsigned char *pbuf, unsigned int buf_len,
 			unsigned char *pout, unsigned int chunk_size)
 {
-	if (caam_hash(pbuf, buf_len, pout, SHA1))
-		printf("CAAM was not setup properly or it is faulty\n");
+	if (sec_ready() && !caam_hash(pbuf, buf_len, pout, SHA1, chunk_size))
+		return;
+
+	debug("CAAM not available, SHA1 in software\n");
+	sha1_csum_wd(pbuf, buf_len, pout, chunk_size);
 }
 
 int hw_sha_init(struct hash_algo *algo, void **ctxp)
@@ -28,7 +28,8 @@ struct sha_ctx {
 	uint32_t sg_num;
 	uint32_t len;
 	struct sg_entry sg_tbl[MAX_SG_32];
-	u8 hash[HASH_MAX_DIGEST_SIZE];
+	/* Own cache lines: invalidated after CAAM stored the digest */
+	u8 hash[HASH_MAX_DIGEST_SIZE] __aligned(ARCH_DMA_MINALIGN);
 };
 
 #endif
@@ -18,6 +18,9 @@
 
 struct jobring jr;
 
+/* Set once sec_init() has brought up the job ring and the RNG */
+static int sec_up;
+
 static inline void start_jr0(void)
 {
 	ccsr_sec_t *sec = (void *)CONFIG_SYS_FSL_SEC_ADDR;
@@ -536,6 +539,8 @@ int sec_init(void)
 #endif
 	sec_out32(&sec->mcfgr, mcr);
 
+	sec_up = 0;
+
 	ret = jr_init();
 	if (ret < 0) {
 		printf("SEC initialization failed\n");
@@ -550,5 +555,11 @@ int sec_init(void)
 		printf("SEC: RNG instantiated\n");
 	}
 
+	sec_up = 1;
 	return ret;
 }
+
+int sec_ready(void)
+{
+	return sec_up;
+}
@@ -28,7 +28,7 @@ DECLARE_GLOBAL_DATA_PTR;
 				IRQSTATEN_CTOE | IRQSTATEN_CCE | IRQSTATEN_CEBE | \
 				IRQSTATEN_CIE | IRQSTATEN_DTOE | IRQSTATEN_DCE | \
 				IRQSTATEN_DEBE | IRQSTATEN_BRR | IRQSTATEN_BWR | \
-				IRQSTATEN_DINT)
+				IRQSTATEN_DINT | IRQSTATEN_DMAE)
 
 struct fsl_esdhc {
 	uint    dsaddr;		/* SDMA system address register */
@@ -54,7 +54,9 @@ struct fsl_esdhc {
 	uint    fevt;		/* Force event register */
 	uint    admaes;		/* ADMA error status register */
 	uint    adsaddr;	/* ADMA system address register */
-	char    reserved2[100];	/* reserved */
+	char    reserved2[12];	/* reserved */
+	uint    clktunectrl;	/* Clock tuning control/status register */
+	char    reserved10[84];	/* reserved */
 	uint    vendorspec;	/* Vendor Specific register */
 	char    reserved3[56];	/* reserved */
 	uint    hostver;	/* Host controller version register */
@@ -180,6 +182,133 @@ esdhc_pio_read_write(struct mmc *mmc, struct mmc_data *data)
 }
 #endif
 
+#ifdef CONFIG_FSL_ESDHC_ADMA
+/* Describe @len bytes at @addr from @desc on, return the next free entry */
+static struct fsl_esdhc_adma_desc *
+esdhc_adma_fill(struct fsl_esdhc_adma_desc *desc, ulong addr, ulong len)
+{
+	ulong n;
+
+	while (len) {
+		n = min(len, (ulong)ADMA2_MAX_LEN);
+
+		desc->attr = cpu_to_le16(ADMA2_VALID | ADMA2_ACT_TRAN);
+		desc->len = cpu_to_le16(n);
+		desc->addr = cpu_to_le32(addr);
+
+		desc++;
+		addr += n;
+		len -= n;
+	}
+
+	return desc;
+}
+
+/*
+ * Build the ADMA2 table for @data. A read into a buffer that does not
+ * start or end on a cache line gets those partial lines through the
+ * bounce buffer, so that neither they nor their neighbours are lost to
+ * the cache maintenance. Returns -1 if SDMA has to be used instead.
+ */
+static int esdhc_adma_setup(struct fsl_esdhc_cfg *cfg, struct mmc_data *data)
+{
+	struct fsl_esdhc_adma_desc *desc = cfg->adma_table;
+	ulong len = data->blocks * data->blocksize;
+	ulong start, end, astart, aend;
+
+	cfg->adma_active = 0;
+
+	if (!desc || len > cfg->cfg.b_max * MMC_MAX_BLOCK_LEN)
+		return -1;
+
+	if (data->flags & MMC_DATA_READ)
+		start = (ulong)data->dest;
+	else
+		start = (ulong)data->src;
+
+	/* The controller only takes word aligned addresses */
+	if (start & 3)
+		return -1;
+
+	end = start + len;
+
+	if (data->flags & MMC_DATA_READ) {
+		astart = ALIGN(start, ARCH_DMA_MINALIGN);
+		aend = end & ~(ARCH_DMA_MINALIGN - 1);
+
+		/* No whole line: it all fits the two bounce lines */
+		if (astart >= aend)
+			astart = aend = end;
+
+		cfg->adma_head = astart - start;
+		cfg->adma_tail = end - aend;
+
+		desc = esdhc_adma_fill(desc, (ulong)cfg->adma_bounce,
+				       cfg->adma_head);
+		desc = esdhc_adma_fill(desc, astart, aend - astart);
+		desc = esdhc_adma_fill(desc, (ulong)cfg->adma_bounce +
+				       ARCH_DMA_MINALIGN, cfg->adma_tail);
+	} else {
+		desc = esdhc_adma_fill(desc, start, len);
+	}
+
+	desc[-1].attr |= cpu_to_le16(ADMA2_END);
+
+	flush_dcache_range((ulong)cfg->adma_table,
+			   ALIGN((ulong)desc, ARCH_DMA_MINALIGN));
+
+	cfg->adma_active = 1;
+
+	return 0;
+}
+
+/* Invalidate what the controller is going to write for a table read */
+static void esdhc_adma_invalidate(struct fsl_esdhc_cfg *cfg,
+				  struct mmc_data *data)
+{
+	ulong start = (ulong)data->dest + cfg->adma_head;
+	ulong end = (ulong)data->dest + data->blocks * data->blocksize -
+		    cfg->adma_tail;
+
+	if (end > start)
+		invalidate_dcache_range(start, end);
+
+	invalidate_dcache_range((ulong)cfg->adma_bounce,
+				(ulong)cfg->adma_bounce + 2 * ARCH_DMA_MINALIGN);
+}
+
+/* Copy the partial first and last lines of a table read into place */
+static void esdhc_adma_finish(struct fsl_esdhc_cfg *cfg,
+			      struct mmc_data *data)
+{
+	ulong len = data->blocks * data->blocksize;
+
+	memcpy(data->dest, cfg->adma_bounce, cfg->adma_head);
+	memcpy(data->dest + len - cfg->adma_tail,
+	       cfg->adma_bounce + ARCH_DMA_MINALIGN, cfg->adma_tail);
+}
+
+static void esdhc_adma_init(struct fsl_esdhc_cfg *cfg)
+{
+	ulong entries;
+
+	/* Two extra entries for the bounce lines */
+	entries = DIV_ROUND_UP(cfg->cfg.b_max * MMC_MAX_BLOCK_LEN,
+			       ADMA2_MAX_LEN) + 2;
+
+	cfg->adma_table = memalign(ARCH_DMA_MINALIGN,
+				   entries * sizeof(*cfg->adma_table));
+	cfg->adma_bounce = memalign(ARCH_DMA_MINALIGN, 2 * ARCH_DMA_MINALIGN);
+
+	if (!cfg->adma_table || !cfg->adma_bounce) {
+		printf("fsl_esdhc: no memory for ADMA, using SDMA\n");
+		free(cfg->adma_table);
+		free(cfg->adma_bounce);
+		cfg->adma_table = NULL;
+	}
+}
+#endif
+
 static int esdhc_setup_data(struct mmc *mmc, struct mmc_data *data)
 {
 	int timeout;
@@ -238,6 +367,16 @@ static int esdhc_setup_data(struct mmc *mmc, struct mmc_data *data)
 
 	esdhc_write32(&regs->blkattr, data->blocks << 16 | data->blocksize);
 
+#ifdef CONFIG_FSL_ESDHC_ADMA
+	if (esdhc_adma_setup(cfg, data) == 0) {
+		esdhc_write32(&regs->adsaddr, (u32)cfg->adma_table);
+		esdhc_clrsetbits32(&regs->proctl, PROCTL_DMAS_MASK,
+				   PROCTL_DMAS_ADMA2);
+	} else {
+		esdhc_clrbits32(&regs->proctl, PROCTL_DMAS_MASK);
+	}
+#endif
+
 	/* Calculate the timeout period for data transactions */
 	/*
 	 * 1)Timeout period = (2^(timeout+13)) SD Clock cycles
@@ -276,8 +415,12 @@ static int esdhc_setup_data(struct mmc *mmc, struct mmc_data *data)
 }
 
 static void check_and_invalidate_dcache_range
-	(struct mmc_cmd *cmd,
+	(struct mmc *mmc,
+	 struct mmc_cmd *cmd,
 	 struct mmc_data *data) {
+#ifdef CONFIG_FSL_ESDHC_ADMA
+	struct fsl_esdhc_cfg *cfg = mmc->priv;
+#endif
 #ifdef CONFIG_FSL_LAYERSCAPE
 	unsigned start = 0;
 #else
@@ -288,7 +431,15 @@ static void check_and_invalidate_dcache_range
 	unsigned end = start+size ;
 #ifdef CONFIG_FSL_LAYERSCAPE
 	dma_addr_t addr;
+#endif
 
+#ifdef CONFIG_FSL_ESDHC_ADMA
+	if (cfg->adma_active) {
+		esdhc_adma_invalidate(cfg, data);
+		return;
+	}
+#endif
+#ifdef CONFIG_FSL_LAYERSCAPE
 	addr = virt_to_phys((void *)(data->dest));
 	if (upper_32_bits(addr))
 		printf("Error found for upper 32 bits\n");
@@ -342,7 +493,7 @@ esdhc_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd, struct mmc_data *data)
 			return err;
 
 		if (data->flags & MMC_DATA_READ)
-			check_and_invalidate_dcache_range(cmd, data);
+			check_and_invalidate_dcache_range(mmc, cmd, data);
 	}
 
 	/* Figure out the transfer arguments */
@@ -378,15 +529,6 @@ esdhc_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd, struct mmc_data *data)
 		goto out;
 	}
 
-	/* Switch voltage to 1.8V if CMD11 succeeded */
-	if (cmd->cmdidx == SD_CMD_SWITCH_UHS18V) {
-		esdhc_setbits32(&regs->vendorspec, ESDHC_VENDORSPEC_VSELECT);
-
-		printf("Run CMD11 1.8V switch\n");
-		/* Sleep for 5 ms - max time for card to switch to 1.8V */
-		udelay(5000);
-	}
-
 	/* Workaround for ESDHC errata ENGcm03648 */
 	if (!data && (cmd->resp_type & MMC_RSP_BUSY)) {
 		int timeout = 6000;
@@ -434,6 +576,10 @@ esdhc_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd, struct mmc_data *data)
 			}
 
 			if (irqstat & DATA_ERR) {
+				if (irqstat & IRQSTAT_DMAE)
+					debug("fsl_esdhc: DMA error %x at %x\n",
+					      esdhc_read32(&regs->admaes),
+					      esdhc_read32(&regs->adsaddr));
 				err = COMM_ERR;
 				goto out;
 			}
@@ -444,8 +590,13 @@ esdhc_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd, struct mmc_data *data)
 		 * cache-fill during the DMA operations such as the
 		 * speculative pre-fetching etc.
 		 */
-		if (data->flags & MMC_DATA_READ)
-			check_and_invalidate_dcache_range(cmd, data);
+		if (data->flags & MMC_DATA_READ) {
+			check_and_invalidate_dcache_range(mmc, cmd, data);
+#ifdef CONFIG_FSL_ESDHC_ADMA
+			if (cfg->adma_active)
+				esdhc_adma_finish(cfg, data);
+#endif
+		}
 #endif
 	}
 
@@ -493,6 +644,12 @@ static void set_sysctl(struct mmc *mmc, uint clock)
 	} else
 		pre_div = 2;
 
+#ifdef CONFIG_FSL_USDHC
+	/* uSDHC can pass the base clock through undivided, as HS200 needs */
+	if (!mmc->ddr_mode && clock >= sdhc_clk)
+		pre_div = 1;
+#endif
+
 	for (div = 1; div <= 16; div++)
 		if ((sdhc_clk / (div * pre_div)) <= clock)
 			break;
@@ -564,6 +721,17 @@ static void esdhc_set_ios(struct mmc *mmc)
 	/* Set the clock speed */
 	set_sysctl(mmc, mmc->clock);
 
+	/* The core gates the card clock during the UHS-I voltage switch */
+#ifdef CONFIG_FSL_USDHC
+	if (mmc->clk_disable)
+		esdhc_clrbits32(&regs->vendorspec, ESDHC_VENDORSPEC_CKEN);
+	else
+		esdhc_setbits32(&regs->vendorspec, ESDHC_VENDORSPEC_CKEN);
+#else
+	if (mmc->clk_disable)
+		esdhc_clrbits32(&regs->sysctl, SYSCTL_CKEN);
+#endif
+
 	/* Set the bus width */
 	esdhc_clrbits32(&regs->proctl, PROCTL_DTW_4 | PROCTL_DTW_8);
 
@@ -572,8 +740,88 @@ static void esdhc_set_ios(struct mmc *mmc)
 	else if (mmc->bus_width == 8)
 		esdhc_setbits32(&regs->proctl, PROCTL_DTW_8);
 
+#ifdef CONFIG_FSL_USDHC
+	if (mmc->signal_voltage == MMC_SIGNAL_VOLTAGE_180)
+		esdhc_setbits32(&regs->vendorspec, ESDHC_VENDORSPEC_VSELECT);
+#ifndef CONFIG_SYS_FSL_ESDHC_FORCE_VSELECT
+	else
+		esdhc_clrbits32(&regs->vendorspec, ESDHC_VENDORSPEC_VSELECT);
+#endif
+
+	/* Changing the clock reset the controller, restore the tuning */
+	if (mmc->timing == MMC_TIMING_MMC_HS200 ||
+	    mmc->timing == MMC_TIMING_UHS_SDR50 ||
+	    mmc->timing == MMC_TIMING_UHS_SDR104) {
+		esdhc_setbits32(&regs->mixctrl, ESDHC_MIX_CTRL_SMPCLK_SEL |
+				ESDHC_MIX_CTRL_FBCLK_SEL |
+				ESDHC_MIX_CTRL_AUTO_TUNE_EN);
+		esdhc_write32(&regs->clktunectrl, cfg->tune_val << 8);
+	}
+#endif
+}
+
+#ifdef CONFIG_FSL_USDHC
+static void esdhc_prepare_tuning(struct fsl_esdhc *regs, int val)
+{
+	esdhc_setbits32(&regs->mixctrl, ESDHC_MIX_CTRL_EXE_TUNE |
+			ESDHC_MIX_CTRL_SMPCLK_SEL | ESDHC_MIX_CTRL_FBCLK_SEL);
+	esdhc_write32(&regs->clktunectrl, val << 8);
 }
 
+/*
+ * Manual tuning: sweep the sampling delay line, sending the tuning block
+ * at every step, and settle in the middle of the first passing window.
+ */
+static int esdhc_execute_tuning(struct mmc *mmc, uint opcode)
+{
+	struct fsl_esdhc_cfg *cfg = mmc->priv;
+	struct fsl_esdhc *regs = (struct fsl_esdhc *)cfg->esdhc_base;
+	int min, max;
+	int err;
+
+	esdhc_clrbits32(&regs->mixctrl, ESDHC_MIX_CTRL_AUTO_TUNE_EN);
+
+	/* First delay that passes */
+	for (min = ESDHC_TUNE_CTRL_MIN; min < ESDHC_TUNE_CTRL_MAX;
+	     min += ESDHC_TUNE_CTRL_STEP) {
+		esdhc_prepare_tuning(regs, min);
+		if (!mmc_send_tuning(mmc, opcode))
+			break;
+	}
+
+	if (min >= ESDHC_TUNE_CTRL_MAX) {
+		err = -EIO;
+		goto out;
+	}
+
+	/* Last delay that passes */
+	for (max = min + ESDHC_TUNE_CTRL_STEP; max < ESDHC_TUNE_CTRL_MAX;
+	     max += ESDHC_TUNE_CTRL_STEP) {
+		esdhc_prepare_tuning(regs, max);
+		if (mmc_send_tuning(mmc, opcode))
+			break;
+	}
+	max -= ESDHC_TUNE_CTRL_STEP;
+
+	cfg->tune_val = (min + max) / 2;
+	esdhc_prepare_tuning(regs, cfg->tune_val);
+	err = mmc_send_tuning(mmc, opcode);
+
+	debug("fsl_esdhc: tuning window %d..%d, using %d\n", min, max,
+	      cfg->tune_val);
+
+out:
+	esdhc_clrbits32(&regs->mixctrl, ESDHC_MIX_CTRL_EXE_TUNE);
+	if (err)
+		esdhc_clrbits32(&regs->mixctrl, ESDHC_MIX_CTRL_SMPCLK_SEL |
+				ESDHC_MIX_CTRL_FBCLK_SEL);
+	else
+		esdhc_setbits32(&regs->mixctrl, ESDHC_MIX_CTRL_AUTO_TUNE_EN);
+
+	return err;
+}
+#endif
+
 static int esdhc_init(struct mmc *mmc)
 {
 	struct fsl_esdhc_cfg *cfg = mmc->priv;
@@ -645,11 +893,23 @@ static void esdhc_reset(struct fsl_esdhc *regs)
 		printf("MMC/SD: Reset never completed.\n");
 }
 
+static int esdhc_card_busy(struct mmc *mmc)
+{
+	struct fsl_esdhc_cfg *cfg = mmc->priv;
+	struct fsl_esdhc *regs = (struct fsl_esdhc *)cfg->esdhc_base;
+
+	return !(esdhc_read32(&regs->prsstat) & PRSSTAT_DAT_MASK);
+}
+
 static const struct mmc_ops esdhc_ops = {
 	.send_cmd	= esdhc_send_cmd,
 	.set_ios	= esdhc_set_ios,
 	.init		= esdhc_init,
 	.getcd		= esdhc_getcd,
+	.card_busy	= esdhc_card_busy,
+#ifdef CONFIG_FSL_USDHC
+	.execute_tuning	= esdhc_execute_tuning,
+#endif
 };
 
 int fsl_esdhc_initialize(bd_t *bis, struct fsl_esdhc_cfg *cfg)
@@ -729,8 +989,20 @@ int fsl_esdhc_initialize(bd_t *bis, struct fsl_esdhc_cfg *cfg)
 	cfg->cfg.f_min = 400000;
 	cfg->cfg.f_max = min(cfg->sdhc_clk, (u32)52000000);
 
+#ifdef CONFIG_FSL_USDHC
+	/* HS200 and UHS-I need 1.8V signalling, which only the board knows */
+	if (cfg->vs18_enable && (voltage_caps & MMC_VDD_165_195)) {
+		cfg->cfg.host_caps |= MMC_MODE_HS200 | MMC_MODE_UHS;
+		cfg->cfg.f_max = min(cfg->sdhc_clk, (u32)200000000);
+	}
+#endif
+
 	cfg->cfg.b_max = CONFIG_SYS_MMC_MAX_BLK_COUNT;
 
+#ifdef CONFIG_FSL_ESDHC_ADMA
+	esdhc_adma_init(cfg);
+#endif
+
 	mmc = mmc_create(&cfg->cfg, cfg);
 	if (mmc == NULL)
 		return -1;
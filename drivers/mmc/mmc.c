@@ -19,6 +19,7 @@
 #include <memalign.h>
 #include <linux/list.h>
 #include <div64.h>
+#include <blkcache.h>
 #include "mmc_private.h"
 
 static struct list_head mmc_devices;
@@ -50,6 +51,16 @@ __weak int board_mmc_getcd(struct mmc *mmc)
 	return -1;
 }
 
+__weak int board_mmc_set_signal_voltage(struct mmc *mmc, uint voltage)
+{
+	return 0;
+}
+
+__weak int board_mmc_power_cycle(struct mmc *mmc)
+{
+	return -ENOSYS;
+}
+
 int mmc_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd, struct mmc_data *data)
 {
 	int ret;
@@ -160,6 +171,23 @@ int mmc_send_status(struct mmc *mmc, int timeout)
 	return 0;
 }
 
+/*
+ * Wait for a card that was left in the programming state by a deferred
+ * write to become ready again.
+ */
+int mmc_wait_prog(struct mmc *mmc)
+{
+	int err;
+
+	if (!mmc->prog_pending)
+		return 0;
+
+	err = mmc_send_status(mmc, 1000);
+	mmc->prog_pending = 0;
+
+	return err;
+}
+
 int mmc_set_blocklen(struct mmc *mmc, int len)
 {
 	struct mmc_cmd cmd;
@@ -237,6 +265,8 @@ static int mmc_read_blocks(struct mmc *mmc, void *dst, lbaint_t start,
 static ulong mmc_bread(int dev_num, lbaint_t start, lbaint_t blkcnt, void *dst)
 {
 	lbaint_t cur, blocks_todo = blkcnt;
+	lbaint_t blk = start;
+	void *buf = dst;
 
 	if (blkcnt == 0)
 		return 0;
@@ -253,6 +283,13 @@ static ulong mmc_bread(int dev_num, lbaint_t start, lbaint_t blkcnt, void *dst)
 		return 0;
 	}
 
+	if (blkcache_read(IF_TYPE_MMC, dev_num, start, blkcnt,
+			  mmc->read_bl_len, dst))
+		return blkcnt;
+
+	if (mmc_wait_prog(mmc))
+		return 0;
+
 	if (mmc_set_blocklen(mmc, mmc->read_bl_len)) {
 		debug("%s: Failed to set blocklen\n", __func__);
 		return 0;
@@ -270,6 +307,8 @@ static ulong mmc_bread(int dev_num, lbaint_t start, lbaint_t blkcnt, void *dst)
 		dst += cur * mmc->read_bl_len;
 	} while (blocks_todo > 0);
 
+	blkcache_fill(IF_TYPE_MMC, dev_num, blk, blkcnt, mmc->read_bl_len, buf);
+
 	return blkcnt;
 }
 
@@ -294,7 +333,7 @@ static int mmc_go_idle(struct mmc *mmc)
 	return 0;
 }
 
-static int sd_send_op_cond(struct mmc *mmc)
+static int sd_send_op_cond(struct mmc *mmc, int s18r)
 {
 	int timeout = 1000;
 	int err;
@@ -326,6 +365,10 @@ static int sd_send_op_cond(struct mmc *mmc)
 		if (mmc->version == SD_VERSION_2)
 			cmd.cmdarg |= OCR_HCS;
 
+		/* Ask whether the card can go to 1.8V for UHS-I */
+		if (s18r)
+			cmd.cmdarg |= OCR_S18R;
+
 		err = mmc_send_cmd(mmc, &cmd, NULL);
 
 		if (err)
@@ -470,10 +513,10 @@ static int mmc_send_ext_csd(struct mmc *mmc, u8 *ext_csd)
 }
 
 
-static int mmc_switch(struct mmc *mmc, u8 set, u8 index, u8 value)
+static int __mmc_switch(struct mmc *mmc, u8 set, u8 index, u8 value,
+			int timeout)
 {
 	struct mmc_cmd cmd;
-	int timeout = 1000;
 	int ret;
 
 	cmd.cmdidx = MMC_CMD_SWITCH;
@@ -492,6 +535,126 @@ static int mmc_switch(struct mmc *mmc, u8 set, u8 index, u8 value)
 
 }
 
+static int mmc_switch(struct mmc *mmc, u8 set, u8 index, u8 value)
+{
+	return __mmc_switch(mmc, set, index, value, 1000);
+}
+
+/* Writing back a large cache can take a while */
+#define MMC_CACHE_FLUSH_TIMEOUT	30000	/* ms */
+
+int mmc_flush_cache(struct mmc *mmc)
+{
+	int err;
+
+	if (!mmc->cache_on)
+		return 0;
+
+	err = mmc_wait_prog(mmc);
+	if (err)
+		return err;
+
+	return __mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_FLUSH_CACHE,
+			    1, MMC_CACHE_FLUSH_TIMEOUT);
+}
+
+int mmc_cache_ctrl(struct mmc *mmc, int enable)
+{
+	int err;
+
+	if (!mmc->cache_size)
+		return -ENOSYS;
+
+	enable = !!enable;
+	if (mmc->cache_on == enable)
+		return 0;
+
+	if (!enable) {
+		err = mmc_flush_cache(mmc);
+		if (err)
+			return err;
+	}
+
+	err = mmc_wait_prog(mmc);
+	if (err)
+		return err;
+
+	err = mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_CACHE_CTRL,
+			 enable);
+	if (err)
+		return err;
+
+	mmc->cache_on = enable;
+
+	return 0;
+}
+
+static const u8 tuning_blk_pattern_4bit[] = {
+	0xff, 0x0f, 0xff, 0x00, 0xff, 0xcc, 0xc3, 0xcc,
+	0xc3, 0x3c, 0xcc, 0xff, 0xfe, 0xff, 0xfe, 0xef,
+	0xff, 0xdf, 0xff, 0xdd, 0xff, 0xfb, 0xff, 0xfb,
+	0xbf, 0xff, 0x7f, 0xff, 0x77, 0xf7, 0xbd, 0xef,
+	0xff, 0xf0, 0xff, 0xf0, 0x0f, 0xfc, 0xcc, 0x3c,
+	0xcc, 0x33, 0xcc, 0xcf, 0xff, 0xef, 0xff, 0xee,
+	0xff, 0xfd, 0xff, 0xfd, 0xdf, 0xff, 0xbf, 0xff,
+	0xbb, 0xff, 0xf7, 0xff, 0xf7, 0x7f, 0x7b, 0xde,
+};
+
+static const u8 tuning_blk_pattern_8bit[] = {
+	0xff, 0xff, 0x00, 0xff, 0xff, 0xff, 0x00, 0x00,
+	0xff, 0xff, 0xcc, 0xcc, 0xcc, 0x33, 0xcc, 0xcc,
+	0xcc, 0x33, 0x33, 0xcc, 0xcc, 0xcc, 0xff, 0xff,
+	0xff, 0xee, 0xff, 0xff, 0xff, 0xee, 0xee, 0xff,
+	0xff, 0xff, 0xdd, 0xff, 0xff, 0xff, 0xdd, 0xdd,
+	0xff, 0xff, 0xff, 0xbb, 0xff, 0xff, 0xff, 0xbb,
+	0xbb, 0xff, 0xff, 0xff, 0x77, 0xff, 0xff, 0xff,
+	0x77, 0x77, 0xff, 0x77, 0xbb, 0xdd, 0xee, 0xff,
+	0xff, 0xff, 0xff, 0x00, 0xff, 0xff, 0xff, 0x00,
+	0x00, 0xff, 0xff, 0xcc, 0xcc, 0xcc, 0x33, 0xcc,
+	0xcc, 0xcc, 0x33, 0x33, 0xcc, 0xcc, 0xcc, 0xff,
+	0xff, 0xff, 0xee, 0xff, 0xff, 0xff, 0xee, 0xee,
+	0xff, 0xff, 0xff, 0xdd, 0xff, 0xff, 0xff, 0xdd,
+	0xdd, 0xff, 0xff, 0xff, 0xbb, 0xff, 0xff, 0xff,
+	0xbb, 0xbb, 0xff, 0xff, 0xff, 0x77, 0xff, 0xff,
+	0xff, 0x77, 0x77, 0xff, 0x77, 0xbb, 0xdd, 0xee,
+};
+
+int mmc_send_tuning(struct mmc *mmc, uint opcode)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(u8, data_buf, sizeof(tuning_blk_pattern_8bit));
+	const u8 *pattern;
+	struct mmc_cmd cmd;
+	struct mmc_data data;
+	int size;
+	int err;
+
+	if (mmc->bus_width == 8) {
+		pattern = tuning_blk_pattern_8bit;
+		size = sizeof(tuning_blk_pattern_8bit);
+	} else {
+		pattern = tuning_blk_pattern_4bit;
+		size = sizeof(tuning_blk_pattern_4bit);
+	}
+
+	cmd.cmdidx = opcode;
+	cmd.resp_type = MMC_RSP_R1;
+	cmd.cmdarg = 0;
+
+	data.dest = (char *)data_buf;
+	data.blocks = 1;
+	data.blocksize = size;
+	data.flags = MMC_DATA_READ;
+
+	err = mmc_send_cmd(mmc, &cmd, &data);
+	if (err)
+		return err;
+
+	if (memcmp(data_buf, pattern, size))
+		return -EIO;
+
+	return 0;
+}
+
 static int mmc_change_freq(struct mmc *mmc)
 {
 	ALLOC_CACHE_ALIGN_BUFFER(u8, ext_csd, MMC_MAX_BLOCK_LEN);
@@ -514,7 +677,7 @@ static int mmc_change_freq(struct mmc *mmc)
 	if (err)
 		return err;
 
-	cardtype = ext_csd[EXT_CSD_CARD_TYPE] & 0xf;
+	cardtype = ext_csd[EXT_CSD_CARD_TYPE] & 0x3f;
 
 	err = mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_HS_TIMING, 1);
 
@@ -535,6 +698,8 @@ static int mmc_change_freq(struct mmc *mmc)
 	if (cardtype & EXT_CSD_CARD_TYPE_52) {
 		if (cardtype & EXT_CSD_CARD_TYPE_DDR_1_8V)
 			mmc->card_caps |= MMC_MODE_DDR_52MHz;
+		if (cardtype & EXT_CSD_CARD_TYPE_HS200_1_8V)
+			mmc->card_caps |= MMC_MODE_HS200;
 		mmc->card_caps |= MMC_MODE_HS_52MHz | MMC_MODE_HS;
 	} else {
 		mmc->card_caps |= MMC_MODE_HS;
@@ -605,6 +770,9 @@ int mmc_switch_part(int dev_num, unsigned int part_num)
 	if (!mmc)
 		return -1;
 
+	/* Same device number, different blocks */
+	blkcache_invalidate(IF_TYPE_MMC, dev_num);
+
 	ret = mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_PART_CONF,
 			 (mmc->part_config & ~PART_ACCESS_MASK)
 			 | (part_num & PART_ACCESS_MASK));
@@ -935,6 +1103,18 @@ retry_scr:
 			break;
 	}
 
+	/*
+	 * A card that went to 1.8V is UHS-I. It first goes to SDR25 like any
+	 * high speed card, the faster modes are selected once the bus is 4
+	 * bits wide.
+	 */
+	if (mmc->signal_voltage == MMC_SIGNAL_VOLTAGE_180) {
+		if (__be32_to_cpu(switch_status[3]) & SD_UHS_SDR104_SUPPORTED)
+			mmc->card_caps |= MMC_MODE_UHS_SDR104;
+		if (__be32_to_cpu(switch_status[3]) & SD_UHS_SDR50_SUPPORTED)
+			mmc->card_caps |= MMC_MODE_UHS_SDR50;
+	}
+
 	/* If high-speed isn't supported, we return */
 	if (!(__be32_to_cpu(switch_status[3]) & SD_HIGHSPEED_SUPPORTED))
 		return 0;
@@ -1017,6 +1197,167 @@ static void mmc_set_bus_width(struct mmc *mmc, uint width)
 	mmc_set_ios(mmc);
 }
 
+static int sd_card_busy(struct mmc *mmc)
+{
+	return mmc->cfg->ops->card_busy ? mmc->cfg->ops->card_busy(mmc) : -1;
+}
+
+/*
+ * Move a card that answered ACMD41 with S18A to 1.8V signalling, following
+ * the CMD11 sequence of the SD spec: the card pulls DAT[3:0] low once it
+ * has accepted the command, the host stops the SD clock and holds it for at
+ * least 5ms while both sides move to 1.8V, and the card releases DAT[3:0]
+ * within 1ms of the clock coming back if the switch worked.
+ */
+static int sd_switch_voltage(struct mmc *mmc)
+{
+	struct mmc_cmd cmd;
+	int err;
+
+	cmd.cmdidx = SD_CMD_SWITCH_UHS18V;
+	cmd.resp_type = MMC_RSP_R1;
+	cmd.cmdarg = 0;
+
+	err = mmc_send_cmd(mmc, &cmd, NULL);
+	if (err)
+		return err;
+
+	udelay(100);
+	if (sd_card_busy(mmc) == 0)
+		return -EIO;
+
+	mmc->clk_disable = 1;
+	mmc_set_ios(mmc);
+
+	err = board_mmc_set_signal_voltage(mmc, MMC_SIGNAL_VOLTAGE_180);
+	if (err) {
+		mmc->clk_disable = 0;
+		return err;
+	}
+
+	mmc->signal_voltage = MMC_SIGNAL_VOLTAGE_180;
+	mmc_set_ios(mmc);
+	mdelay(5);
+
+	mmc->clk_disable = 0;
+	mmc_set_ios(mmc);
+	mdelay(1);
+
+	if (sd_card_busy(mmc) == 1)
+		return -EIO;
+
+	return 0;
+}
+
+/*
+ * Move an eMMC that is in high speed on a 4 or 8 bit SDR bus to HS200 and
+ * let the host tune its sampling point. If that fails, the card is put
+ * back into high speed.
+ */
+static int mmc_select_hs200(struct mmc *mmc)
+{
+	int err;
+
+	if (!mmc->cfg->ops->execute_tuning || mmc->ddr_mode ||
+	    mmc->bus_width < 4)
+		return -ENOSYS;
+
+	/* HS200 is only defined for 1.8V (or 1.2V) signalling */
+	mmc->signal_voltage = MMC_SIGNAL_VOLTAGE_180;
+	mmc_set_ios(mmc);
+
+	err = mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_HS_TIMING,
+			 EXT_CSD_TIMING_HS200);
+	if (err)
+		return err;
+
+	mmc->timing = MMC_TIMING_MMC_HS200;
+	mmc_set_clock(mmc, 200000000);
+
+	err = mmc->cfg->ops->execute_tuning(mmc,
+					    MMC_CMD_SEND_TUNING_BLOCK_HS200);
+	if (!err)
+		return 0;
+
+	printf("MMC: HS200 tuning failed, using high speed\n");
+
+	mmc_set_clock(mmc, 26000000);
+	mmc->timing = MMC_TIMING_HS;
+	mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_HS_TIMING,
+		   EXT_CSD_TIMING_HS);
+
+	return err;
+}
+
+/*
+ * Move a UHS-I card that is in SDR25 on a 4 bit bus to SDR104 or SDR50 and
+ * let the host tune its sampling point. If that fails, the card is put
+ * back into SDR25.
+ */
+static int sd_select_uhs(struct mmc *mmc)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(uint, switch_status, 16);
+	uint clock, timing;
+	u8 mode;
+	int err;
+
+	if (!mmc->cfg->ops->execute_tuning || mmc->bus_width != 4)
+		return -ENOSYS;
+
+	if (mmc->card_caps & MMC_MODE_UHS_SDR104) {
+		mode = SD_ACCESS_MODE_SDR104;
+		timing = MMC_TIMING_UHS_SDR104;
+		clock = 208000000;
+	} else {
+		mode = SD_ACCESS_MODE_SDR50;
+		timing = MMC_TIMING_UHS_SDR50;
+		clock = 100000000;
+	}
+
+	err = sd_switch(mmc, SD_SWITCH_SWITCH, 0, mode, (u8 *)switch_status);
+	if (err)
+		return err;
+
+	if (((__be32_to_cpu(switch_status[4]) >> 24) & 0xf) != mode)
+		return SWITCH_ERR;
+
+	mmc->timing = timing;
+	mmc_set_clock(mmc, clock);
+
+	err = mmc->cfg->ops->execute_tuning(mmc, SD_CMD_SEND_TUNING_BLOCK);
+	if (!err) {
+		mmc->tran_speed = clock;
+		return 0;
+	}
+
+	printf("SD: %s tuning failed, using high speed\n", mmc_mode_name(mmc));
+
+	mmc->timing = MMC_TIMING_HS;
+	mmc_set_clock(mmc, mmc->tran_speed);
+	sd_switch(mmc, SD_SWITCH_SWITCH, 0, SD_ACCESS_MODE_HS,
+		  (u8 *)switch_status);
+
+	return err;
+}
+
+const char *mmc_mode_name(struct mmc *mmc)
+{
+	switch (mmc->timing) {
+	case MMC_TIMING_MMC_HS200:
+		return "HS200";
+	case MMC_TIMING_UHS_SDR50:
+		return "UHS SDR50";
+	case MMC_TIMING_UHS_SDR104:
+		return "UHS SDR104";
+	case MMC_TIMING_HS:
+		if (mmc->ddr_mode)
+			return "DDR52";
+		return "High Speed";
+	default:
+		return "Legacy";
+	}
+}
+
 static int mmc_startup(struct mmc *mmc)
 {
 	int err, i;
@@ -1177,6 +1518,9 @@ static int mmc_startup(struct mmc *mmc)
 	 */
 	mmc->erase_grp_size = 1;
 	mmc->part_config = MMCPART_NOAVAILABLE;
+	/* CMD0 turned the cache off */
+	mmc->cache_size = 0;
+	mmc->cache_on = 0;
 	if (!IS_SD(mmc) && (mmc->version >= MMC_VERSION_4)) {
 		/* check  ext_csd version and capacity */
 		err = mmc_send_ext_csd(mmc, ext_csd);
@@ -1322,6 +1666,13 @@ static int mmc_startup(struct mmc *mmc)
 			* ext_csd[EXT_CSD_HC_WP_GRP_SIZE];
 
 		mmc->wr_rel_set = ext_csd[EXT_CSD_WR_REL_SET];
+
+		/* The volatile cache came with eMMC 4.5 */
+		if (ext_csd[EXT_CSD_REV] >= 6)
+			mmc->cache_size = ext_csd[EXT_CSD_CACHE_SIZE] |
+				(ext_csd[EXT_CSD_CACHE_SIZE + 1] << 8) |
+				(ext_csd[EXT_CSD_CACHE_SIZE + 2] << 16) |
+				(ext_csd[EXT_CSD_CACHE_SIZE + 3] << 24);
 	}
 
 	err = mmc_set_capacity(mmc, mmc->part_num);
@@ -1359,10 +1710,15 @@ static int mmc_startup(struct mmc *mmc)
 			mmc_set_bus_width(mmc, 4);
 		}
 
-		if (mmc->card_caps & MMC_MODE_HS)
+		if (mmc->card_caps & MMC_MODE_HS) {
+			mmc->timing = MMC_TIMING_HS;
 			mmc->tran_speed = 50000000;
-		else
+		} else {
 			mmc->tran_speed = 25000000;
+		}
+
+		if (mmc->card_caps & MMC_MODE_UHS)
+			sd_select_uhs(mmc);
 	} else if (mmc->version >= MMC_VERSION_4) {
 		/* Only version 4 of MMC supports wider bus widths */
 		int idx;
@@ -1414,6 +1770,11 @@ static int mmc_startup(struct mmc *mmc)
 			if ((mmc->card_caps & caps) != caps)
 				continue;
 
+			/* HS200 needs an SDR bus, try that before DDR52 */
+			if ((mmc->card_caps & MMC_MODE_HS200) &&
+			    (caps & MMC_MODE_DDR_52MHz))
+				continue;
+
 			err = mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL,
 					EXT_CSD_BUS_WIDTH, extw);
 
@@ -1448,11 +1809,16 @@ static int mmc_startup(struct mmc *mmc)
 			return err;
 
 		if (mmc->card_caps & MMC_MODE_HS) {
+			mmc->timing = MMC_TIMING_HS;
 			if (mmc->card_caps & MMC_MODE_HS_52MHz)
 				mmc->tran_speed = 52000000;
 			else
 				mmc->tran_speed = 26000000;
 		}
+
+		if ((mmc->card_caps & MMC_MODE_HS200) &&
+		    mmc_select_hs200(mmc) == 0)
+			mmc->tran_speed = 200000000;
 	}
 
 	mmc_set_clock(mmc, mmc->tran_speed);
@@ -1588,11 +1954,12 @@ __weak void board_mmc_power_init(void)
 
 int mmc_start_init(struct mmc *mmc)
 {
-	int err;
+	int err, s18r;
 
 	/* we pretend there's no card when init is NULL */
 	if (mmc_getcd(mmc) == 0 || mmc->cfg->ops->init == NULL) {
 		mmc->has_init = 0;
+		blkcache_invalidate(IF_TYPE_MMC, mmc->block_dev.dev);
 #if !defined(CONFIG_SPL_BUILD) || defined(CONFIG_SPL_LIBCOMMON_SUPPORT)
 		printf("MMC: no card present\n");
 #endif
@@ -1602,11 +1969,22 @@ int mmc_start_init(struct mmc *mmc)
 	if (mmc->has_init)
 		return 0;
 
+	/* A rescan may have found another card */
+	blkcache_invalidate(IF_TYPE_MMC, mmc->block_dev.dev);
+
 #ifdef CONFIG_FSL_ESDHC_ADAPTER_IDENT
 	mmc_adapter_card_type_ident();
 #endif
 	board_mmc_power_init();
 
+	/*
+	 * An SD card that went to 1.8V, in an earlier init or before a warm
+	 * reset, keeps signalling at 1.8V and answers ACMD41 without S18A.
+	 * Only a power cycle brings it back to 3.3V, where init starts.
+	 */
+	if (mmc->cfg->host_caps & MMC_MODE_UHS)
+		board_mmc_power_cycle(mmc);
+
 	/* made sure it's not NULL earlier */
 	err = mmc->cfg->ops->init(mmc);
 
@@ -1614,6 +1992,8 @@ int mmc_start_init(struct mmc *mmc)
 		return err;
 
 	mmc->ddr_mode = 0;
+	mmc->timing = MMC_TIMING_LEGACY;
+	mmc->signal_voltage = MMC_SIGNAL_VOLTAGE_330;
 	mmc_set_bus_width(mmc, 1);
 	mmc_set_clock(mmc, 1);
 
@@ -1630,7 +2010,29 @@ int mmc_start_init(struct mmc *mmc)
 	err = mmc_send_if_cond(mmc);
 
 	/* Now try to get the SD card's operating condition */
-	err = sd_send_op_cond(mmc);
+	s18r = !mmc_host_is_spi(mmc) && mmc->version == SD_VERSION_2 &&
+	       (mmc->cfg->host_caps & MMC_MODE_UHS);
+	err = sd_send_op_cond(mmc, s18r);
+
+	/* A UHS-I card has to be switched to 1.8V right away */
+	if (!err && s18r && (mmc->ocr & OCR_S18R) && sd_switch_voltage(mmc)) {
+		printf("SD: 1.8V switch failed, staying at 3.3V\n");
+
+		mmc->signal_voltage = MMC_SIGNAL_VOLTAGE_330;
+		board_mmc_set_signal_voltage(mmc, MMC_SIGNAL_VOLTAGE_330);
+		mmc_set_ios(mmc);
+
+		/* The card only leaves 1.8V signalling through a power cycle */
+		if (board_mmc_power_cycle(mmc))
+			printf("SD: cannot power cycle the card\n");
+
+		err = mmc_go_idle(mmc);
+		if (err)
+			return err;
+
+		mmc_send_if_cond(mmc);
+		err = sd_send_op_cond(mmc, 0);
+	}
 
 	/* If the command timed out, we check for an MMC card */
 	if (err == TIMEOUT) {
@@ -10,8 +10,11 @@
 #include <config.h>
 #include <common.h>
 #include <part.h>
+#include <malloc.h>
+#include <memalign.h>
 #include <div64.h>
 #include <linux/math64.h>
+#include <blkcache.h>
 #include "mmc_private.h"
 
 static ulong mmc_erase_t(struct mmc *mmc, ulong start, lbaint_t blkcnt)
@@ -76,6 +79,11 @@ unsigned long mmc_berase(int dev_num, lbaint_t start, lbaint_t blkcnt)
 	if (!mmc)
 		return -1;
 
+	blkcache_invalidate(IF_TYPE_MMC, dev_num);
+
+	if (mmc_wait_prog(mmc))
+		return 0;
+
 	/*
 	 * We want to see if the requested start or total block count are
 	 * unaligned.  We discard the whole numbers and only care about the
@@ -108,12 +116,32 @@ unsigned long mmc_berase(int dev_num, lbaint_t start, lbaint_t blkcnt)
 	return blk;
 }
 
+/*
+ * Whether a multi-block write can be announced with CMD23, so the card
+ * knows where it ends and no CMD12 is needed.
+ */
+static int mmc_can_set_blkcnt(struct mmc *mmc, lbaint_t blkcnt)
+{
+	if (mmc_host_is_spi(mmc) || blkcnt > 0xffff)
+		return 0;
+
+	if (IS_SD(mmc))
+		return mmc->scr[0] & SD_CMD23_SUPPORT;
+
+	return 1;
+}
+
+/*
+ * With @nowait set the card is left programming after the data has been
+ * transferred; the caller has to mmc_wait_prog() before the next access.
+ */
 static ulong mmc_write_blocks(struct mmc *mmc, lbaint_t start,
-		lbaint_t blkcnt, const void *src)
+		lbaint_t blkcnt, const void *src, int nowait)
 {
 	struct mmc_cmd cmd;
 	struct mmc_data data;
 	int timeout = 1000;
+	int set_blkcnt = 0;
 
 	if ((start + blkcnt) > mmc->block_dev.lba) {
 		printf("MMC: block number 0x" LBAF " exceeds max(0x" LBAF ")\n",
@@ -128,6 +156,18 @@ static ulong mmc_write_blocks(struct mmc *mmc, lbaint_t start,
 	else
 		cmd.cmdidx = MMC_CMD_WRITE_MULTIPLE_BLOCK;
 
+	if (blkcnt > 1 && mmc_can_set_blkcnt(mmc, blkcnt)) {
+		cmd.cmdidx = MMC_CMD_SET_BLOCK_COUNT;
+		cmd.cmdarg = blkcnt;
+		cmd.resp_type = MMC_RSP_R1;
+
+		/* Cards that refuse it get the open-ended write instead */
+		if (!mmc_send_cmd(mmc, &cmd, NULL))
+			set_blkcnt = 1;
+
+		cmd.cmdidx = MMC_CMD_WRITE_MULTIPLE_BLOCK;
+	}
+
 	if (mmc->high_capacity)
 		cmd.cmdarg = start;
 	else
@@ -148,16 +188,21 @@ static ulong mmc_write_blocks(struct mmc *mmc, lbaint_t start,
 	/* SPI multiblock writes terminate using a special
 	 * token, not a STOP_TRANSMISSION request.
 	 */
-	if (!mmc_host_is_spi(mmc) && blkcnt > 1) {
+	if (!mmc_host_is_spi(mmc) && blkcnt > 1 && !set_blkcnt) {
 		cmd.cmdidx = MMC_CMD_STOP_TRANSMISSION;
 		cmd.cmdarg = 0;
-		cmd.resp_type = MMC_RSP_R1b;
+		cmd.resp_type = nowait ? MMC_RSP_R1 : MMC_RSP_R1b;
 		if (mmc_send_cmd(mmc, &cmd, NULL)) {
 			printf("mmc fail to send stop cmd\n");
 			return 0;
 		}
 	}
 
+	if (nowait) {
+		mmc->prog_pending = 1;
+		return blkcnt;
+	}
+
 	/* Waiting for the ready status */
 	if (mmc_send_status(mmc, timeout))
 		return 0;
@@ -165,12 +210,14 @@ static ulong mmc_write_blocks(struct mmc *mmc, lbaint_t start,
 	return blkcnt;
 }
 
-ulong mmc_bwrite(int dev_num, lbaint_t start, lbaint_t blkcnt, const void *src)
+static ulong mmc_bwrite_blocks(struct mmc *mmc, lbaint_t start,
+		lbaint_t blkcnt, const void *src, int nowait)
 {
 	lbaint_t cur, blocks_todo = blkcnt;
 
-	struct mmc *mmc = find_mmc_device(dev_num);
-	if (!mmc)
+	blkcache_invalidate(IF_TYPE_MMC, mmc->block_dev.dev);
+
+	if (mmc_wait_prog(mmc))
 		return 0;
 
 	if (mmc_set_blocklen(mmc, mmc->write_bl_len))
@@ -179,7 +226,9 @@ ulong mmc_bwrite(int dev_num, lbaint_t start, lbaint_t blkcnt, const void *src)
 	do {
 		cur = (blocks_todo > mmc->cfg->b_max) ?
 			mmc->cfg->b_max : blocks_todo;
-		if (mmc_write_blocks(mmc, start, cur, src) != cur)
+		if (mmc_wait_prog(mmc))
+			return 0;
+		if (mmc_write_blocks(mmc, start, cur, src, nowait) != cur)
 			return 0;
 		blocks_todo -= cur;
 		start += cur;
@@ -188,3 +237,138 @@ ulong mmc_bwrite(int dev_num, lbaint_t start, lbaint_t blkcnt, const void *src)
 
 	return blkcnt;
 }
+
+ulong mmc_bwrite(int dev_num, lbaint_t start, lbaint_t blkcnt, const void *src)
+{
+	struct mmc *mmc = find_mmc_device(dev_num);
+	if (!mmc)
+		return 0;
+
+	return mmc_bwrite_blocks(mmc, start, blkcnt, src, 0);
+}
+
+ulong mmc_bwrite_nowait(struct mmc *mmc, lbaint_t start, lbaint_t blkcnt,
+			const void *src)
+{
+	return mmc_bwrite_blocks(mmc, start, blkcnt, src, 1);
+}
+
+#ifndef CONFIG_MMC_COPY_CHUNK_BLKS
+#define CONFIG_MMC_COPY_CHUNK_BLKS	0x4000	/* 8 MiB of 512-byte blocks */
+#endif
+#define MMC_COPY_RETRIES		3
+
+static int mmc_bcopy_read(struct mmc *mmc, lbaint_t start, lbaint_t blkcnt,
+			  void *dst)
+{
+	int retry;
+
+	for (retry = 0; retry <= MMC_COPY_RETRIES; retry++) {
+		if (mmc->block_dev.block_read(mmc->block_dev.dev, start,
+					      blkcnt, dst) == blkcnt)
+			return 0;
+		printf("\nmmc copy: read 0x" LBAF " failed, retry %d\n",
+		       start, retry + 1);
+	}
+
+	return -1;
+}
+
+static int mmc_bcopy_write(struct mmc *mmc, lbaint_t start, lbaint_t blkcnt,
+			   const void *src)
+{
+	int retry;
+
+	for (retry = 0; retry <= MMC_COPY_RETRIES; retry++) {
+		if (mmc_bwrite_blocks(mmc, start, blkcnt, src, 1) == blkcnt)
+			return 0;
+		mmc->prog_pending = 0;
+		printf("\nmmc copy: write 0x" LBAF " failed, retry %d\n",
+		       start, retry + 1);
+	}
+
+	return -1;
+}
+
+ulong mmc_bcopy(struct mmc *src, struct mmc *dst, lbaint_t start,
+		lbaint_t blkcnt)
+{
+	lbaint_t done = 0, cur, next;
+	ulong chunk_bytes, time_start, elapsed;
+	char *buf[2];
+	int idx = 0;
+	int percent, last_percent = -1;
+
+	if (src->read_bl_len != dst->write_bl_len) {
+		printf("mmc copy: block size mismatch\n");
+		return 0;
+	}
+
+	if (start + blkcnt > src->block_dev.lba ||
+	    start + blkcnt > dst->block_dev.lba) {
+		printf("mmc copy: block number 0x" LBAF " exceeds device\n",
+		       start + blkcnt);
+		return 0;
+	}
+
+	chunk_bytes = CONFIG_MMC_COPY_CHUNK_BLKS * src->read_bl_len;
+	buf[0] = memalign(ARCH_DMA_MINALIGN, chunk_bytes);
+	buf[1] = memalign(ARCH_DMA_MINALIGN, chunk_bytes);
+
+	if (!buf[0] || !buf[1]) {
+		printf("mmc copy: out of memory\n");
+		goto out;
+	}
+
+	time_start = get_timer(0);
+
+	cur = min_t(lbaint_t, blkcnt, CONFIG_MMC_COPY_CHUNK_BLKS);
+	if (cur && mmc_bcopy_read(src, start, cur, buf[idx]))
+		goto out;
+
+	while (done < blkcnt) {
+		/* dst programs this chunk while the next one is read */
+		if (mmc_bcopy_write(dst, start + done, cur, buf[idx]))
+			break;
+
+		next = min_t(lbaint_t, blkcnt - done - cur,
+			     CONFIG_MMC_COPY_CHUNK_BLKS);
+		if (next && mmc_bcopy_read(src, start + done + cur, next,
+					   buf[idx ^ 1]))
+			break;
+
+		if (mmc_wait_prog(dst)) {
+			/* Programming failed, write the chunk once more */
+			if (mmc_bcopy_write(dst, start + done, cur, buf[idx]) ||
+			    mmc_wait_prog(dst))
+				break;
+		}
+
+		done += cur;
+		cur = next;
+		idx ^= 1;
+
+		percent = lldiv((u64)done * 100, blkcnt);
+		if (percent != last_percent) {
+			printf("\rmmc copy: %3d%%", percent);
+			last_percent = percent;
+		}
+	}
+
+	mmc_wait_prog(dst);
+
+	elapsed = get_timer(time_start);
+	printf("\nmmc copy: " LBAF " blocks in %lu ms", done, elapsed);
+	if (elapsed) {
+		puts(", ");
+		print_size(lldiv((u64)done * src->read_bl_len, elapsed) * 1000,
+			   "/s");
+	}
+	puts("\n");
+
+out:
+	free(buf[0]);
+	free(buf[1]);
+
+	return done;
+}
@@ -46,7 +46,11 @@ const struct spi_flash_params spi_flash_params_table[] = {
 	{"MX25L8005",	   0xc22014, 0x0,	64 * 1024,    16, RD_NORM,			  0},
 	{"MX25L1605D",	   0xc22015, 0x0,	64 * 1024,    32, RD_NORM,			  0},
 	{"MX25L3205D",	   0xc22016, 0x0,	64 * 1024,    64, RD_NORM,			  0},
+#ifdef CONFIG_SPI_FLASH_MX25L6406E	/* same id as MX25L6405D, has 4READ */
+	{"MX25L6406E",	   0xc22017, 0x0,	64 * 1024,   128, RD_NORM | QUAD_IO_FAST,	  0},
+#else
 	{"MX25L6405D",	   0xc22017, 0x0,	64 * 1024,   128, RD_NORM,			  0},
+#endif
 	{"MX25L12805",	   0xc22018, 0x0,	64 * 1024,   256, RD_FULL,		     WR_QPP},
 	{"MX25L25635F",	   0xc22019, 0x0,	64 * 1024,   512, RD_FULL,		     WR_QPP},
 	{"MX25L51235F",	   0xc2201a, 0x0,	64 * 1024,  1024, RD_FULL,		     WR_QPP},
@@ -792,20 +792,25 @@ out:
 }
 
 /**
- * Pull one frame from the card
+ * Pull every frame the FEC has already received
+ *
+ * Frames are passed to the network stack straight from their DMA buffer
+ * and the descriptor is recycled once net_process_received_packet()
+ * returns, so a burst of TFTP/NFS data is handled in one call and
+ * without copying.
+ *
  * @param[in] dev Our ethernet device to handle
- * @return Length of packet read
+ * @return Number of bytes received
  */
 static int fec_recv(struct eth_device *dev)
 {
 	struct fec_priv *fec = (struct fec_priv *)dev->priv;
-	struct fec_bd *rbd = &fec->rbd_base[fec->rbd_index];
+	struct fec_bd *rbd;
 	unsigned long ievent;
 	int frame_length, len = 0;
 	uint16_t bd_status;
-	uint32_t addr, size, end;
-	int i;
-	ALLOC_CACHE_ALIGN_BUFFER(uchar, buff, FEC_MAX_PKT_SIZE);
+	uint32_t addr, buf, size, end;
+	int i, n;
 
 	/*
 	 * Check if any critical events have happened
@@ -835,57 +840,66 @@ static int fec_recv(struct eth_device *dev)
 		}
 	}
 
-	/*
-	 * Read the buffer status. Before the status can be read, the data cache
-	 * must be invalidated, because the data in RAM might have been changed
-	 * by DMA. The descriptors are properly aligned to cachelines so there's
-	 * no need to worry they'd overlap.
-	 *
-	 * WARNING: By invalidating the descriptor here, we also invalidate
-	 * the descriptors surrounding this one. Therefore we can NOT change the
-	 * contents of this descriptor nor the surrounding ones. The problem is
-	 * that in order to mark the descriptor as processed, we need to change
-	 * the descriptor. The solution is to mark the whole cache line when all
-	 * descriptors in the cache line are processed.
-	 */
-	addr = (uint32_t)rbd;
-	addr &= ~(ARCH_DMA_MINALIGN - 1);
-	size = roundup(sizeof(struct fec_bd), ARCH_DMA_MINALIGN);
-	invalidate_dcache_range(addr, addr + size);
+	for (n = 0; n < FEC_RBD_NUM; n++) {
+		rbd = &fec->rbd_base[fec->rbd_index];
+
+		/*
+		 * Read the buffer status. Before the status can be read, the
+		 * data cache must be invalidated, because the data in RAM
+		 * might have been changed by DMA. The descriptors are properly
+		 * aligned to cachelines so there's no need to worry they'd
+		 * overlap.
+		 *
+		 * WARNING: By invalidating the descriptor here, we also
+		 * invalidate the descriptors surrounding this one. Therefore
+		 * we can NOT change the contents of this descriptor nor the
+		 * surrounding ones. The problem is that in order to mark the
+		 * descriptor as processed, we need to change the descriptor.
+		 * The solution is to mark the whole cache line when all
+		 * descriptors in the cache line are processed.
+		 */
+		addr = (uint32_t)rbd;
+		addr &= ~(ARCH_DMA_MINALIGN - 1);
+		size = roundup(sizeof(struct fec_bd), ARCH_DMA_MINALIGN);
+		invalidate_dcache_range(addr, addr + size);
 
-	bd_status = readw(&rbd->status);
-	debug("fec_recv: status 0x%x\n", bd_status);
+		bd_status = readw(&rbd->status);
+		debug("fec_recv: status 0x%x\n", bd_status);
 
-       // frame_length = readw(&rbd->data_length) - 4;
-       // printf("length : %d \n\n", frame_length);
-	if (!(bd_status & FEC_RBD_EMPTY)) {
+		if (bd_status & FEC_RBD_EMPTY)
+			break;
+
+		buf = readl(&rbd->data_pointer);
 		if ((bd_status & FEC_RBD_LAST) && !(bd_status & FEC_RBD_ERR) &&
 			((readw(&rbd->data_length) - 4) > 14)) {
-			/*
-			 * Get buffer address and size
-			 */
-			addr = readl(&rbd->data_pointer);
 			frame_length = readw(&rbd->data_length) - 4;
 			/*
 			 * Invalidate data cache over the buffer
 			 */
-			end = roundup(addr + frame_length, ARCH_DMA_MINALIGN);
-			addr &= ~(ARCH_DMA_MINALIGN - 1);
-			invalidate_dcache_range(addr, end);
+			end = roundup(buf + frame_length, ARCH_DMA_MINALIGN);
+			invalidate_dcache_range(buf, end);
 
 			/*
-			 *  Fill the buffer and pass it to upper layers
+			 * Pass the DMA buffer itself to upper layers
 			 */
 #ifdef CONFIG_FEC_MXC_SWAP_PACKET
-			swap_packet((uint32_t *)addr, frame_length);
+			swap_packet((uint32_t *)buf, frame_length);
 #endif
-			memcpy(buff, (char *)addr, frame_length);
-			net_process_received_packet(buff, frame_length);
-			len = frame_length;
+			net_process_received_packet((uchar *)buf, frame_length);
+			len += frame_length;
+
+			/*
+			 * The protocol handlers may have written to the
+			 * buffer (an ICMP echo reply is built in place).
+			 * Drop those lines now, a later eviction would
+			 * overwrite the next frame the FEC puts there.
+			 */
+			invalidate_dcache_range(buf, buf +
+				roundup(FEC_MAX_PKT_SIZE, FEC_DMA_RX_MINALIGN));
 		} else {
 			if (bd_status & FEC_RBD_ERR)
 				printf("error frame: 0x%08x 0x%08x\n",
-				       addr, bd_status);
+				       buf, bd_status);
 		}
 
 		/*
@@ -908,7 +922,11 @@ static int fec_recv(struct eth_device *dev)
 
 		fec_rx_task_enable(fec);
 		fec->rbd_index = (fec->rbd_index + 1) % FEC_RBD_NUM;
-        }
+
+		/* Leave the rest to the next protocol, if there is one */
+		if (net_state != NETLOOP_CONTINUE)
+			break;
+	}
 	debug("fec_recv: stop\n");
 
 	return len;
@@ -925,6 +943,9 @@ static int fec_alloc_descs(struct fec_priv *fec)
 	int i;
 	uint8_t *data;
 
+	/* Descriptors are given back a cache line at a time */
+	BUILD_BUG_ON(FEC_RBD_NUM % RXDESC_PER_CACHELINE);
+
 	/* Allocate TX descriptors. */
 	size = roundup(2 * sizeof(struct fec_bd), ARCH_DMA_MINALIGN);
 	fec->tbd_base = memalign(ARCH_DMA_MINALIGN, size);
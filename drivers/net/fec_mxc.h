@@ -270,9 +270,15 @@ struct fec_priv {
  * @brief Numbers of buffer descriptors for receiving
  *
  * The number defines the stocked memory buffers for the receiving task.
- * Larger values makes no sense in this limited environment.
+ * Received frames are handed out from these buffers, so the ring is what
+ * absorbs a burst (e.g. a TFTP window) while the CPU is busy elsewhere.
+ * Must be a multiple of the descriptors sharing a cache line.
  */
+#ifdef CONFIG_FEC_MXC_RBD_NUM
+#define FEC_RBD_NUM		CONFIG_FEC_MXC_RBD_NUM
+#else
 #define FEC_RBD_NUM		64
+#endif
 
 /**
  * @brief Define the ethernet packet size limit in memory
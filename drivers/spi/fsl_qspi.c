@@ -44,8 +44,13 @@ DECLARE_GLOBAL_DATA_PTR;
 #define SEQID_RDEAR		11
 #define SEQID_WREAR		12
 #endif
+#ifdef CONFIG_FSL_QSPI_QUAD_READ
+#define SEQID_QUAD_IO_READ	13
+#define SEQID_WRSR		14
+#endif
 
 /* QSPI CMD */
+#define QSPI_CMD_WRSR		0x01	/* Write status register */
 #define QSPI_CMD_PP		0x02	/* Page program (up to 256 bytes) */
 #define QSPI_CMD_RDSR		0x05	/* Read status register */
 #define QSPI_CMD_WREN		0x06	/* Write enable */
@@ -54,6 +59,7 @@ DECLARE_GLOBAL_DATA_PTR;
 #define QSPI_CMD_CHIP_ERASE	0xc7	/* Erase whole flash chip */
 #define QSPI_CMD_SE		0xd8	/* Sector erase (usually 64KiB) */
 #define QSPI_CMD_RDID		0x9f	/* Read JEDEC ID */
+#define QSPI_CMD_QUAD_IO_READ	0xeb	/* Quad I/O read (1-4-4) */
 
 /* Used for Micron, winbond and Macronix flashes */
 #define	QSPI_CMD_WREAR		0xc5	/* EAR register write */
@@ -67,6 +73,7 @@ DECLARE_GLOBAL_DATA_PTR;
 #define QSPI_CMD_FAST_READ_4B	0x0c    /* Read data bytes (high frequency) */
 #define QSPI_CMD_PP_4B		0x12    /* Page program (up to 256 bytes) */
 #define QSPI_CMD_SE_4B		0xdc    /* Sector erase (usually 64KiB) */
+#define QSPI_CMD_QUAD_IO_READ_4B	0xec	/* Quad I/O read (1-4-4) */
 
 /* fsl_qspi_platdata flags */
 #define QSPI_FLAG_REGMAP_ENDIAN_BIG	BIT(0)
@@ -107,6 +114,7 @@ struct fsl_qspi_platdata {
  * @bus_clk: QSPI input clk frequency
  * @speed_hz: Default SCK frequency
  * @cur_seqid: current LUT table sequence id
+ * @ahb_seqid: LUT sequence currently used for AHB reads
  * @sf_addr: flash access offset
  * @amba_base: Base address of QSPI memory mapping of every CS
  * @amba_total_size: size of QSPI memory mapping
@@ -120,6 +128,7 @@ struct fsl_qspi_priv {
 	u32 bus_clk;
 	u32 speed_hz;
 	u32 cur_seqid;
+	u32 ahb_seqid;
 	u32 sf_addr;
 	u32 amba_base[FSL_QSPI_MAX_CHIPSELECT_NUM];
 	u32 amba_total_size;
@@ -203,6 +212,50 @@ static void qspi_set_lut(struct fsl_qspi_priv *priv)
 	qspi_write32(priv->flags, &regs->lut[lut_base + 2], 0);
 	qspi_write32(priv->flags, &regs->lut[lut_base + 3], 0);
 
+#ifdef CONFIG_FSL_QSPI_QUAD_READ
+	/*
+	 * Quad I/O Read: address, mode and data all on four pads. The
+	 * mode byte is driven as 0 so that the flash never enters its
+	 * continuous read mode; together with the 4 dummy clocks this
+	 * gives the 6 wait cycles Macronix parts default to.
+	 */
+	lut_base = SEQID_QUAD_IO_READ * 4;
+#ifdef CONFIG_SPI_FLASH_BAR
+	qspi_write32(priv->flags, &regs->lut[lut_base],
+		     OPRND0(QSPI_CMD_QUAD_IO_READ) | PAD0(LUT_PAD1) |
+		     INSTR0(LUT_CMD) | OPRND1(ADDR24BIT) |
+		     PAD1(LUT_PAD4) | INSTR1(LUT_ADDR));
+#else
+	if (FSL_QSPI_FLASH_SIZE  <= SZ_16M)
+		qspi_write32(priv->flags, &regs->lut[lut_base],
+			     OPRND0(QSPI_CMD_QUAD_IO_READ) | PAD0(LUT_PAD1) |
+			     INSTR0(LUT_CMD) | OPRND1(ADDR24BIT) |
+			     PAD1(LUT_PAD4) | INSTR1(LUT_ADDR));
+	else
+		qspi_write32(priv->flags, &regs->lut[lut_base],
+			     OPRND0(QSPI_CMD_QUAD_IO_READ_4B) |
+			     PAD0(LUT_PAD1) | INSTR0(LUT_CMD) |
+			     OPRND1(ADDR32BIT) | PAD1(LUT_PAD4) |
+			     INSTR1(LUT_ADDR));
+#endif
+	qspi_write32(priv->flags, &regs->lut[lut_base + 1],
+		     OPRND0(0) | PAD0(LUT_PAD4) | INSTR0(LUT_MODE) |
+		     OPRND1(4) | PAD1(LUT_PAD4) | INSTR1(LUT_DUMMY));
+	qspi_write32(priv->flags, &regs->lut[lut_base + 2],
+		     OPRND0(RX_BUFFER_SIZE) | PAD0(LUT_PAD4) |
+		     INSTR0(LUT_READ));
+	qspi_write32(priv->flags, &regs->lut[lut_base + 3], 0);
+
+	/* Write Status, used by the flash layer to set the QE bit */
+	lut_base = SEQID_WRSR * 4;
+	qspi_write32(priv->flags, &regs->lut[lut_base], OPRND0(QSPI_CMD_WRSR) |
+		     PAD0(LUT_PAD1) | INSTR0(LUT_CMD) | OPRND1(1) |
+		     PAD1(LUT_PAD1) | INSTR1(LUT_WRITE));
+	qspi_write32(priv->flags, &regs->lut[lut_base + 1], 0);
+	qspi_write32(priv->flags, &regs->lut[lut_base + 2], 0);
+	qspi_write32(priv->flags, &regs->lut[lut_base + 3], 0);
+#endif
+
 	/* Read Status */
 	lut_base = SEQID_RDSR * 4;
 	qspi_write32(priv->flags, &regs->lut[lut_base], OPRND0(QSPI_CMD_RDSR) |
@@ -322,6 +375,16 @@ static void qspi_set_lut(struct fsl_qspi_priv *priv)
 	qspi_write32(priv->flags, &regs->lckcr, QSPI_LCKCR_LOCK);
 }
 
+/* LUT sequence serving the read command issued by the flash layer */
+static u32 qspi_read_seqid(struct fsl_qspi_priv *priv)
+{
+#ifdef CONFIG_FSL_QSPI_QUAD_READ
+	if (priv->cur_seqid == QSPI_CMD_QUAD_IO_READ)
+		return SEQID_QUAD_IO_READ;
+#endif
+	return SEQID_FAST_READ;
+}
+
 #if defined(CONFIG_SYS_FSL_QSPI_AHB)
 /*
  * If we have changed the content of the flash by writing or erasing,
@@ -352,7 +415,20 @@ static inline void qspi_ahb_invalid(struct fsl_qspi_priv *priv)
 static inline void qspi_ahb_read(struct fsl_qspi_priv *priv, u8 *rxbuf, int len)
 {
 	struct fsl_qspi_regs *regs = priv->regs;
-	u32 mcr_reg;
+	u32 mcr_reg, seqid;
+
+	/*
+	 * The buffer is filled by whatever BFGENCR points at, so follow
+	 * the read command the flash layer picked and drop the data that
+	 * was fetched with the previous sequence.
+	 */
+	seqid = qspi_read_seqid(priv);
+	if (seqid != priv->ahb_seqid) {
+		qspi_write32(priv->flags, &regs->bfgencr,
+			     seqid << QSPI_BFGENCR_SEQID_SHIFT);
+		qspi_ahb_invalid(priv);
+		priv->ahb_seqid = seqid;
+	}
 
 	mcr_reg = qspi_read32(priv->flags, &regs->mcr);
 
@@ -424,6 +500,7 @@ static void qspi_init_ahb_read(struct fsl_qspi_priv *priv)
 	 */
 	qspi_write32(priv->flags, &regs->bfgencr,
 		     SEQID_FAST_READ << QSPI_BFGENCR_SEQID_SHIFT);
+	priv->ahb_seqid = SEQID_FAST_READ;
 
 	/*Enable DDR Mode*/
 	qspi_enable_ddr_mode(priv);
@@ -515,7 +592,7 @@ static void qspi_op_rdid(struct fsl_qspi_priv *priv, u32 *rxbuf, u32 len)
 static void qspi_op_read(struct fsl_qspi_priv *priv, u32 *rxbuf, u32 len)
 {
 	struct fsl_qspi_regs *regs = priv->regs;
-	u32 mcr_reg, data;
+	u32 mcr_reg, data, seqid;
 	int i, size;
 	u32 to_or_from;
 
@@ -526,6 +603,7 @@ static void qspi_op_read(struct fsl_qspi_priv *priv, u32 *rxbuf, u32 len)
 	qspi_write32(priv->flags, &regs->rbct, QSPI_RBCT_RXBRD_USEIPS);
 
 	to_or_from = priv->sf_addr + priv->cur_amba_base;
+	seqid = qspi_read_seqid(priv);
 
 	while (len > 0) {
 		WATCHDOG_RESET();
@@ -536,8 +614,7 @@ static void qspi_op_read(struct fsl_qspi_priv *priv, u32 *rxbuf, u32 len)
 			RX_BUFFER_SIZE : len;
 
 		qspi_write32(priv->flags, &regs->ipcr,
-			     (SEQID_FAST_READ << QSPI_IPCR_SEQID_SHIFT) |
-			     size);
+			     (seqid << QSPI_IPCR_SEQID_SHIFT) | size);
 		while (qspi_read32(priv->flags, &regs->sr) & QSPI_SR_BUSY_MASK)
 			;
 
@@ -607,6 +684,10 @@ static void qspi_op_write(struct fsl_qspi_priv *priv, u8 *txbuf, u32 len)
 	else if (priv->cur_seqid == QSPI_CMD_WREAR)
 		seqid = SEQID_WREAR;
 #endif
+#ifdef CONFIG_FSL_QSPI_QUAD_READ
+	if (priv->cur_seqid == QSPI_CMD_WRSR)
+		seqid = SEQID_WRSR;
+#endif
 
 	to_or_from = priv->sf_addr + priv->cur_amba_base;
 
@@ -725,7 +806,8 @@ int qspi_xfer(struct fsl_qspi_priv *priv, unsigned int bitlen,
 			return 0;
 		}
 
-		if (priv->cur_seqid == QSPI_CMD_FAST_READ) {
+		if ((priv->cur_seqid == QSPI_CMD_FAST_READ) ||
+		    (priv->cur_seqid == QSPI_CMD_QUAD_IO_READ)) {
 			priv->sf_addr = swab32(txbuf) & OFFSET_BITS_MASK;
 		} else if ((priv->cur_seqid == QSPI_CMD_SE) ||
 			   (priv->cur_seqid == QSPI_CMD_BE_4K)) {
@@ -738,11 +820,14 @@ int qspi_xfer(struct fsl_qspi_priv *priv, unsigned int bitlen,
 #ifdef CONFIG_SPI_FLASH_BAR
 			wr_sfaddr = 0;
 #endif
+		} else if (priv->cur_seqid == QSPI_CMD_WRSR) {
+			wr_sfaddr = 0;
 		}
 	}
 
 	if (din) {
-		if (priv->cur_seqid == QSPI_CMD_FAST_READ) {
+		if ((priv->cur_seqid == QSPI_CMD_FAST_READ) ||
+		    (priv->cur_seqid == QSPI_CMD_QUAD_IO_READ)) {
 #ifdef CONFIG_SYS_FSL_QSPI_AHB
 			qspi_ahb_read(priv, din, bytes);
 #else
@@ -847,6 +932,9 @@ struct spi_slave *spi_setup_slave(unsigned int bus, unsigned int cs,
 	qspi->priv.cur_amba_base = amba_bases[bus] + cs * FSL_QSPI_FLASH_SIZE;
 
 	qspi->slave.max_write_size = TX_BUFFER_SIZE;
+#ifdef CONFIG_FSL_QSPI_QUAD_READ
+	qspi->slave.op_mode_rx = SPI_OPM_RX_QIOF;
+#endif
 
 	qspi_write32(qspi->priv.flags, &regs->mcr,
 		     QSPI_MCR_RESERVED_MASK | QSPI_MCR_MDIS_MASK);
@@ -921,6 +1009,9 @@ static int fsl_qspi_child_pre_probe(struct udevice *dev)
 	struct spi_slave *slave = dev_get_parent_priv(dev);
 
 	slave->max_write_size = TX_BUFFER_SIZE;
+#ifdef CONFIG_FSL_QSPI_QUAD_READ
+	slave->op_mode_rx = SPI_OPM_RX_QIOF;
+#endif
 
 	return 0;
 }
@@ -129,6 +129,7 @@ struct fsl_qspi_regs {
 #define LUT_CMD				1
 #define LUT_ADDR			2
 #define LUT_DUMMY			3
+#define LUT_MODE			4
 #define LUT_READ			7
 #define LUT_WRITE			8
 
@@ -13,6 +13,7 @@
 #include <asm/arch/imx-regs.h>
 #include <asm/arch/clock.h>
 #include <asm/imx-common/spi.h>
+#include <div64.h>
 
 #ifdef CONFIG_MX27
 /* i.MX27 has a completely wrong register layout and register definitions in the
@@ -40,6 +41,13 @@ __weak int board_spi_cs_gpio(unsigned bus, unsigned cs)
 #define CONFIG_SYS_SPI_MXC_WAIT		(CONFIG_SYS_HZ/100)	/* 10 ms */
 #endif
 
+#if defined(CONFIG_MXC_SPI_BURST) && defined(MXC_ECSPI)
+#define MXC_ECSPI_FIFO_WORDS	64
+#define MXC_ECSPI_BURST_BYTES	((MXC_CSPICTRL_MAXBITS + 1) / 8)
+#define MXC_ECSPI_STAT_TF	(1 << 2)	/* TXFIFO full */
+#define MXC_ECSPI_STAT_RR	(1 << 3)	/* RXFIFO ready */
+#endif
+
 struct mxc_spi_slave {
 	struct spi_slave slave;
 	unsigned long	base;
@@ -51,6 +59,9 @@ struct mxc_spi_slave {
 	int		ss_pol;
 	unsigned int	max_hz;
 	unsigned int	mode;
+	unsigned int	sclk_hz;	/* SCK actually programmed */
+	ulong		xfer_bits;	/* bits moved by mxc_spi_xfer() */
+	ulong		xfer_us;	/* time spent in mxc_spi_xfer() */
 };
 
 static inline struct mxc_spi_slave *to_mxc_spi_slave(struct spi_slave *slave)
@@ -100,6 +111,7 @@ static s32 spi_cfg_mxc(struct mxc_spi_slave *mxcs, unsigned int cs)
 
 	debug("clk %d Hz, div %d, real clk %d Hz\n",
 		max_hz, div, clk_src / (4 << div));
+	mxcs->sclk_hz = clk_src / (4 << div);
 
 	ctrl_reg = MXC_CSPICTRL_CHIPSELECT(cs) |
 		MXC_CSPICTRL_BITCOUNT(MXC_CSPICTRL_MAXBITS) |
@@ -161,6 +173,7 @@ static s32 spi_cfg_mxc(struct mxc_spi_slave *mxcs, unsigned int cs)
 	}
 
 	debug("pre_div = %d, post_div=%d\n", pre_div, post_div);
+	mxcs->sclk_hz = clk_src / ((pre_div + 1) << post_div);
 	reg_ctrl = (reg_ctrl & ~MXC_CSPICTRL_SELCHAN(3)) |
 		MXC_CSPICTRL_SELCHAN(cs);
 	reg_ctrl = (reg_ctrl & ~MXC_CSPICTRL_PREDIV(0x0F)) |
@@ -211,6 +224,88 @@ static s32 spi_cfg_mxc(struct mxc_spi_slave *mxcs, unsigned int cs)
 }
 #endif
 
+#if defined(CONFIG_MXC_SPI_BURST) && defined(MXC_ECSPI)
+/* Pack the next cnt bytes MSB first, as the FIFO shifts them out */
+static u32 spi_burst_tx_word(const u8 **dout, int cnt)
+{
+	const u8 *p = *dout;
+	u32 data = 0;
+
+	if (!p)
+		return 0;
+	while (cnt--)
+		data = (data << 8) | *p++;
+	*dout = p;
+
+	return data;
+}
+
+static void spi_burst_rx_word(u8 **din, u32 data, int cnt)
+{
+	if (!*din)
+		return;
+	data = cpu_to_be32(data) >> ((sizeof(data) - cnt) * 8);
+	memcpy(*din, &data, cnt);
+	*din += cnt;
+}
+
+/*
+ * Exchange up to MXC_ECSPI_BURST_BYTES in a single burst, so the native
+ * chip-select stays asserted throughout. Rather than filling the FIFO,
+ * waiting for TC and draining it, the TXFIFO is topped up and the RXFIFO
+ * emptied while the burst is shifting, keeping no more words in flight
+ * than the RXFIFO can hold.
+ */
+static int spi_xchg_burst(struct mxc_spi_slave *mxcs, unsigned int bitlen,
+	const u8 *dout, u8 *din)
+{
+	struct cspi_regs *regs = (struct cspi_regs *)mxcs->base;
+	int words = DIV_ROUND_UP(bitlen, 32);
+	int first = (bitlen % 32) ? (bitlen % 32) / 8 : 4;
+	int tx = 0, rx = 0;
+	u32 status, ts;
+
+	mxcs->ctrl_reg = (mxcs->ctrl_reg &
+		~MXC_CSPICTRL_BITCOUNT(MXC_CSPICTRL_MAXBITS)) |
+		MXC_CSPICTRL_BITCOUNT(bitlen - 1);
+
+	reg_write(&regs->ctrl, mxcs->ctrl_reg | MXC_CSPICTRL_EN);
+	reg_write(&regs->cfg, mxcs->cfg_reg);
+	reg_write(&regs->stat, MXC_CSPICTRL_TC | MXC_CSPICTRL_RXOVF);
+
+	while (tx < words && tx < MXC_ECSPI_FIFO_WORDS) {
+		reg_write(&regs->txdata,
+			  spi_burst_tx_word(&dout, tx ? 4 : first));
+		tx++;
+	}
+
+	reg_write(&regs->ctrl, mxcs->ctrl_reg |
+		MXC_CSPICTRL_EN | MXC_CSPICTRL_XCH);
+
+	ts = get_timer(0);
+	while (rx < words) {
+		status = reg_read(&regs->stat);
+		if (status & MXC_ECSPI_STAT_RR) {
+			spi_burst_rx_word(&din, reg_read(&regs->rxdata),
+					  rx ? 4 : first);
+			rx++;
+			ts = get_timer(0);
+		} else if (tx < words && !(status & MXC_ECSPI_STAT_TF) &&
+			   tx - rx < MXC_ECSPI_FIFO_WORDS) {
+			reg_write(&regs->txdata, spi_burst_tx_word(&dout, 4));
+			tx++;
+		} else if (get_timer(ts) > CONFIG_SYS_SPI_MXC_WAIT) {
+			printf("spi_xchg_burst: Timeout!\n");
+			return -1;
+		}
+	}
+
+	reg_write(&regs->stat, MXC_CSPICTRL_TC | MXC_CSPICTRL_RXOVF);
+
+	return 0;
+}
+#endif
+
 static int spi_xchg_single(struct spi_slave *slave, unsigned int bitlen,
 	const u8 *dout, u8 *din, unsigned long flags)
 {
@@ -224,6 +319,11 @@ static int spi_xchg_single(struct spi_slave *slave, unsigned int bitlen,
 	debug("%s: bitlen %d dout 0x%x din 0x%x\n",
 		__func__, bitlen, (u32)dout, (u32)din);
 
+#if defined(CONFIG_MXC_SPI_BURST) && defined(MXC_ECSPI)
+	if (nbytes > MAX_SPI_BYTES)
+		return spi_xchg_burst(mxcs, bitlen, dout, din);
+#endif
+
 	mxcs->ctrl_reg = (mxcs->ctrl_reg &
 		~MXC_CSPICTRL_BITCOUNT(MXC_CSPICTRL_MAXBITS)) |
 		MXC_CSPICTRL_BITCOUNT(bitlen - 1);
@@ -330,12 +430,14 @@ static int spi_xchg_single(struct spi_slave *slave, unsigned int bitlen,
 int mxc_spi_xfer(struct spi_slave *slave, unsigned int bitlen, const void *dout,
 		void *din, unsigned long flags)
 {
+	struct mxc_spi_slave *mxcs = to_mxc_spi_slave(slave);
 	int n_bytes = DIV_ROUND_UP(bitlen, 8);
 	int n_bits;
 	int ret;
 	u32 blk_size;
 	u8 *p_outbuf = (u8 *)dout;
 	u8 *p_inbuf = (u8 *)din;
+	ulong start = timer_get_us();
 
 	if (!slave)
 		return -1;
@@ -348,6 +450,11 @@ int mxc_spi_xfer(struct spi_slave *slave, unsigned int bitlen, const void *dout,
 			blk_size = n_bytes;
 		else
 			blk_size = MAX_SPI_BYTES;
+#if defined(CONFIG_MXC_SPI_BURST) && defined(MXC_ECSPI)
+		/* Longer transfers go out in as few bursts as possible */
+		if (n_bytes > MAX_SPI_BYTES)
+			blk_size = min_t(u32, n_bytes, MXC_ECSPI_BURST_BYTES);
+#endif
 
 		n_bits = blk_size * 8;
 
@@ -366,9 +473,33 @@ int mxc_spi_xfer(struct spi_slave *slave, unsigned int bitlen, const void *dout,
 		spi_cs_deactivate(slave);
 	}
 
+	mxcs->xfer_bits += DIV_ROUND_UP(bitlen, 8) * 8;
+	mxcs->xfer_us += timer_get_us() - start;
+
 	return 0;
 }
 
+/*
+ * Bus utilisation is the time the bits would take at the programmed SCK
+ * over the time actually spent in mxc_spi_xfer().
+ */
+void mxc_spi_print_stats(struct spi_slave *slave)
+{
+	struct mxc_spi_slave *mxcs = to_mxc_spi_slave(slave);
+	ulong ideal_us;
+
+	printf("SPI%d.%d: %lu bits in %lu us at %u Hz",
+	       slave->bus, slave->cs, mxcs->xfer_bits, mxcs->xfer_us,
+	       mxcs->sclk_hz);
+	if (mxcs->xfer_us && mxcs->sclk_hz) {
+		ideal_us = lldiv((u64)mxcs->xfer_bits * 1000000,
+				 mxcs->sclk_hz);
+		printf(", bus utilisation %lu%%",
+		       (ulong)lldiv((u64)ideal_us * 100, mxcs->xfer_us));
+	}
+	putc('\n');
+}
+
 void mxc_spi_init(void)
 {
 }
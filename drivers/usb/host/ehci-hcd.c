@@ -291,6 +291,28 @@ static void ehci_update_endpt2_dev_n_port(struct usb_device *udev,
 				     QH_ENDPT2_HUBADDR(hubaddr));
 }
 
+/* Map the status of a retired qTD to a USB_ST_* value */
+static unsigned long ehci_token_status(uint32_t token)
+{
+	switch (QT_TOKEN_GET_STATUS(token) &
+		~(QT_TOKEN_STATUS_SPLITXSTATE | QT_TOKEN_STATUS_PERR)) {
+	case 0:
+		return 0;
+	case QT_TOKEN_STATUS_HALTED:
+		return USB_ST_STALLED;
+	case QT_TOKEN_STATUS_ACTIVE | QT_TOKEN_STATUS_DATBUFERR:
+	case QT_TOKEN_STATUS_DATBUFERR:
+		return USB_ST_BUF_ERR;
+	case QT_TOKEN_STATUS_HALTED | QT_TOKEN_STATUS_BABBLEDET:
+	case QT_TOKEN_STATUS_BABBLEDET:
+		return USB_ST_BABBLE_DET;
+	default:
+		if (QT_TOKEN_GET_STATUS(token) & QT_TOKEN_STATUS_HALTED)
+			return USB_ST_CRC_ERR | USB_ST_STALLED;
+		return USB_ST_CRC_ERR;
+	}
+}
+
 static int
 ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 		   int length, struct devrequest *req)
@@ -398,7 +420,8 @@ ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 	 *   qh_overlay.qt_next ...... 13-10 H
 	 * - qh_overlay.qt_altnext
 	 */
-	qh->qh_link = cpu_to_hc32((unsigned long)&ctrl->qh_list | QH_LINK_TYPE_QH);
+	/* In front of the bulk queue QHs, if any */
+	qh->qh_link = ctrl->qh_list.qh_link;
 	c = (dev->speed != USB_SPEED_HIGH) && !usb_pipeendpoint(pipe);
 	maxpacket = usb_maxpacket(dev, pipe);
 	endpt = QH_ENDPT1_RL(8) | QH_ENDPT1_C(c) |
@@ -606,33 +629,18 @@ ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 		goto fail;
 	}
 
+	ctrl->qh_list.qh_link = qh->qh_link;
+	flush_dcache_range((unsigned long)&ctrl->qh_list,
+		ALIGN_END_ADDR(struct QH, &ctrl->qh_list, 1));
+
 	token = hc32_to_cpu(qh->qh_overlay.qt_token);
 	if (!(QT_TOKEN_GET_STATUS(token) & QT_TOKEN_STATUS_ACTIVE)) {
 		debug("TOKEN=%#x\n", token);
-		switch (QT_TOKEN_GET_STATUS(token) &
-			~(QT_TOKEN_STATUS_SPLITXSTATE | QT_TOKEN_STATUS_PERR)) {
-		case 0:
+		dev->status = ehci_token_status(token);
+		if (!dev->status) {
 			toggle = QT_TOKEN_GET_DT(token);
 			usb_settoggle(dev, usb_pipeendpoint(pipe),
 				       usb_pipeout(pipe), toggle);
-			dev->status = 0;
-			break;
-		case QT_TOKEN_STATUS_HALTED:
-			dev->status = USB_ST_STALLED;
-			break;
-		case QT_TOKEN_STATUS_ACTIVE | QT_TOKEN_STATUS_DATBUFERR:
-		case QT_TOKEN_STATUS_DATBUFERR:
-			dev->status = USB_ST_BUF_ERR;
-			break;
-		case QT_TOKEN_STATUS_HALTED | QT_TOKEN_STATUS_BABBLEDET:
-		case QT_TOKEN_STATUS_BABBLEDET:
-			dev->status = USB_ST_BABBLE_DET;
-			break;
-		default:
-			dev->status = USB_ST_CRC_ERR;
-			if (QT_TOKEN_GET_STATUS(token) & QT_TOKEN_STATUS_HALTED)
-				dev->status |= USB_ST_STALLED;
-			break;
 		}
 		dev->act_len = length - QT_TOKEN_GET_TOTALBYTES(token);
 	} else {
@@ -649,6 +657,13 @@ ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 	return (dev->status != USB_ST_NOT_PROC) ? 0 : -1;
 
 fail:
+	/* Do not leave the QH on the stack linked into the schedule */
+	if (ctrl->qh_list.qh_link ==
+	    cpu_to_hc32((unsigned long)qh | QH_LINK_TYPE_QH)) {
+		ctrl->qh_list.qh_link = qh->qh_link;
+		flush_dcache_range((unsigned long)&ctrl->qh_list,
+			ALIGN_END_ADDR(struct QH, &ctrl->qh_list, 1));
+	}
 	free(qtd);
 	return -1;
 }
@@ -1501,6 +1516,364 @@ static int _ehci_submit_int_msg(struct usb_device *dev, unsigned long pipe,
 	return result;
 }
 
+#if defined(CONFIG_USB_EHCI_BULK_QUEUE) && !defined(CONFIG_DM_USB)
+/*
+ * Bulk queues
+ *
+ * A bulk queue keeps a QH for one bulk endpoint on the asynchronous
+ * schedule for as long as it exists, and lets the caller append several
+ * transfers (chains of qTDs) to it without waiting for the previous ones.
+ * The schedule stays enabled in between, so back to back transfers do not
+ * pay for the QH set up and the schedule on/off handshakes of
+ * ehci_submit_async().
+ *
+ * The qTDs live in a ring. The slot after the last chain always holds an
+ * inactive dummy qTD the QH points at once it runs dry; a new chain is
+ * written behind the dummy and the dummy itself is turned into its first
+ * qTD last, so the controller never sees a half built chain (EHCI 4.10.2).
+ * Every qTD of a chain has its alternate next pointer on the following
+ * dummy, so a short packet skips the rest of the chain.
+ *
+ * The data toggle is kept in the QH overlay, and other transfers to the
+ * controller may only be submitted while the queues are idle.
+ */
+#define BULK_QUEUE_CHAINS	4
+
+struct bulk_chain {
+	int first;		/* ring slot of the first qTD */
+	int count;		/* number of qTDs */
+	uint8_t *buffer;
+	int length;
+};
+
+struct bulk_queue {
+	struct QH *qh;
+	struct qTD *tds;
+	int ntds;		/* ring size */
+	int used;		/* qTDs of pending chains */
+	int tail;		/* slot of the dummy qTD */
+	struct bulk_chain chains[BULK_QUEUE_CHAINS];
+	int chain;		/* oldest pending chain */
+	int nchains;
+	unsigned long pipe;
+};
+
+/* Length of the qTD transfer at 'buf', sized as in ehci_submit_async() */
+static int ehci_td_bytes(uint8_t *buf, int left)
+{
+	int xfr_bytes = QT_BUFFER_CNT * EHCI_PAGE_SIZE;
+
+	xfr_bytes -= (unsigned long)buf & (EHCI_PAGE_SIZE - 1);
+	xfr_bytes &= ~(PKT_ALIGN - 1);
+
+	return min(xfr_bytes, left);
+}
+
+static int ehci_enable_async(struct ehci_ctrl *ctrl)
+{
+	uint32_t cmd;
+
+	cmd = ehci_readl(&ctrl->hcor->or_usbcmd);
+	if (cmd & CMD_ASE)
+		return 0;
+
+	ehci_writel(&ctrl->hcor->or_asynclistaddr,
+		    (unsigned long)&ctrl->qh_list);
+	ehci_writel(&ctrl->hcor->or_usbcmd, cmd | CMD_ASE);
+
+	if (handshake((uint32_t *)&ctrl->hcor->or_usbsts, STS_ASS, STS_ASS,
+		      100 * 1000) < 0) {
+		printf("EHCI fail timeout STS_ASS set\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+static int ehci_disable_async(struct ehci_ctrl *ctrl)
+{
+	uint32_t cmd;
+
+	cmd = ehci_readl(&ctrl->hcor->or_usbcmd);
+	ehci_writel(&ctrl->hcor->or_usbcmd, cmd & ~CMD_ASE);
+
+	if (handshake((uint32_t *)&ctrl->hcor->or_usbsts, STS_ASS, 0,
+		      100 * 1000) < 0) {
+		printf("EHCI fail timeout STS_ASS reset\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+static struct bulk_queue *_ehci_create_bulk_queue(struct usb_device *dev,
+						  unsigned long pipe,
+						  int maxlen)
+{
+	struct ehci_ctrl *ctrl = ehci_get_ctrl(dev);
+	struct bulk_queue *queue;
+	struct QH *qh;
+	uint32_t endpt, toggle;
+
+	if (usb_pipetype(pipe) != PIPE_BULK) {
+		debug("non-bulk pipe (type=%lu)", usb_pipetype(pipe));
+		return NULL;
+	}
+
+	queue = calloc(1, sizeof(*queue));
+	if (!queue)
+		return NULL;
+
+	/* Every qTD but the last of a chain moves at least 4 pages */
+	queue->ntds = maxlen / ((QT_BUFFER_CNT - 1) * EHCI_PAGE_SIZE) +
+		      BULK_QUEUE_CHAINS + 1;
+	queue->pipe = pipe;
+
+	queue->qh = memalign(USB_DMA_MINALIGN,
+			     ALIGN(sizeof(struct QH), ARCH_DMA_MINALIGN));
+	queue->tds = memalign(USB_DMA_MINALIGN,
+			      queue->ntds * sizeof(struct qTD));
+	if (!queue->qh || !queue->tds) {
+		printf("unable to allocate bulk queue\n");
+		goto fail;
+	}
+
+	/* The dummy */
+	memset(&queue->tds[0], 0, sizeof(struct qTD));
+	queue->tds[0].qt_next = cpu_to_hc32(QT_NEXT_TERMINATE);
+	queue->tds[0].qt_altnext = cpu_to_hc32(QT_NEXT_TERMINATE);
+	flush_dcache_range((unsigned long)&queue->tds[0],
+			   ALIGN_END_ADDR(struct qTD, &queue->tds[0], 1));
+
+	qh = queue->qh;
+	memset(qh, 0, sizeof(struct QH));
+	endpt = QH_ENDPT1_RL(8) | QH_ENDPT1_C(0) |
+		QH_ENDPT1_MAXPKTLEN(usb_maxpacket(dev, pipe)) |
+		QH_ENDPT1_H(0) |
+		QH_ENDPT1_DTC(QH_ENDPT1_DTC_IGNORE_QTD_TD) |
+		QH_ENDPT1_EPS(ehci_encode_speed(dev->speed)) |
+		QH_ENDPT1_ENDPT(usb_pipeendpoint(pipe)) | QH_ENDPT1_I(0) |
+		QH_ENDPT1_DEVADDR(usb_pipedevice(pipe));
+	qh->qh_endpt1 = cpu_to_hc32(endpt);
+	endpt = QH_ENDPT2_MULT(1) | QH_ENDPT2_UFCMASK(0) | QH_ENDPT2_UFSMASK(0);
+	qh->qh_endpt2 = cpu_to_hc32(endpt);
+	ehci_update_endpt2_dev_n_port(dev, qh);
+	toggle = usb_gettoggle(dev, usb_pipeendpoint(pipe), usb_pipeout(pipe));
+	qh->qh_overlay.qt_next = cpu_to_hc32((unsigned long)&queue->tds[0]);
+	qh->qh_overlay.qt_altnext = cpu_to_hc32(QT_NEXT_TERMINATE);
+	qh->qh_overlay.qt_token = cpu_to_hc32(QT_TOKEN_DT(toggle));
+
+	/* Linking a QH in is safe with the schedule running (EHCI 4.8.1) */
+	qh->qh_link = ctrl->qh_list.qh_link;
+	flush_dcache_range((unsigned long)qh, ALIGN_END_ADDR(struct QH, qh, 1));
+	ctrl->qh_list.qh_link = cpu_to_hc32((unsigned long)qh |
+					    QH_LINK_TYPE_QH);
+	flush_dcache_range((unsigned long)&ctrl->qh_list,
+		ALIGN_END_ADDR(struct QH, &ctrl->qh_list, 1));
+	ctrl->bulk_queues++;
+
+	return queue;
+
+fail:
+	free(queue->tds);
+	free(queue->qh);
+	free(queue);
+	return NULL;
+}
+
+static int _ehci_submit_bulk_queue(struct usb_device *dev,
+				   struct bulk_queue *queue, void *buffer,
+				   int length)
+{
+	struct ehci_ctrl *ctrl = ehci_get_ctrl(dev);
+	struct bulk_chain *chain;
+	struct qTD *td, *dummy;
+	uint8_t *buf_ptr;
+	uint32_t token, first_token = 0;
+	int first, idx, count, left, xfr_bytes;
+
+	if (queue->nchains == BULK_QUEUE_CHAINS)
+		return -1;
+
+	count = 0;
+	buf_ptr = buffer;
+	left = length;
+	do {
+		xfr_bytes = ehci_td_bytes(buf_ptr, left);
+		buf_ptr += xfr_bytes;
+		left -= xfr_bytes;
+		count++;
+	} while (left > 0);
+
+	/* The chain plus the new dummy, behind the pending chains */
+	if (queue->used + count + 1 > queue->ntds) {
+		debug("bulk queue full (%d + %d qTDs)\n", queue->used, count);
+		return -1;
+	}
+
+	first = queue->tail;
+	dummy = &queue->tds[(first + count) % queue->ntds];
+	memset(dummy, 0, sizeof(*dummy));
+	dummy->qt_next = cpu_to_hc32(QT_NEXT_TERMINATE);
+	dummy->qt_altnext = cpu_to_hc32(QT_NEXT_TERMINATE);
+	flush_dcache_range((unsigned long)dummy,
+			   ALIGN_END_ADDR(struct qTD, dummy, 1));
+
+	/* Fill the chain from its second qTD on, the old dummy goes last */
+	buf_ptr = buffer;
+	left = length;
+	for (idx = 0; idx < count; idx++) {
+		td = &queue->tds[(first + idx) % queue->ntds];
+		xfr_bytes = ehci_td_bytes(buf_ptr, left);
+
+		if (idx)
+			memset(td, 0, sizeof(*td));
+		td->qt_next = cpu_to_hc32((unsigned long)
+				&queue->tds[(first + idx + 1) % queue->ntds]);
+		td->qt_altnext = cpu_to_hc32((unsigned long)dummy);
+		if (ehci_td_buffer(td, buf_ptr, xfr_bytes)) {
+			printf("unable to construct DATA TD\n");
+			return -1;
+		}
+
+		token = QT_TOKEN_TOTALBYTES(xfr_bytes) | QT_TOKEN_IOC(0) |
+			QT_TOKEN_CPAGE(0) | QT_TOKEN_CERR(3) |
+			QT_TOKEN_PID(usb_pipein(queue->pipe) ?
+				QT_TOKEN_PID_IN : QT_TOKEN_PID_OUT) |
+			QT_TOKEN_STATUS(QT_TOKEN_STATUS_ACTIVE);
+		if (idx) {
+			td->qt_token = cpu_to_hc32(token);
+			flush_dcache_range((unsigned long)td,
+					   ALIGN_END_ADDR(struct qTD, td, 1));
+		} else {
+			first_token = token;
+		}
+
+		buf_ptr += xfr_bytes;
+		left -= xfr_bytes;
+	}
+
+	/* Hand the chain over to the controller */
+	td = &queue->tds[first];
+	flush_dcache_range((unsigned long)td, ALIGN_END_ADDR(struct qTD, td, 1));
+	td->qt_token = cpu_to_hc32(first_token);
+	flush_dcache_range((unsigned long)td, ALIGN_END_ADDR(struct qTD, td, 1));
+
+	chain = &queue->chains[(queue->chain + queue->nchains) %
+			       BULK_QUEUE_CHAINS];
+	chain->first = first;
+	chain->count = count;
+	chain->buffer = buffer;
+	chain->length = length;
+	queue->nchains++;
+	queue->used += count;
+	queue->tail = (first + count) % queue->ntds;
+
+	return ehci_enable_async(ctrl);
+}
+
+static int _ehci_wait_bulk_queue(struct usb_device *dev,
+				 struct bulk_queue *queue, int *actlen)
+{
+	struct bulk_chain *chain;
+	struct qTD *td;
+	uint8_t *buf_ptr;
+	unsigned long ts;
+	uint32_t token;
+	int idx, left, xfr_bytes;
+
+	if (!queue->nchains)
+		return -1;
+
+	chain = &queue->chains[queue->chain];
+	dev->status = 0;
+	dev->act_len = 0;
+	buf_ptr = chain->buffer;
+	left = chain->length;
+	ts = get_timer(0);
+
+	for (idx = 0; idx < chain->count; idx++) {
+		td = &queue->tds[(chain->first + idx) % queue->ntds];
+		xfr_bytes = ehci_td_bytes(buf_ptr, left);
+
+		do {
+			invalidate_dcache_range((unsigned long)td,
+				ALIGN_END_ADDR(struct qTD, td, 1));
+			token = hc32_to_cpu(td->qt_token);
+			if (!(QT_TOKEN_GET_STATUS(token) &
+			      QT_TOKEN_STATUS_ACTIVE))
+				break;
+			WATCHDOG_RESET();
+		} while (get_timer(ts) < USB_TIMEOUT_MS(queue->pipe));
+
+		if (QT_TOKEN_GET_STATUS(token) & QT_TOKEN_STATUS_ACTIVE) {
+			printf("EHCI timed out on TD - token=%#x\n", token);
+			dev->status = USB_ST_NOT_PROC;
+			break;
+		}
+
+		dev->act_len += xfr_bytes - QT_TOKEN_GET_TOTALBYTES(token);
+		dev->status = ehci_token_status(token);
+		/* An error halts the QH, a short packet ends the chain */
+		if (dev->status || QT_TOKEN_GET_TOTALBYTES(token))
+			break;
+
+		buf_ptr += xfr_bytes;
+		left -= xfr_bytes;
+	}
+
+	invalidate_dcache_range((unsigned long)chain->buffer,
+		ALIGN((unsigned long)chain->buffer + chain->length,
+		      ARCH_DMA_MINALIGN));
+
+	queue->used -= chain->count;
+	queue->chain = (queue->chain + 1) % BULK_QUEUE_CHAINS;
+	queue->nchains--;
+
+	*actlen = dev->act_len;
+	return dev->status ? -1 : 0;
+}
+
+/* Pending transfers are dropped */
+static int _ehci_destroy_bulk_queue(struct usb_device *dev,
+				    struct bulk_queue *queue)
+{
+	struct ehci_ctrl *ctrl = ehci_get_ctrl(dev);
+	struct QH *cur = &ctrl->qh_list;
+	uint32_t token;
+	int ret;
+
+	/* Unlinking needs the schedule stopped */
+	ret = ehci_disable_async(ctrl);
+
+	while (NEXT_QH(cur) != &ctrl->qh_list) {
+		if (NEXT_QH(cur) == queue->qh) {
+			cur->qh_link = queue->qh->qh_link;
+			flush_dcache_range((unsigned long)cur,
+					   ALIGN_END_ADDR(struct QH, cur, 1));
+			break;
+		}
+		cur = NEXT_QH(cur);
+	}
+
+	invalidate_dcache_range((unsigned long)queue->qh,
+		ALIGN_END_ADDR(struct QH, queue->qh, 1));
+	token = hc32_to_cpu(queue->qh->qh_overlay.qt_token);
+	if (!(QT_TOKEN_GET_STATUS(token) & QT_TOKEN_STATUS_HALTED))
+		usb_settoggle(dev, usb_pipeendpoint(queue->pipe),
+			      usb_pipeout(queue->pipe), QT_TOKEN_GET_DT(token));
+
+	if (--ctrl->bulk_queues && !ret)
+		ret = ehci_enable_async(ctrl);
+
+	free(queue->tds);
+	free(queue->qh);
+	free(queue);
+
+	return ret;
+}
+#endif /* CONFIG_USB_EHCI_BULK_QUEUE */
+
 #ifndef CONFIG_DM_USB
 int submit_bulk_msg(struct usb_device *dev, unsigned long pipe,
 			    void *buffer, int length)
@@ -1537,6 +1910,31 @@ int destroy_int_queue(struct usb_device *dev, struct int_queue *queue)
 {
 	return _ehci_destroy_int_queue(dev, queue);
 }
+
+#ifdef CONFIG_USB_EHCI_BULK_QUEUE
+struct bulk_queue *create_bulk_queue(struct usb_device *dev,
+				     unsigned long pipe, int maxlen)
+{
+	return _ehci_create_bulk_queue(dev, pipe, maxlen);
+}
+
+int submit_bulk_queue(struct usb_device *dev, struct bulk_queue *queue,
+		      void *buffer, int length)
+{
+	return _ehci_submit_bulk_queue(dev, queue, buffer, length);
+}
+
+int wait_bulk_queue(struct usb_device *dev, struct bulk_queue *queue,
+		    int *actlen)
+{
+	return _ehci_wait_bulk_queue(dev, queue, actlen);
+}
+
+int destroy_bulk_queue(struct usb_device *dev, struct bulk_queue *queue)
+{
+	return _ehci_destroy_bulk_queue(dev, queue);
+}
+#endif
 #endif
 
 #ifdef CONFIG_DM_USB
@@ -252,6 +252,7 @@ struct ehci_ctrl {
 	uint32_t *periodic_list;
 	int periodic_schedules;
 	int ntds;
+	int bulk_queues;	/* bulk queue QHs on the async schedule */
 	struct ehci_ops ops;
 	void *priv;	/* client's private data */
 };
@@ -1502,6 +1502,96 @@ int ext4fs_read_inode(struct ext2_data *data, int ino, struct ext2_inode *inode)
 	return 1;
 }
 
+/*
+ * Map @fileblock of an extent mapped inode. *@count is set to the number
+ * of file blocks from @fileblock on that are physically contiguous with
+ * it, or that are a hole like it, so they can be read in one go. With
+ * @read, unwritten extents are reported as holes since they read as
+ * zeroes; the write path needs their physical blocks.
+ * Returns the physical block, 0 for a hole, -ve on error.
+ */
+static long int ext4fs_map_extent(struct ext2_inode *inode, int fileblock,
+				  lbaint_t *count, int read)
+{
+	int unwritten;
+	struct ext4_extent_header *ext_block;
+	struct ext4_extent *extent;
+	unsigned long long start;
+	long int blknr = 0;
+	int blksz, log2_blksz;
+	int i, entries;
+	uint32_t first, len;
+	char *buf;
+
+	blksz = EXT2_BLOCK_SIZE(ext4fs_root);
+	log2_blksz = LOG2_BLOCK_SIZE(ext4fs_root)
+		- get_fs()->dev_desc->log2blksz;
+
+	buf = zalloc(blksz);
+	if (!buf)
+		return -ENOMEM;
+
+	ext_block = ext4fs_get_extent_block(ext4fs_root, buf,
+					    (struct ext4_extent_header *)
+					    inode->b.blocks.dir_blocks,
+					    fileblock, log2_blksz);
+	if (!ext_block) {
+		printf("invalid extent block\n");
+		free(buf);
+		return -EINVAL;
+	}
+
+	extent = (struct ext4_extent *)(ext_block + 1);
+	entries = le16_to_cpu(ext_block->eh_entries);
+
+	/* First extent starting after fileblock */
+	for (i = 0; i < entries; i++)
+		if (fileblock < le32_to_cpu(extent[i].ee_block))
+			break;
+
+	/* A hole up to the next extent, if this leaf knows it */
+	*count = i < entries ? le32_to_cpu(extent[i].ee_block) - fileblock : 1;
+
+	if (i > 0) {
+		first = le32_to_cpu(extent[i - 1].ee_block);
+		len = le16_to_cpu(extent[i - 1].ee_len);
+
+		unwritten = len > EXT4_EXT_INIT_MAX_LEN;
+		if (unwritten)
+			len -= EXT4_EXT_INIT_MAX_LEN;
+
+		if (fileblock - first < len && !(unwritten && read)) {
+			start = le16_to_cpu(extent[i - 1].ee_start_hi);
+			start = (start << 32) +
+				le32_to_cpu(extent[i - 1].ee_start_lo);
+			blknr = start + fileblock - first;
+		}
+
+		if (fileblock - first < len)
+			*count = len - (fileblock - first);
+	}
+
+	free(buf);
+
+	return blknr;
+}
+
+/*
+ * Like read_allocated_block(), but also sets *@count to the number of file
+ * blocks from @fileblock on that can be read together with it. Only extent
+ * mapped inodes give runs longer than one block.
+ */
+long int read_allocated_run(struct ext2_inode *inode, int fileblock,
+			    lbaint_t *count)
+{
+	if (le32_to_cpu(inode->flags) & EXT4_EXTENTS_FL)
+		return ext4fs_map_extent(inode, fileblock, count, 1);
+
+	*count = 1;
+
+	return read_allocated_block(inode, fileblock);
+}
+
 long int read_allocated_block(struct ext2_inode *inode, int fileblock)
 {
 	long int blknr;
@@ -1511,55 +1601,14 @@ long int read_allocated_block(struct ext2_inode *inode, int fileblock)
 	long int rblock;
 	long int perblock_parent;
 	long int perblock_child;
-	unsigned long long start;
+	lbaint_t count;
 	/* get the blocksize of the filesystem */
 	blksz = EXT2_BLOCK_SIZE(ext4fs_root);
 	log2_blksz = LOG2_BLOCK_SIZE(ext4fs_root)
 		- get_fs()->dev_desc->log2blksz;
 
-	if (le32_to_cpu(inode->flags) & EXT4_EXTENTS_FL) {
-		char *buf = zalloc(blksz);
-		if (!buf)
-			return -ENOMEM;
-		struct ext4_extent_header *ext_block;
-		struct ext4_extent *extent;
-		int i = -1;
-		ext_block =
-			ext4fs_get_extent_block(ext4fs_root, buf,
-						(struct ext4_extent_header *)
-						inode->b.blocks.dir_blocks,
-						fileblock, log2_blksz);
-		if (!ext_block) {
-			printf("invalid extent block\n");
-			free(buf);
-			return -EINVAL;
-		}
-
-		extent = (struct ext4_extent *)(ext_block + 1);
-
-		do {
-			i++;
-			if (i >= le16_to_cpu(ext_block->eh_entries))
-				break;
-		} while (fileblock >= le32_to_cpu(extent[i].ee_block));
-		if (--i >= 0) {
-			fileblock -= le32_to_cpu(extent[i].ee_block);
-			if (fileblock >= le16_to_cpu(extent[i].ee_len)) {
-				free(buf);
-				return 0;
-			}
-
-			start = le16_to_cpu(extent[i].ee_start_hi);
-			start = (start << 32) +
-					le32_to_cpu(extent[i].ee_start_lo);
-			free(buf);
-			return fileblock + start;
-		}
-
-		printf("Extent Error\n");
-		free(buf);
-		return -1;
-	}
+	if (le32_to_cpu(inode->flags) & EXT4_EXTENTS_FL)
+		return ext4fs_map_extent(inode, fileblock, &count, 0);
 
 	/* Direct blocks. */
 	if (fileblock < INDIRECT_BLOCKS)
@@ -45,23 +45,27 @@ void ext4fs_free_node(struct ext2fs_node *node, struct ext2fs_node *currroot)
  * Taken from openmoko-kernel mailing list: By Andy green
  * Optimized read file API : collects and defers contiguous sector
  * reads into one potentially more efficient larger sequential read action
+ *
+ * Blocks are looked up a run at a time, a whole extent for extent mapped
+ * files, and physically adjacent runs are merged, so a file that is not
+ * fragmented is read with a single device read.
  */
 int ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
 		loff_t len, char *buf, loff_t *actread)
 {
 	struct ext_filesystem *fs = get_fs();
-	int i;
+	lbaint_t i, first, run;
 	lbaint_t blockcnt;
 	int log2blksz = fs->dev_desc->log2blksz;
 	int log2_fs_blocksize = LOG2_BLOCK_SIZE(node->data) - log2blksz;
 	int blocksize = (1 << (log2_fs_blocksize + log2blksz));
 	unsigned int filesize = __le32_to_cpu(node->inode.size);
-	lbaint_t previous_block_number = -1;
 	lbaint_t delayed_start = 0;
 	lbaint_t delayed_extent = 0;
 	lbaint_t delayed_skipfirst = 0;
 	lbaint_t delayed_next = 0;
 	char *delayed_buf = NULL;
+	int delayed = 0;
 	short status;
 
 	/* Adjust len so it we can't read past the end of the file. */
@@ -69,65 +73,54 @@ int ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
 		len = filesize;
 
 	blockcnt = lldiv(((len + pos) + blocksize - 1), blocksize);
+	first = lldiv(pos, blocksize);
 
-	for (i = lldiv(pos, blocksize); i < blockcnt; i++) {
-		lbaint_t blknr;
-		int blockoff = pos - (blocksize * i);
-		int blockend = blocksize;
+	for (i = first; i < blockcnt; i += run) {
+		long int blknr;
+		lbaint_t sector, bytes;
 		int skipfirst = 0;
-		blknr = read_allocated_block(&(node->inode), i);
+
+		blknr = read_allocated_run(&(node->inode), i, &run);
 		if (blknr < 0)
 			return -1;
 
-		blknr = blknr << log2_fs_blocksize;
-
-		/* Last block.  */
-		if (i == blockcnt - 1) {
-			blockend = (len + pos) - (blocksize * i);
-
-			/* The last portion is exactly blocksize. */
-			if (!blockend)
-				blockend = blocksize;
-		}
+		if (run > blockcnt - i)
+			run = blockcnt - i;
+		bytes = run * blocksize;
 
 		/* First block. */
-		if (i == lldiv(pos, blocksize)) {
-			skipfirst = blockoff;
-			blockend -= skipfirst;
+		if (i == first) {
+			skipfirst = pos - (blocksize * i);
+			bytes -= skipfirst;
 		}
+
+		/* Last block, the last portion may be short. */
+		if (i + run == blockcnt)
+			bytes -= (blocksize * blockcnt) - (len + pos);
+
 		if (blknr) {
-			int status;
+			sector = (lbaint_t)blknr << log2_fs_blocksize;
 
-			if (previous_block_number != -1) {
-				if (delayed_next == blknr) {
-					delayed_extent += blockend;
-					delayed_next += blockend >> log2blksz;
-				} else {	/* spill */
+			if (delayed && delayed_next == sector) {
+				delayed_extent += bytes;
+			} else {
+				if (delayed) {	/* spill */
 					status = ext4fs_devread(delayed_start,
 							delayed_skipfirst,
 							delayed_extent,
 							delayed_buf);
 					if (status == 0)
 						return -1;
-					previous_block_number = blknr;
-					delayed_start = blknr;
-					delayed_extent = blockend;
-					delayed_skipfirst = skipfirst;
-					delayed_buf = buf;
-					delayed_next = blknr +
-						(blockend >> log2blksz);
 				}
-			} else {
-				previous_block_number = blknr;
-				delayed_start = blknr;
-				delayed_extent = blockend;
+				delayed = 1;
+				delayed_start = sector;
+				delayed_extent = bytes;
 				delayed_skipfirst = skipfirst;
 				delayed_buf = buf;
-				delayed_next = blknr +
-					(blockend >> log2blksz);
 			}
+			delayed_next = sector + (run << log2_fs_blocksize);
 		} else {
-			if (previous_block_number != -1) {
+			if (delayed) {
 				/* spill */
 				status = ext4fs_devread(delayed_start,
 							delayed_skipfirst,
@@ -135,20 +128,19 @@ int ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
 							delayed_buf);
 				if (status == 0)
 					return -1;
-				previous_block_number = -1;
+				delayed = 0;
 			}
-			memset(buf, 0, blocksize - skipfirst);
+			memset(buf, 0, bytes);
 		}
-		buf += blocksize - skipfirst;
+		buf += bytes;
 	}
-	if (previous_block_number != -1) {
+	if (delayed) {
 		/* spill */
 		status = ext4fs_devread(delayed_start,
 					delayed_skipfirst, delayed_extent,
 					delayed_buf);
 		if (status == 0)
 			return -1;
-		previous_block_number = -1;
 	}
 
 	*actread  = len;
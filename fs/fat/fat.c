@@ -322,10 +322,109 @@ get_cluster(fsdata *mydata, __u32 clustnum, __u8 *buffer, unsigned long size)
 	return 0;
 }
 
+/*
+ * File handles
+ *
+ * A handle keeps its own copy of the filesystem parameters and FAT buffer
+ * plus a run-length map of the cluster chain. The map is extended one run
+ * at a time as reads move forward, so a sequential reader touches every
+ * FAT entry of the file exactly once and reads each run of contiguous
+ * clusters with a single disk_read().
+ */
+#define FAT_FILE_MIN_RUNS	16
+
+static void fat_file_select(struct fat_file *file)
+{
+	cur_dev = file->dev;
+	cur_part_info = file->part;
+}
+
+/* Append the next run of contiguous clusters to the map */
+static int fat_file_map_run(struct fat_file *file)
+{
+	fsdata *mydata = &file->data;
+	unsigned int bytesperclust = mydata->clust_size * mydata->sect_size;
+	struct fat_run *runs;
+	__u32 start = file->next_clust;
+	__u32 len = 1;
+	__u32 next;
+
+	if (file->map_done)
+		return -1;
+
+	if (file->nruns == file->maxruns) {
+		int maxruns = max(file->maxruns * 2, FAT_FILE_MIN_RUNS);
+
+		runs = realloc(file->runs, maxruns * sizeof(*runs));
+		if (!runs) {
+			debug("Error: allocating memory\n");
+			return -1;
+		}
+		file->runs = runs;
+		file->maxruns = maxruns;
+	}
+
+	while (1) {
+		next = get_fatent(mydata, start + len - 1);
+		if (next != start + len ||
+		    file->map_end + (loff_t)len * bytesperclust >= file->size)
+			break;
+		len++;
+	}
+
+	file->runs[file->nruns].start = start;
+	file->runs[file->nruns].len = len;
+	file->nruns++;
+	file->map_end += (loff_t)len * bytesperclust;
+
+	if (file->map_end >= file->size) {
+		file->map_done = 1;
+	} else if (CHECK_CLUST(next, mydata->fatsize)) {
+		debug("curclust: 0x%x\n", next);
+		file->map_done = 1;
+	} else {
+		file->next_clust = next;
+	}
+
+	return 0;
+}
+
+/* Make file->cur the run holding byte 'pos' of the file */
+static int fat_file_find_run(struct fat_file *file, loff_t pos)
+{
+	unsigned int bytesperclust = file->data.clust_size *
+				     file->data.sect_size;
+	loff_t end;
+
+	if (pos < file->cur_pos) {
+		file->cur = 0;
+		file->cur_pos = 0;
+	}
+
+	while (1) {
+		while (file->cur >= file->nruns) {
+			if (fat_file_map_run(file))
+				return -1;
+		}
+
+		end = file->cur_pos +
+		      (loff_t)file->runs[file->cur].len * bytesperclust;
+		if (pos < end)
+			return 0;
+
+		file->cur_pos = end;
+		file->cur++;
+	}
+}
+
 /*
  * Read at most 'maxsize' bytes from 'pos' in the file associated with 'dentptr'
  * into 'buffer'.
  * Update the number of bytes read in *gotsize or return -1 on fatal errors.
+ *
+ * The whole cluster chain is mapped into runs before any data is read, so
+ * the FAT is walked in one pass through the FAT window and the file data
+ * is then read with one disk_read() per run of contiguous clusters.
  */
 __u8 get_contents_vfatname_block[MAX_CLUSTSIZE]
 	__aligned(ARCH_DMA_MINALIGN);
@@ -333,111 +432,56 @@ __u8 get_contents_vfatname_block[MAX_CLUSTSIZE]
 static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 			__u8 *buffer, loff_t maxsize, loff_t *gotsize)
 {
-	loff_t filesize = FAT2CPU32(dentptr->size);
-	unsigned int bytesperclust = mydata->clust_size * mydata->sect_size;
-	__u32 curclust = START(dentptr);
-	__u32 endclust, newclust;
-	loff_t actsize;
+	struct fat_file file;
+	loff_t len;
+	int ret;
 
 	*gotsize = 0;
-	debug("Filesize: %llu bytes\n", filesize);
 
-	if (pos >= filesize) {
+	memset(&file, 0, sizeof(file));
+	file.data = *mydata;
+	file.dev = cur_dev;
+	file.part = cur_part_info;
+	file.size = FAT2CPU32(dentptr->size);
+	file.next_clust = START(dentptr);
+	file.map_done = !file.size;
+
+	debug("Filesize: %llu bytes\n", file.size);
+
+	if (pos >= file.size) {
 		debug("Read position past EOF: %llu\n", pos);
 		return 0;
 	}
 
-	if (maxsize > 0 && filesize > pos + maxsize)
-		filesize = pos + maxsize;
+	while (!fat_file_map_run(&file))
+		;
 
-	debug("%llu bytes\n", filesize);
-
-	actsize = bytesperclust;
+	ret = -1;
+	if (!file.map_done)
+		goto out;
 
-	/* go to cluster at pos */
-	while (actsize <= pos) {
-		curclust = get_fatent(mydata, curclust);
-		if (CHECK_CLUST(curclust, mydata->fatsize)) {
-			debug("curclust: 0x%x\n", curclust);
-			debug("Invalid FAT entry\n");
-			return 0;
-		}
-		actsize += bytesperclust;
+	/* A broken chain ends the file where it ends */
+	if (file.map_end < file.size) {
+		debug("Invalid FAT entry\n");
+		file.size = file.map_end;
 	}
 
-	/* actsize > pos */
-	actsize -= bytesperclust;
-	filesize -= actsize;
-	pos -= actsize;
-
-	/* align to beginning of next cluster if any */
-	if (pos) {
-		actsize = min(filesize, (loff_t)bytesperclust);
-		if (get_cluster(mydata, curclust, get_contents_vfatname_block,
-				(int)actsize) != 0) {
-			printf("Error reading cluster\n");
-			return -1;
-		}
-		filesize -= actsize;
-		actsize -= pos;
-		memcpy(buffer, get_contents_vfatname_block + pos, actsize);
-		*gotsize += actsize;
-		if (!filesize)
-			return 0;
-		buffer += actsize;
-
-		curclust = get_fatent(mydata, curclust);
-		if (CHECK_CLUST(curclust, mydata->fatsize)) {
-			debug("curclust: 0x%x\n", curclust);
-			debug("Invalid FAT entry\n");
-			return 0;
-		}
-	}
+	ret = 0;
+	if (pos >= file.size)
+		goto out;
 
-	actsize = bytesperclust;
-	endclust = curclust;
+	len = file.size - pos;
+	if (maxsize > 0 && len > maxsize)
+		len = maxsize;
 
-	do {
-		/* search for consecutive clusters */
-		while (actsize < filesize) {
-			newclust = get_fatent(mydata, endclust);
-			if ((newclust - 1) != endclust)
-				goto getit;
-			if (CHECK_CLUST(newclust, mydata->fatsize)) {
-				debug("curclust: 0x%x\n", newclust);
-				debug("Invalid FAT entry\n");
-				return 0;
-			}
-			endclust = newclust;
-			actsize += bytesperclust;
-		}
+	file.pos = pos;
+	ret = fat_fread(&file, buffer, len, gotsize);
 
-		/* get remaining bytes */
-		actsize = filesize;
-		if (get_cluster(mydata, curclust, buffer, (int)actsize) != 0) {
-			printf("Error reading cluster\n");
-			return -1;
-		}
-		*gotsize += actsize;
-		return 0;
-getit:
-		if (get_cluster(mydata, curclust, buffer, (int)actsize) != 0) {
-			printf("Error reading cluster\n");
-			return -1;
-		}
-		*gotsize += (int)actsize;
-		filesize -= actsize;
-		buffer += actsize;
-
-		curclust = get_fatent(mydata, endclust);
-		if (CHECK_CLUST(curclust, mydata->fatsize)) {
-			debug("curclust: 0x%x\n", curclust);
-			printf("Invalid FAT entry\n");
-			return 0;
-		}
-		actsize = bytesperclust;
-		endclust = curclust;
-	} while (1);
+ out:
+	/* The FAT window is shared with the caller */
+	mydata->fatbufnum = file.data.fatbufnum;
+	free(file.runs);
+	return ret;
 }
 
 /*
@@ -814,8 +858,15 @@ exit:
 __u8 do_fat_read_at_block[MAX_CLUSTSIZE]
 	__aligned(ARCH_DMA_MINALIGN);
 
-int do_fat_read_at(const char *filename, loff_t pos, void *buffer,
-		   loff_t maxsize, int dols, int dogetsize, loff_t *size)
+/*
+ * Look up 'filename' and either list it, return its size or read it, as
+ * do_fat_read_at() does. If 'dentout' is given, the directory entry is
+ * copied there together with the filesystem parameters in 'fsout' instead,
+ * and the FAT buffer in fsout->fatbuf is left for the caller to free.
+ */
+static int do_fat_read_at_dent(const char *filename, loff_t pos, void *buffer,
+			       loff_t maxsize, int dols, int dogetsize,
+			       loff_t *size, fsdata *fsout, dir_entry *dentout)
 {
 	char fnamecopy[2048];
 	boot_sector bs;
@@ -823,6 +874,7 @@ int do_fat_read_at(const char *filename, loff_t pos, void *buffer,
 	fsdata datablock;
 	fsdata *mydata = &datablock;
 	dir_entry *dentptr = NULL;
+	dir_entry dent;		/* dentptr outlives the subdirectory loop */
 	__u16 prevcksum = 0xffff;
 	char *subname = "";
 	__u32 cursect;
@@ -1155,7 +1207,6 @@ rootdir_done:
 	while (isdir) {
 		int startsect = mydata->data_begin
 			+ START(dentptr) * mydata->clust_size;
-		dir_entry dent;
 		char *nextname = NULL;
 
 		dent = *dentptr;
@@ -1221,6 +1272,12 @@ rootdir_done:
 			subname = nextname;
 	}
 
+	if (dentout) {
+		*dentout = *dentptr;
+		*fsout = *mydata;
+		return 0;
+	}
+
 	if (dogetsize) {
 		*size = FAT2CPU32(dentptr->size);
 		ret = 0;
@@ -1234,6 +1291,13 @@ exit:
 	return ret;
 }
 
+int do_fat_read_at(const char *filename, loff_t pos, void *buffer,
+		   loff_t maxsize, int dols, int dogetsize, loff_t *size)
+{
+	return do_fat_read_at_dent(filename, pos, buffer, maxsize, dols,
+				   dogetsize, size, NULL, NULL);
+}
+
 int do_fat_read(const char *filename, void *buffer, loff_t maxsize, int dols,
 		loff_t *actread)
 {
@@ -1359,6 +1423,127 @@ void fat_close(void)
 {
 }
 
+struct fat_file *fat_fopen(const char *filename)
+{
+	struct fat_file *file;
+	fsdata *mydata;
+	dir_entry dent;
+	loff_t size;
+
+	file = calloc(1, sizeof(*file));
+	if (!file)
+		return NULL;
+
+	mydata = &file->data;
+	if (do_fat_read_at_dent(filename, 0, NULL, 0, LS_NO, 1, &size,
+				mydata, &dent)) {
+		free(file);
+		return NULL;
+	}
+
+	if (dent.attr & ATTR_DIR) {
+		printf("** %s is a directory **\n", filename);
+		fat_fclose(file);
+		return NULL;
+	}
+
+	file->dev = cur_dev;
+	file->part = cur_part_info;
+	file->size = FAT2CPU32(dent.size);
+	file->next_clust = START(&dent);
+	file->map_done = !file->size;
+
+	return file;
+}
+
+int fat_fread(struct fat_file *file, void *buf, loff_t len, loff_t *actread)
+{
+	fsdata *mydata = &file->data;
+	unsigned int bytesperclust = mydata->clust_size * mydata->sect_size;
+	__u8 *buffer = buf;
+	struct fat_run *run;
+	__u32 off, sect, nsect;
+	loff_t n;
+
+	*actread = 0;
+
+	if (file->pos >= file->size)
+		return 0;
+
+	if (len > file->size - file->pos)
+		len = file->size - file->pos;
+
+	fat_file_select(file);
+
+	while (len) {
+		if (fat_file_find_run(file, file->pos)) {
+			printf("Invalid FAT entry\n");
+			return -1;
+		}
+
+		run = &file->runs[file->cur];
+		off = file->pos - file->cur_pos;
+		n = min((loff_t)run->len * bytesperclust - off, len);
+		sect = mydata->data_begin + run->start * mydata->clust_size +
+		       off / mydata->sect_size;
+		off %= mydata->sect_size;
+
+		if (off || n < mydata->sect_size ||
+		    ((unsigned long)buffer & (ARCH_DMA_MINALIGN - 1))) {
+			ALLOC_CACHE_ALIGN_BUFFER(__u8, tmpbuf,
+						 mydata->sect_size);
+
+			if (disk_read(sect, 1, tmpbuf) != 1) {
+				printf("Error reading cluster\n");
+				return -1;
+			}
+
+			n = min(n, (loff_t)(mydata->sect_size - off));
+			memcpy(buffer, tmpbuf + off, n);
+		} else {
+			nsect = (__u32)n / mydata->sect_size;
+			if (disk_read(sect, nsect, buffer) != nsect) {
+				printf("Error reading cluster\n");
+				return -1;
+			}
+
+			n = (loff_t)nsect * mydata->sect_size;
+		}
+
+		buffer += n;
+		file->pos += n;
+		*actread += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+int fat_fseek(struct fat_file *file, loff_t pos)
+{
+	if (pos < 0 || pos > file->size)
+		return -1;
+
+	file->pos = pos;
+
+	return 0;
+}
+
+loff_t fat_fsize(struct fat_file *file)
+{
+	return file->size;
+}
+
+void fat_fclose(struct fat_file *file)
+{
+	if (!file)
+		return;
+
+	free(file->data.fatbuf);
+	free(file->runs);
+	free(file);
+}
+
 signed long long do_fat_get_file_size (const char *filename)
 {
 	char fnamecopy[2048];
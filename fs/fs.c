@@ -17,6 +17,7 @@
 #include <config.h>
 #include <errno.h>
 #include <common.h>
+#include <malloc.h>
 #include <mapmem.h>
 #include <part.h>
 #include <ext4fs.h>
@@ -74,6 +75,53 @@ static inline void fs_close_unsupported(void)
 {
 }
 
+static inline void *fs_fopen_unsupported(const char *filename, loff_t *size)
+{
+	return NULL;
+}
+
+static inline int fs_fread_unsupported(void *file, void *buf, loff_t len,
+				       loff_t *actread)
+{
+	return -1;
+}
+
+static inline int fs_fseek_unsupported(void *file, loff_t pos)
+{
+	return -1;
+}
+
+static inline void fs_fclose_unsupported(void *file)
+{
+}
+
+#ifdef CONFIG_FS_FAT
+static void *fs_fopen_fat(const char *filename, loff_t *size)
+{
+	struct fat_file *file = fat_fopen(filename);
+
+	if (file)
+		*size = fat_fsize(file);
+
+	return file;
+}
+
+static int fs_fread_fat(void *file, void *buf, loff_t len, loff_t *actread)
+{
+	return fat_fread(file, buf, len, actread);
+}
+
+static int fs_fseek_fat(void *file, loff_t pos)
+{
+	return fat_fseek(file, pos);
+}
+
+static void fs_fclose_fat(void *file)
+{
+	fat_fclose(file);
+}
+#endif
+
 static inline int fs_uuid_unsupported(char *uuid_str)
 {
 	return -1;
@@ -102,6 +150,17 @@ struct fstype_info {
 		     loff_t len, loff_t *actwrite);
 	void (*close)(void);
 	int (*uuid)(char *uuid_str);
+	/* File handle interface, see fs_fopen() */
+	void *(*fopen)(const char *filename, loff_t *size);
+	int (*fread)(void *file, void *buf, loff_t len, loff_t *actread);
+	int (*fseek)(void *file, loff_t pos);
+	void (*fclose)(void *file);
+};
+
+struct fs_file {
+	struct fstype_info *info;
+	void *priv;
+	loff_t size;
 };
 
 static struct fstype_info fstypes[] = {
@@ -122,6 +181,10 @@ static struct fstype_info fstypes[] = {
 		.write = fs_write_unsupported,
 #endif
 		.uuid = fs_uuid_unsupported,
+		.fopen = fs_fopen_fat,
+		.fread = fs_fread_fat,
+		.fseek = fs_fseek_fat,
+		.fclose = fs_fclose_fat,
 	},
 #endif
 #ifdef CONFIG_FS_EXT4
@@ -141,6 +204,10 @@ static struct fstype_info fstypes[] = {
 		.write = fs_write_unsupported,
 #endif
 		.uuid = ext4fs_uuid,
+		.fopen = fs_fopen_unsupported,
+		.fread = fs_fread_unsupported,
+		.fseek = fs_fseek_unsupported,
+		.fclose = fs_fclose_unsupported,
 	},
 #endif
 #ifdef CONFIG_SANDBOX
@@ -156,6 +223,10 @@ static struct fstype_info fstypes[] = {
 		.read = fs_read_sandbox,
 		.write = fs_write_sandbox,
 		.uuid = fs_uuid_unsupported,
+		.fopen = fs_fopen_unsupported,
+		.fread = fs_fread_unsupported,
+		.fseek = fs_fseek_unsupported,
+		.fclose = fs_fclose_unsupported,
 	},
 #endif
 #ifdef CONFIG_CMD_UBIFS
@@ -171,6 +242,10 @@ static struct fstype_info fstypes[] = {
 		.read = ubifs_read,
 		.write = fs_write_unsupported,
 		.uuid = fs_uuid_unsupported,
+		.fopen = fs_fopen_unsupported,
+		.fread = fs_fread_unsupported,
+		.fseek = fs_fseek_unsupported,
+		.fclose = fs_fclose_unsupported,
 	},
 #endif
 	{
@@ -185,6 +260,10 @@ static struct fstype_info fstypes[] = {
 		.read = fs_read_unsupported,
 		.write = fs_write_unsupported,
 		.uuid = fs_uuid_unsupported,
+		.fopen = fs_fopen_unsupported,
+		.fread = fs_fread_unsupported,
+		.fseek = fs_fseek_unsupported,
+		.fclose = fs_fclose_unsupported,
 	},
 };
 
@@ -324,6 +403,61 @@ int fs_read(const char *filename, ulong addr, loff_t offset, loff_t len,
 	return ret;
 }
 
+struct fs_file *fs_fopen(const char *filename)
+{
+	struct fstype_info *info = fs_get_info(fs_type);
+	struct fs_file *file;
+
+	file = calloc(1, sizeof(*file));
+	if (!file)
+		goto err;
+
+	file->info = info;
+	file->priv = info->fopen(filename, &file->size);
+	if (!file->priv) {
+		free(file);
+		goto err;
+	}
+
+	return file;
+
+err:
+	fs_close();
+	return NULL;
+}
+
+int fs_fread(struct fs_file *file, ulong addr, loff_t len, loff_t *actread)
+{
+	void *buf;
+	int ret;
+
+	buf = map_sysmem(addr, len);
+	ret = file->info->fread(file->priv, buf, len, actread);
+	unmap_sysmem(buf);
+
+	return ret;
+}
+
+int fs_fseek(struct fs_file *file, loff_t pos)
+{
+	return file->info->fseek(file->priv, pos);
+}
+
+loff_t fs_fsize(struct fs_file *file)
+{
+	return file->size;
+}
+
+void fs_fclose(struct fs_file *file)
+{
+	if (!file)
+		return;
+
+	file->info->fclose(file->priv);
+	free(file);
+	fs_close();
+}
+
 int fs_write(const char *filename, ulong addr, loff_t offset, loff_t len,
 	     loff_t *actwrite)
 {
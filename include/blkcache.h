@@ -0,0 +1,73 @@
+/*
+ * Block device read cache
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef _BLKCACHE_H
+#define _BLKCACHE_H
+
+#include <part.h>
+
+struct block_cache_stats {
+	unsigned hits;
+	unsigned misses;
+	unsigned entries;		/* entries in use */
+	unsigned max_blocks_per_entry;
+	unsigned max_entries;
+};
+
+#ifdef CONFIG_BLOCK_CACHE
+/**
+ * blkcache_read() - serve a read from the cache
+ *
+ * @iftype:	IF_TYPE_* of the device
+ * @dev:	device number
+ * @start:	first block
+ * @blkcnt:	number of blocks
+ * @blksz:	block size in bytes
+ * @buffer:	destination
+ * @return 1 if the blocks were copied from the cache, 0 on a miss
+ */
+int blkcache_read(int iftype, int dev, lbaint_t start, lbaint_t blkcnt,
+		  unsigned long blksz, void *buffer);
+
+/**
+ * blkcache_fill() - remember blocks just read from a device
+ *
+ * Reads larger than the configured entry size are not cached, so file
+ * data streaming through does not push the metadata out.
+ */
+void blkcache_fill(int iftype, int dev, lbaint_t start, lbaint_t blkcnt,
+		   unsigned long blksz, void const *buffer);
+
+/**
+ * blkcache_invalidate() - drop the cached blocks of a device
+ *
+ * Has to be called when the device is written, rescanned, switched to
+ * another hardware partition or removed.
+ *
+ * @dev:	device number, or -1 for every device of @iftype
+ */
+void blkcache_invalidate(int iftype, int dev);
+
+/* Change the cache geometry, dropping everything that is cached */
+void blkcache_configure(unsigned blocks, unsigned entries);
+
+void blkcache_stats(struct block_cache_stats *stats);
+#else
+static inline int blkcache_read(int iftype, int dev, lbaint_t start,
+				lbaint_t blkcnt, unsigned long blksz,
+				void *buffer)
+{
+	return 0;
+}
+
+static inline void blkcache_fill(int iftype, int dev, lbaint_t start,
+				 lbaint_t blkcnt, unsigned long blksz,
+				 void const *buffer) {}
+
+static inline void blkcache_invalidate(int iftype, int dev) {}
+#endif
+
+#endif /* _BLKCACHE_H */
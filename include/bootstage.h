@@ -15,6 +15,9 @@
 #ifndef CONFIG_BOOTSTAGE_USER_COUNT
 #define CONFIG_BOOTSTAGE_USER_COUNT	20
 #endif
+#ifndef CONFIG_BOOTSTAGE_BOARD_COUNT
+#define CONFIG_BOOTSTAGE_BOARD_COUNT	0
+#endif
 
 /* Flags for each bootstage record */
 enum bootstage_flags {
@@ -199,8 +202,11 @@ enum bootstage_id {
 	BOOTSTAGE_ID_ACCUM_SPI,
 	BOOTSTAGE_ID_ACCUM_DECOMP,
 
+	/* fixed IDs for board code, CONFIG_BOOTSTAGE_BOARD_COUNT of them */
+	BOOTSTAGE_ID_BOARD,
+
 	/* a few spare for the user, from here */
-	BOOTSTAGE_ID_USER,
+	BOOTSTAGE_ID_USER = BOOTSTAGE_ID_BOARD + CONFIG_BOOTSTAGE_BOARD_COUNT,
 	BOOTSTAGE_ID_COUNT = BOOTSTAGE_ID_USER + CONFIG_BOOTSTAGE_USER_COUNT,
 	BOOTSTAGE_ID_ALLOC,
 };
@@ -298,6 +304,27 @@ uint32_t bootstage_start(enum bootstage_id id, const char *name);
  */
 uint32_t bootstage_accum(enum bootstage_id id);
 
+/**
+ * Mark the end of a bootstage activity that moved data
+ *
+ * Like bootstage_accum(), and also adds @bytes to the amount of data the
+ * activity has moved, so that a throughput can be reported for it.
+ *
+ * @param id	Bootstage id to record this timestamp against
+ * @param bytes	Number of bytes read or written in this iteration
+ * @return time spent in this iteration of the activity
+ */
+uint32_t bootstage_accum_bytes(enum bootstage_id id, ulong bytes);
+
+/**
+ * Get the time accumulated by a bootstage activity so far
+ *
+ * @param id	Bootstage id of the activity
+ * @param bytes	If not NULL, returns the number of bytes the activity moved
+ * @return accumulated time in microseconds, 0 if never started
+ */
+uint32_t bootstage_get_accum(enum bootstage_id id, ulong *bytes);
+
 /* Print a report about boot time */
 void bootstage_report(void);
 
@@ -380,6 +407,20 @@ static inline uint32_t bootstage_accum(enum bootstage_id id)
 	return 0;
 }
 
+static inline uint32_t bootstage_accum_bytes(enum bootstage_id id,
+					     ulong bytes)
+{
+	return 0;
+}
+
+static inline uint32_t bootstage_get_accum(enum bootstage_id id,
+					   ulong *bytes)
+{
+	if (bytes)
+		*bytes = 0;
+	return 0;
+}
+
 static inline int bootstage_stash(void *base, int size)
 {
 	return 0;	/* Pretend to succeed */
@@ -832,9 +832,31 @@ int gzwrite(unsigned char *src, int len,
 	    u64 startoffs,
 	    u64 szexpected);
 
+/**
+ * Incremental gunzip: feed compressed data in pieces of any size with
+ * gzstream_write(); inflated data is passed to @out in pieces of at most
+ * @szwindow bytes. gzstream_close() checks the gzip trailer and frees the
+ * stream. A non-zero return from @out aborts the write.
+ */
+struct gzstream;
+struct gzstream *gzstream_open(unsigned long szwindow,
+			       int (*out)(void *priv, const void *buf,
+					  unsigned long len),
+			       void *priv);
+int gzstream_write(struct gzstream *z, const void *buf, unsigned long len);
+int gzstream_close(struct gzstream *z);
+
 /* lib/lz4_wrapper.c */
 int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn);
 
+/* Incremental LZ4 frame decoder, used like gzstream_*() above */
+struct ulz4stream;
+struct ulz4stream *ulz4stream_open(int (*out)(void *priv, const void *buf,
+					       unsigned long len),
+				   void *priv);
+int ulz4stream_write(struct ulz4stream *z, const void *buf, unsigned long len);
+int ulz4stream_close(struct ulz4stream *z);
+
 /* lib/qsort.c */
 void qsort(void *base, size_t nmemb, size_t size,
 	   int(*compar)(const void *, const void *));
@@ -92,6 +92,10 @@
 #define CONFIG_CMD_FUSE
 #define CONFIG_MXC_OCOTP
 
+/* CAAM, brought up from arch_misc_init() with CONFIG_FSL_CAAM */
+#define CONFIG_SYS_FSL_SEC_COMPAT	4
+#define CONFIG_SYS_FSL_SEC_LE
+
 /*
  * Default boot linux kernel in no secure mode.
  * If want to boot kernel in secure mode, please define CONFIG_MX7_SEC
@@ -24,6 +24,7 @@
 #define CONFIG_MUSB_HOST
 /*********** MOXA CONFIG START*************/
 #define CONFIG_FIT                          // for ITB IMAGE
+#define CONFIG_ARCH_MISC_INIT               // CAAM job ring + RNG
 #define CONFIG_VERSION_VARIABLE             // for BIOS version
 #undef CONFIG_DM_SERIAL
 #undef CONFIG_DM_GPIO
@@ -31,6 +32,7 @@
 #undef USB_BUFSIZ
 #define USB_BUFSIZ                    512
 #define CONFIG_FAT_WRITE                1
+#define CONFIG_FS_FAT_BUFBLOCKS         384     // 192KiB FAT window
 #define CONFIG_I2C_REPEATED_START       1
 #define CONFIG_MOXA_CONSOLE             1
 #define CONFIG_MOXA_LIB                 1
@@ -50,8 +52,13 @@
 #define CONFIG_MOXA_TPM                 1
 #define CONFIG_MOXA_TPM2                1
 #define CONFIG_MOXA_BOOT                1
+#define CONFIG_MOXA_FIT_PARTIAL_LOAD    1
 #define CONFIG_MOXA_UPGRADE             1
-#define EMMC_COPY_LIMIT_SIZE            31457280
+#define CONFIG_MOXA_FW_STREAM_SLOTS     4
+#define CONFIG_MOXA_FW_STREAM_SLOT_SIZE SZ_1M
+/* #define CONFIG_MOXA_FW_SPARSE_ERASE */
+/* #define CONFIG_MOXA_HTTP_UPGRADE */	/* until validated on both FEC ports */
+#define CONFIG_MOXA_FW_MMC_CACHE        /* eMMC cache during upgrades */
 #define	CONFIG_PHY_TI			1
 /* #define CONFIG_BOOTDELAY		2 */
 #define CONFIG_MOXA_RTC			1
@@ -79,12 +86,21 @@
 
 #define IMX7_USE_SAME_MDIO 
 
+#define CONFIG_FEC_MXC_RBD_NUM          128
+#define CONFIG_TFTP_WINDOWSIZE          16           // RFC 7440, well below the FEC RX ring
+#define CONFIG_CMD_HTTPGET                           // firmware fetch where TFTP is blocked
+#define CONFIG_TCP_RCV_WND              65535        // ~45 segments, inside the FEC RX ring
+#define CONFIG_NET_DUAL_FETCH                        // httpget over FEC0 + FEC1 when eth1ipaddr is set
+
 #define CONFIG_PHYLIB
 #define CONFIG_PHY_REALTEK
 
 
 /* MMC Config*/
 #define CONFIG_SYS_FSL_ESDHC_ADDR       0
+#define CONFIG_FSL_ESDHC_ADMA
+#define CONFIG_BLOCK_CACHE
+#define CONFIG_CMD_BLOCK_CACHE
 
 /* PMIC */
 #define CONFIG_POWER
@@ -188,6 +204,7 @@
 #define CONFIG_SYS_MAX_FLASH_BANKS	1
 
 #define CONFIG_MXC_SPI
+#define CONFIG_MXC_SPI_BURST
 #define CONFIG_ENV_SIZE			(128 << 10)  //128KiB
 #define CONFIG_ENV_IS_IN_SPI_FLASH
 #define CONFIG_SYS_REDUNDAND_ENVIRONMENT
@@ -195,11 +212,12 @@
 #define CONFIG_ENV_SECT_SIZE		(0x10000) /* 4 KB sectors */
 #define CONFIG_ENV_OFFSET		0x180000 /* 1536 KiB in */
 #define CONFIG_ENV_OFFSET_REDUND	0x1A0000 /* 896 KiB in */
+#define CONFIG_ENV_LOG_OFFSET		0x1C0000 /* sector after the backup env */
 #define MTDIDS_DEFAULT			"nor0=m25p80-flash.0"
 #define MTDPARTS_DEFAULT		"mtdparts=m25p80-flash.0:128k(SPL)," \
-					"512k(u-boot),128k(u-boot-env1)," \
-					"128k(u-boot-env2),3464k(kernel)," \
-					"-(rootfs)"
+					"1408k(u-boot),128k(u-boot-env1)," \
+					"128k(u-boot-env2),64k(u-boot-envlog)," \
+					"3464k(kernel),-(rootfs)"
 
 #define CONFIG_SYS_FSL_USDHC_NUM	2
 #define CONFIG_SYS_MMC_ENV_DEV		0   /* USDHC1 */
@@ -211,6 +229,7 @@
 #define CONFIG_USB_EHCI
 #define CONFIG_USB_EHCI_MX7
 #define CONFIG_USB_STORAGE
+#define CONFIG_USB_EHCI_BULK_QUEUE
 #define CONFIG_EHCI_HCD_INIT_AFTER_RESET
 #define CONFIG_USB_HOST_ETHER
 #define CONFIG_USB_ETHER_ASIX
@@ -284,7 +303,10 @@
 #define CONFIG_CMD_SF
 #define CONFIG_SPI_FLASH
 #define CONFIG_SPI_FLASH_MACRONIX
+#define CONFIG_SPI_FLASH_MX25L6406E
 #define CONFIG_SPI_FLASH_BAR
+#define CONFIG_SYS_FSL_QSPI_AHB
+#define CONFIG_FSL_QSPI_QUAD_READ
 #define CONFIG_SF_DEFAULT_BUS		0
 #define CONFIG_SF_DEFAULT_CS		0
 #define CONFIG_SF_DEFAULT_SPEED		40000000
@@ -11,6 +11,7 @@
 #define _FAT_H_
 
 #include <asm/byteorder.h>
+#include <part.h>
 
 #define CONFIG_SUPPORT_VFAT
 /* Maximum Long File Name length supported here is 128 UTF-16 code units */
@@ -27,7 +28,17 @@
 #define DIRENTSPERCLUST	((mydata->clust_size * mydata->sect_size) / \
 			 sizeof(dir_entry))
 
+/*
+ * Sectors of the FAT read at a time by get_fatent(). Make it large enough
+ * to hold the whole FAT of the boot partition, so following a fragmented
+ * cluster chain does not go back to the device. It has to be a multiple
+ * of 3 so that FAT12 entries never straddle two windows.
+ */
+#ifdef CONFIG_FS_FAT_BUFBLOCKS
+#define FATBUFBLOCKS	CONFIG_FS_FAT_BUFBLOCKS
+#else
 #define FATBUFBLOCKS	6
+#endif
 #define FATBUFSIZE	(mydata->sect_size * FATBUFBLOCKS)
 #define FAT12BUFSIZE	((FATBUFSIZE*2)/3)
 #define FAT16BUFSIZE	(FATBUFSIZE/2)
@@ -177,6 +188,32 @@ typedef struct {
 	int	fatbufnum;	/* Used by get_fatent, init to -1 */
 } fsdata;
 
+/* 'len' clusters starting at cluster 'start', contiguous on disk */
+struct fat_run {
+	__u32	start;
+	__u32	len;
+};
+
+/*
+ * Open file, see fat_fopen(). The cluster chain is mapped into runs[]
+ * lazily as reads move forward.
+ */
+struct fat_file {
+	fsdata		data;		/* Own copy, fatbuf belongs to the file */
+	block_dev_desc_t *dev;		/* Device and partition of the file */
+	disk_partition_t part;
+	loff_t		size;		/* File size in bytes */
+	loff_t		pos;		/* Current read position */
+	struct fat_run	*runs;		/* Cluster map */
+	int		nruns;
+	int		maxruns;
+	loff_t		map_end;	/* File bytes covered by runs[] */
+	__u32		next_clust;	/* First cluster not yet mapped */
+	int		map_done;	/* Chain mapped up to its end */
+	int		cur;		/* Run of the last read */
+	loff_t		cur_pos;	/* File offset of runs[cur] */
+};
+
 typedef int	(file_detectfs_func)(void);
 typedef int	(file_ls_func)(const char *dir);
 typedef int	(file_read_func)(const char *filename, void *buffer,
@@ -212,4 +249,10 @@ int file_fat_write(const char *filename, void *buf, loff_t offset, loff_t len,
 int fat_read_file(const char *filename, void *buf, loff_t offset, loff_t len,
 		  loff_t *actread);
 void fat_close(void);
+
+struct fat_file *fat_fopen(const char *filename);
+int fat_fread(struct fat_file *file, void *buf, loff_t len, loff_t *actread);
+int fat_fseek(struct fat_file *file, loff_t pos);
+loff_t fat_fsize(struct fat_file *file);
+void fat_fclose(struct fat_file *file);
 #endif /* _FAT_H_ */
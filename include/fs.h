@@ -18,6 +18,8 @@
 
 #include <common.h>
 
+struct fs_file;
+
 #define FS_TYPE_ANY	0
 #define FS_TYPE_FAT	1
 #define FS_TYPE_EXT	2
@@ -74,6 +76,40 @@ int fs_size(const char *filename, loff_t *size);
 int fs_read(const char *filename, ulong addr, loff_t offset, loff_t len,
 	    loff_t *actread);
 
+/*
+ * fs_fopen - Open a file on the partition previously set by fs_set_blk_dev()
+ * for repeated reads. Unlike the other calls, the partition stays selected
+ * until the file is closed with fs_fclose(). Only FAT supports this so far.
+ *
+ * @filename: Name of file to open
+ * @return file handle, or NULL if the file can't be opened
+ */
+struct fs_file *fs_fopen(const char *filename);
+
+/*
+ * fs_fread - Read from the current position of an open file and advance it
+ *
+ * @file: File handle from fs_fopen()
+ * @addr: The address to read into
+ * @len: The number of bytes to read
+ * @actread: Returns the actual number of bytes read, short at end of file
+ * @return 0 if ok with valid *actread, -1 on error conditions
+ */
+int fs_fread(struct fs_file *file, ulong addr, loff_t len, loff_t *actread);
+
+/*
+ * fs_fseek - Set the read position of an open file
+ *
+ * @return 0 if ok, -1 if pos is outside the file
+ */
+int fs_fseek(struct fs_file *file, loff_t pos);
+
+/* fs_fsize - Size of an open file in bytes */
+loff_t fs_fsize(struct fs_file *file);
+
+/* fs_fclose - Close a file opened by fs_fopen() */
+void fs_fclose(struct fs_file *file);
+
 /*
  * fs_write - Write file to the partition previously set by fs_set_blk_dev()
  * Note that not all filesystem types support offset!=0.
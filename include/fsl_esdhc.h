@@ -85,6 +85,7 @@
 
 #define PRSSTAT			0x0002e024
 #define PRSSTAT_DAT0		(0x01000000)
+#define PRSSTAT_DAT_MASK	(0x0f000000)
 #define PRSSTAT_CLSL		(0x00800000)
 #define PRSSTAT_WPSPL		(0x00080000)
 #define PRSSTAT_CDPL		(0x00040000)
@@ -100,6 +101,8 @@
 #define PROCTL_INIT		0x00000020
 #define PROCTL_DTW_4		0x00000002
 #define PROCTL_DTW_8		0x00000004
+#define PROCTL_DMAS_MASK	0x00000300
+#define PROCTL_DMAS_ADMA2	0x00000200
 
 #define CMDARG			0x0002e008
 
@@ -166,6 +169,29 @@
 #define ESDHC_HOSTCAPBLT_HSS	0x00200000
 
 #define ESDHC_VENDORSPEC_VSELECT 0x00000002 /* Use 1.8V */
+#define ESDHC_VENDORSPEC_CKEN	0x00004000 /* Card clock enable */
+
+#define ESDHC_MIX_CTRL_EXE_TUNE		0x00400000
+#define ESDHC_MIX_CTRL_SMPCLK_SEL	0x00800000
+#define ESDHC_MIX_CTRL_AUTO_TUNE_EN	0x01000000
+#define ESDHC_MIX_CTRL_FBCLK_SEL	0x02000000
+
+/* Delay cell range swept by manual tuning */
+#define ESDHC_TUNE_CTRL_MIN	0
+#define ESDHC_TUNE_CTRL_MAX	((1 << 7) - 1)
+#define ESDHC_TUNE_CTRL_STEP	1
+
+/* ADMA2 descriptor attributes */
+#define ADMA2_VALID		0x0001
+#define ADMA2_END		0x0002
+#define ADMA2_ACT_TRAN		0x0020
+#define ADMA2_MAX_LEN		0xfffc	/* word multiple below 64 KiB */
+
+struct fsl_esdhc_adma_desc {
+	u16	attr;
+	u16	len;
+	u32	addr;
+};
 
 struct fsl_esdhc_cfg {
 #ifdef CONFIG_FSL_LAYERSCAPE
@@ -175,7 +201,16 @@ struct fsl_esdhc_cfg {
 #endif
 	u32	sdhc_clk;
 	u8	max_bus_width;
+	int	vs18_enable;	/* port may signal at 1.8V (HS200, UHS-I) */
+	int	tune_val;	/* delay cell picked by tuning */
 	struct mmc_config cfg;
+#ifdef CONFIG_FSL_ESDHC_ADMA
+	struct fsl_esdhc_adma_desc *adma_table;
+	u8	*adma_bounce;	/* two cache lines for unaligned read ends */
+	u32	adma_head;	/* bytes read into the first bounce line */
+	u32	adma_tail;	/* bytes read into the second bounce line */
+	int	adma_active;	/* current transfer uses the table */
+#endif
 };
 
 /* Select the correct accessors depending on endianess */
@@ -890,6 +890,39 @@ int fit_check_format(const void *fit);
 int fit_conf_find_compat(const void *fit, const void *fdt);
 int fit_conf_get_node(const void *fit, const char *conf_uname);
 
+/* Read @len bytes from @offset of a FIT stored elsewhere, 0 on success */
+typedef int (*fit_read_fn)(void *priv, ulong offset, void *buf, ulong len);
+
+/**
+ * fit_read_tree() - Read the tree of a FIT without the image data
+ *
+ * The blob is laid out at @fit exactly as in the file, but the values of
+ * all "data" properties are left unread. All fit_*() lookups work on the
+ * result; fit_image_read_data() then fills in the images actually needed.
+ *
+ * @fit:	Where to place the FIT
+ * @size:	Space available at @fit
+ * @read:	Reads from the FIT file
+ * @priv:	Passed to @read
+ * @return 0 if OK, -ve on error
+ */
+int fit_read_tree(void *fit, ulong size, fit_read_fn read, void *priv);
+
+/**
+ * fit_image_read_data() - Read the data of one image into a FIT tree
+ *
+ * Reads the data of image @noffset into its place in a FIT obtained with
+ * fit_read_tree() and checks all of its hash nodes while reading, so the
+ * data does not have to be hashed again afterwards. With
+ * CONFIG_SHA_HW_ACCEL, SHA-1/256 are instead computed by the accelerator
+ * over the whole image once it has been read.
+ *
+ * @return 0 if read and all hashes match, -EPROTONOSUPPORT if the data was
+ * read but some hash could not be checked on the fly, other -ve on error
+ */
+int fit_image_read_data(const void *fit, int noffset, fit_read_fn read,
+			void *priv);
+
 /**
  * fit_conf_get_prop_node() - Get node refered to by a configuration
  * @fit:	FIT to check
@@ -56,8 +56,14 @@
 #define MMC_MODE_8BIT		(1 << 3)
 #define MMC_MODE_SPI		(1 << 4)
 #define MMC_MODE_DDR_52MHz	(1 << 5)
+#define MMC_MODE_HS200		(1 << 6)
+#define MMC_MODE_UHS_SDR50	(1 << 7)
+#define MMC_MODE_UHS_SDR104	(1 << 8)
+
+#define MMC_MODE_UHS		(MMC_MODE_UHS_SDR50 | MMC_MODE_UHS_SDR104)
 
 #define SD_DATA_4BIT	0x00040000
+#define SD_CMD23_SUPPORT	0x00000002	/* in scr[0] */
 
 #define IS_SD(x)	((x)->version & SD_VERSION_SD)
 #define IS_MMC(x)	((x)->version & MMC_VERSION_MMC)
@@ -71,6 +77,17 @@
 #define TIMEOUT			-19
 #define SWITCH_ERR		-20 /* Card reports failure to switch mode */
 
+/* Bus timing in use, see mmc->timing */
+#define MMC_TIMING_LEGACY	0
+#define MMC_TIMING_HS		1	/* SD/MMC high speed, also DDR52 */
+#define MMC_TIMING_MMC_HS200	2
+#define MMC_TIMING_UHS_SDR50	3
+#define MMC_TIMING_UHS_SDR104	4
+
+/* I/O signalling level, see mmc->signal_voltage */
+#define MMC_SIGNAL_VOLTAGE_330	0
+#define MMC_SIGNAL_VOLTAGE_180	1
+
 #define MMC_CMD_GO_IDLE_STATE		0
 #define MMC_CMD_SEND_OP_COND		1
 #define MMC_CMD_ALL_SEND_CID		2
@@ -86,6 +103,7 @@
 #define MMC_CMD_SET_BLOCKLEN		16
 #define MMC_CMD_READ_SINGLE_BLOCK	17
 #define MMC_CMD_READ_MULTIPLE_BLOCK	18
+#define MMC_CMD_SEND_TUNING_BLOCK_HS200	21
 #define MMC_CMD_SET_BLOCK_COUNT         23
 #define MMC_CMD_WRITE_SINGLE_BLOCK	24
 #define MMC_CMD_WRITE_MULTIPLE_BLOCK	25
@@ -105,6 +123,7 @@
 #define SD_CMD_SWITCH_FUNC		6
 #define SD_CMD_SEND_IF_COND		8
 #define SD_CMD_SWITCH_UHS18V		11
+#define SD_CMD_SEND_TUNING_BLOCK	19
 
 #define SD_CMD_APP_SET_BUS_WIDTH	6
 #define SD_CMD_ERASE_WR_BLK_START	32
@@ -115,9 +134,17 @@
 /* SCR definitions in different words */
 #define SD_HIGHSPEED_BUSY	0x00020000
 #define SD_HIGHSPEED_SUPPORTED	0x00020000
+#define SD_UHS_SDR50_SUPPORTED	0x00040000
+#define SD_UHS_SDR104_SUPPORTED	0x00080000
+
+/* Function group 1 (access mode) values for CMD6 */
+#define SD_ACCESS_MODE_HS	1	/* SDR25 at 1.8V */
+#define SD_ACCESS_MODE_SDR50	2
+#define SD_ACCESS_MODE_SDR104	3
 
 #define OCR_BUSY		0x80000000
 #define OCR_HCS			0x40000000
+#define OCR_S18R		0x01000000	/* S18A in the response */
 #define OCR_VOLTAGE_MASK	0x007FFF80
 #define OCR_ACCESS_MODE		0x60000000
 
@@ -169,6 +196,8 @@
 /*
  * EXT_CSD fields
  */
+#define EXT_CSD_FLUSH_CACHE		32	/* W */
+#define EXT_CSD_CACHE_CTRL		33	/* R/W */
 #define EXT_CSD_ENH_START_ADDR		136	/* R/W */
 #define EXT_CSD_ENH_SIZE_MULT		140	/* R/W */
 #define EXT_CSD_GP_SIZE_MULT		143	/* R/W */
@@ -191,6 +220,7 @@
 #define EXT_CSD_HC_WP_GRP_SIZE		221	/* RO */
 #define EXT_CSD_HC_ERASE_GRP_SIZE	224	/* RO */
 #define EXT_CSD_BOOT_MULT		226	/* RO */
+#define EXT_CSD_CACHE_SIZE		249	/* RO, 4 bytes */
 
 /*
  * EXT_CSD field definitions
@@ -206,6 +236,12 @@
 #define EXT_CSD_CARD_TYPE_DDR_1_2V	(1 << 3)
 #define EXT_CSD_CARD_TYPE_DDR_52	(EXT_CSD_CARD_TYPE_DDR_1_8V \
 					| EXT_CSD_CARD_TYPE_DDR_1_2V)
+#define EXT_CSD_CARD_TYPE_HS200_1_8V	(1 << 4)	/* 200MHz at 1.8V */
+#define EXT_CSD_CARD_TYPE_HS200_1_2V	(1 << 5)	/* 200MHz at 1.2V */
+
+#define EXT_CSD_TIMING_LEGACY	0	/* HS_TIMING values */
+#define EXT_CSD_TIMING_HS	1
+#define EXT_CSD_TIMING_HS200	2
 
 #define EXT_CSD_BUS_WIDTH_1	0	/* Card is in 1 bit mode */
 #define EXT_CSD_BUS_WIDTH_4	1	/* Card is in 4 bit mode */
@@ -329,6 +365,10 @@ struct mmc_ops {
 	int (*init)(struct mmc *mmc);
 	int (*getcd)(struct mmc *mmc);
 	int (*getwp)(struct mmc *mmc);
+	/* Find the sampling point with tuning command @opcode */
+	int (*execute_tuning)(struct mmc *mmc, uint opcode);
+	/* Return 1 while the card holds DAT[3:0] low */
+	int (*card_busy)(struct mmc *mmc);
 };
 
 struct mmc_config {
@@ -381,7 +421,13 @@ struct mmc {
 	char op_cond_pending;	/* 1 if we are waiting on an op_cond command */
 	char init_in_progress;	/* 1 if we have done mmc_start_init() */
 	char preinit;		/* start init as early as possible */
+	char prog_pending;	/* 1 if a write left the card programming */
+	char cache_on;		/* 1 if the eMMC volatile cache is enabled */
+	uint cache_size;	/* eMMC volatile cache in KiB, 0 if none */
 	int ddr_mode;
+	uint timing;		/* MMC_TIMING_* */
+	uint signal_voltage;	/* MMC_SIGNAL_VOLTAGE_* */
+	char clk_disable;	/* 1 to gate the card clock */
 };
 
 struct mmc_hwpart_conf {
@@ -423,7 +469,76 @@ int mmc_getcd(struct mmc *mmc);
 int board_mmc_getcd(struct mmc *mmc);
 int mmc_getwp(struct mmc *mmc);
 int board_mmc_getwp(struct mmc *mmc);
+/**
+ * Move the I/O supply of @mmc to @voltage (MMC_SIGNAL_VOLTAGE_*).
+ *
+ * Called during the UHS-I voltage switch once the card has accepted CMD11,
+ * and again with 3.3V if the switch has to be undone. Boards whose
+ * regulator simply follows the host's VSELECT pin need not provide it.
+ * @return 0 if OK, -ve on error, in which case the card is brought up
+ * again at 3.3V
+ */
+int board_mmc_set_signal_voltage(struct mmc *mmc, uint voltage);
+/**
+ * Switch the card supply of @mmc off and on again.
+ *
+ * Called at the start of every init on a UHS-capable host, and when an
+ * SD card accepted CMD11 but failed the 1.8V switch, as only a power
+ * cycle brings a card back to 3.3V signalling.
+ * @return 0 if OK, -ENOSYS if the board cannot switch the supply
+ */
+int board_mmc_power_cycle(struct mmc *mmc);
 int mmc_set_dsr(struct mmc *mmc, u16 val);
+/**
+ * Read the tuning block with @opcode and check it against the pattern.
+ *
+ * Used by the host driver's execute_tuning() to try a sampling point.
+ *
+ * @return 0 if the block was read correctly, <0 otherwise
+ */
+int mmc_send_tuning(struct mmc *mmc, uint opcode);
+/* Name of the bus mode the card was brought up in, e.g. "HS200" */
+const char *mmc_mode_name(struct mmc *mmc);
+int mmc_wait_prog(struct mmc *mmc);
+/**
+ * Write blocks without waiting for the card to finish programming them.
+ *
+ * The call returns as soon as the data is transferred, so the caller can
+ * prepare the next buffer while the card is busy. The next access through
+ * the MMC layer waits first; use mmc_wait_prog() to wait explicitly and to
+ * see whether programming succeeded.
+ *
+ * @return number of blocks transferred
+ */
+ulong mmc_bwrite_nowait(struct mmc *mmc, lbaint_t start, lbaint_t blkcnt,
+			const void *src);
+/**
+ * Turn the eMMC volatile write cache on or off.
+ *
+ * Meant for bulk writes such as firmware upgrades: with the cache on the
+ * card acknowledges writes before they reach the flash, so the data is
+ * only safe after mmc_flush_cache(). Turning the cache off flushes it.
+ *
+ * @return 0 if OK, -ENOSYS if the card has no cache, other -ve on error
+ */
+int mmc_cache_ctrl(struct mmc *mmc, int enable);
+/* Write back the eMMC volatile cache; nothing to do when it is off */
+int mmc_flush_cache(struct mmc *mmc);
+/**
+ * Copy blocks from one MMC device to another.
+ *
+ * Data is moved in chunks through two DMA buffers. The destination card
+ * programs chunk N while chunk N + 1 is read from the source, and every
+ * chunk is retried on its own if the read or the write fails.
+ *
+ * @param src		Source device
+ * @param dst		Destination device
+ * @param start		First block to copy (same on both devices)
+ * @param blkcnt	Number of blocks to copy
+ * @return number of blocks copied
+ */
+ulong mmc_bcopy(struct mmc *src, struct mmc *dst, lbaint_t start,
+		lbaint_t blkcnt);
 /* Function to change the size of boot partition and rpmb partitions */
 int mmc_boot_partition_size_change(struct mmc *mmc, unsigned long bootsize,
 					unsigned long rpmbsize);
@@ -322,6 +322,7 @@ struct vlan_ethernet_hdr {
 #define PROT_TEST       0x0808
 
 #define IPPROTO_ICMP	 1	/* Internet Control Message Protocol	*/
+#define IPPROTO_TCP	 6	/* Transmission Control Protocol	*/
 #define IPPROTO_UDP	17	/* User Datagram Protocol		*/
 
 /*
@@ -514,7 +515,7 @@ extern int		net_restart_wrap;	/* Tried all network devices */
 
 enum proto_t {
 	BOOTP, RARP, ARP, TFTPGET, DHCP, PING, DNS, NFS, CDP, NETCONS, SNATP,
-	TFTPSRV, TFTPPUT, LINKLOCAL, ETHLOOP
+	TFTPSRV, TFTPPUT, LINKLOCAL, ETHLOOP, HTTPGET
 };
 
 extern char	net_boot_file_name[1024];/* Boot File name */
@@ -649,6 +650,16 @@ static inline void net_send_packet(uchar *pkt, int len)
 int net_send_udp_packet(uchar *ether, struct in_addr dest, int dport,
 			int sport, int payload_len);
 
+/*
+ * Transmit the IP datagram already built in "net_tx_packet", performing
+ * ARP request if needed (ether will be populated)
+ *
+ * @param ether Raw packet buffer
+ * @param dest IP address to send the datagram to
+ * @param len Length of the frame, including the Ethernet header
+ */
+int net_send_ip_packet(uchar *ether, struct in_addr dest, int len);
+
 /* Processes a received packet */
 void net_process_received_packet(uchar *in_packet, int len);
 
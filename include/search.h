@@ -53,6 +53,13 @@ struct hsearch_data {
 	struct _ENTRY *table;
 	unsigned int size;
 	unsigned int filled;
+	/*
+	 * Number of entries created, changed or deleted since the last
+	 * hclean_r(), and how many of those were deletions. Setting an
+	 * entry to the value it already has does not count.
+	 */
+	unsigned int changed;
+	unsigned int deleted;
 /*
  * Callback function which will check whether the given change for variable
  * "item" to "newval" may be applied or not, and possibly apply such change.
@@ -108,6 +115,9 @@ extern int himport_r(struct hsearch_data *__htab,
 /* Walk the whole table calling the callback on each element */
 extern int hwalk_r(struct hsearch_data *__htab, int (*callback)(ENTRY *));
 
+/* Forget all changes, e.g. after the table was written to storage */
+extern void hclean_r(struct hsearch_data *__htab);
+
 /* Flags for himport_r(), hexport_r(), hdelete_r(), and hsearch_r() */
 #define H_NOCLEAR	(1 << 0) /* do not clear hash table before importing */
 #define H_FORCE		(1 << 1) /* overwrite read-only/write-once variables */
@@ -122,5 +132,6 @@ extern int hwalk_r(struct hsearch_data *__htab, int (*callback)(ENTRY *));
 #define H_MATCH_METHOD	(H_MATCH_IDENT | H_MATCH_SUBSTR | H_MATCH_REGEX)
 #define H_PROGRAMMATIC	(1 << 9) /* indicate that an import is from setenv() */
 #define H_ORIGIN_FLAGS	(H_INTERACTIVE | H_PROGRAMMATIC)
+#define H_CHANGED	(1 << 10) /* export only entries changed since hclean_r() */
 
 #endif /* search.h */
@@ -283,6 +283,14 @@ int  spi_xfer(struct spi_slave *slave, unsigned int bitlen, const void *dout,
 int  mxc_spi_xfer(struct spi_slave *slave, unsigned int bitlen, const void *dout,
 		void *din, unsigned long flags);
 
+/**
+ * Print the bits moved by mxc_spi_xfer(), the time it took and the
+ * resulting bus utilisation at the programmed SCK.
+ *
+ * @slave:	The SPI slave
+ */
+void mxc_spi_print_stats(struct spi_slave *slave);
+
 /* Copy memory mapped data */
 void spi_flash_copy_mmap(void *data, void *offset, size_t len);
 
@@ -156,6 +156,7 @@ struct usb_device {
 };
 
 struct int_queue;
+struct bulk_queue;
 
 /*
  * You can initialize platform's USB host or device
@@ -194,6 +195,23 @@ int destroy_int_queue(struct usb_device *dev, struct int_queue *queue);
 void *poll_int_queue(struct usb_device *dev, struct int_queue *queue);
 #endif
 
+#if defined(CONFIG_USB_EHCI_BULK_QUEUE) && !defined(CONFIG_DM_USB)
+/*
+ * Bulk queues keep a bulk endpoint on the schedule and let several
+ * transfers be queued on it; 'maxlen' is the most bytes pending at once.
+ * wait_bulk_queue() completes the transfers in submission order and sets
+ * dev->status and dev->act_len like submit_bulk_msg(). A queue stops at
+ * the first error and has to be destroyed then.
+ */
+struct bulk_queue *create_bulk_queue(struct usb_device *dev,
+				     unsigned long pipe, int maxlen);
+int submit_bulk_queue(struct usb_device *dev, struct bulk_queue *queue,
+		      void *buffer, int length);
+int wait_bulk_queue(struct usb_device *dev, struct bulk_queue *queue,
+		    int *actlen);
+int destroy_bulk_queue(struct usb_device *dev, struct bulk_queue *queue);
+#endif
+
 /* Defines */
 #define USB_UHCI_VEND_ID	0x8086
 #define USB_UHCI_DEV_ID		0x7112
@@ -279,6 +297,8 @@ int usb_clear_halt(struct usb_device *dev, int pipe);
 int usb_string(struct usb_device *dev, int index, char *buf, size_t size);
 int usb_set_interface(struct usb_device *dev, int interface, int alternate);
 int usb_get_port_status(struct usb_device *dev, int port, void *data);
+/* Enumerate whatever is now connected to @port (0-based) of hub @dev */
+int usb_hub_port_connect_change(struct usb_device *dev, int port);
 
 /* big endian -> little endian conversion */
 /* some CPUs are already little endian e.g. the ARM920T */
@@ -11,8 +11,10 @@
 #include <console.h>
 #include <image.h>
 #include <malloc.h>
+#include <memalign.h>
 #include <u-boot/zlib.h>
 #include <div64.h>
+#include <asm/unaligned.h>
 
 #define HEADER0			'\x1f'
 #define HEADER1			'\x8b'
@@ -260,6 +262,224 @@ out:
 	return r;
 }
 
+/*
+ * Incremental gunzip. Unlike gzwrite() the compressed image never has to
+ * be in memory as a whole: input is pushed in pieces of any size and the
+ * inflated data is handed to the output callback one window at a time.
+ */
+enum gzstream_state {
+	GZS_FIXED,		/* 10 byte fixed header */
+	GZS_XLEN,		/* length of the extra field */
+	GZS_SKIP,		/* extra field or header crc */
+	GZS_STRING,		/* original name or comment */
+	GZS_DATA,		/* deflate stream */
+	GZS_TRAILER,		/* crc32 and size */
+	GZS_DONE,
+};
+
+struct gzstream {
+	z_stream s;
+	enum gzstream_state state;
+	int flags;		/* header fields not parsed yet */
+	unsigned char hdr[10];
+	unsigned int hlen;
+	unsigned int skip;
+	unsigned char *window;
+	unsigned long szwindow;
+	u32 crc;
+	u64 total;
+	int (*out)(void *priv, const void *buf, unsigned long len);
+	void *priv;
+};
+
+static void gzstream_next_field(struct gzstream *z)
+{
+	z->hlen = 0;
+
+	if (z->flags & EXTRA_FIELD) {
+		z->flags &= ~EXTRA_FIELD;
+		z->state = GZS_XLEN;
+	} else if (z->flags & ORIG_NAME) {
+		z->flags &= ~ORIG_NAME;
+		z->state = GZS_STRING;
+	} else if (z->flags & COMMENT) {
+		z->flags &= ~COMMENT;
+		z->state = GZS_STRING;
+	} else if (z->flags & HEAD_CRC) {
+		z->flags &= ~HEAD_CRC;
+		z->skip = 2;
+		z->state = GZS_SKIP;
+	} else {
+		z->state = GZS_DATA;
+	}
+}
+
+/* Consume one header or trailer byte */
+static int gzstream_header_byte(struct gzstream *z, unsigned char c)
+{
+	switch (z->state) {
+	case GZS_FIXED:
+		z->hdr[z->hlen++] = c;
+		if (z->hlen < sizeof(z->hdr))
+			break;
+		if (z->hdr[0] != (u8)HEADER0 || z->hdr[1] != (u8)HEADER1 ||
+		    z->hdr[2] != DEFLATED || (z->hdr[3] & RESERVED) != 0) {
+			puts("Error: Bad gzipped data\n");
+			return -1;
+		}
+		z->flags = z->hdr[3];
+		gzstream_next_field(z);
+		break;
+	case GZS_XLEN:
+		z->hdr[z->hlen++] = c;
+		if (z->hlen < 2)
+			break;
+		z->skip = z->hdr[0] + (z->hdr[1] << 8);
+		z->state = GZS_SKIP;
+		if (!z->skip)
+			gzstream_next_field(z);
+		break;
+	case GZS_SKIP:
+		if (!--z->skip)
+			gzstream_next_field(z);
+		break;
+	case GZS_STRING:
+		if (!c)
+			gzstream_next_field(z);
+		break;
+	case GZS_TRAILER:
+		z->hdr[z->hlen++] = c;
+		if (z->hlen < 8)
+			break;
+		if (get_unaligned_le32(z->hdr) != z->crc ||
+		    get_unaligned_le32(z->hdr + 4) != (u32)z->total) {
+			printf("Error: gunzip crc/size mismatch\n");
+			return -1;
+		}
+		z->state = GZS_DONE;
+		break;
+	default:
+		/* Trailing garbage after the trailer is ignored */
+		break;
+	}
+
+	return 0;
+}
+
+static int gzstream_emit(struct gzstream *z)
+{
+	unsigned long n = z->szwindow - z->s.avail_out;
+
+	z->s.next_out = z->window;
+	z->s.avail_out = z->szwindow;
+
+	if (!n)
+		return 0;
+
+	z->crc = crc32(z->crc, z->window, n);
+	z->total += n;
+	WATCHDOG_RESET();
+
+	return z->out(z->priv, z->window, n);
+}
+
+struct gzstream *gzstream_open(unsigned long szwindow,
+			       int (*out)(void *priv, const void *buf,
+					  unsigned long len),
+			       void *priv)
+{
+	struct gzstream *z;
+
+	z = calloc(1, sizeof(*z));
+	if (!z)
+		return NULL;
+
+	z->window = malloc_cache_aligned(szwindow);
+	if (!z->window) {
+		free(z);
+		return NULL;
+	}
+
+	z->s.zalloc = gzalloc;
+	z->s.zfree = gzfree;
+	if (inflateInit2(&z->s, -MAX_WBITS) != Z_OK) {
+		free(z->window);
+		free(z);
+		return NULL;
+	}
+
+	z->szwindow = szwindow;
+	z->s.next_out = z->window;
+	z->s.avail_out = szwindow;
+	z->out = out;
+	z->priv = priv;
+	z->state = GZS_FIXED;
+
+	return z;
+}
+
+int gzstream_write(struct gzstream *z, const void *buf, unsigned long len)
+{
+	const unsigned char *src = buf;
+	int full, r;
+
+	while (len) {
+		if (z->state != GZS_DATA) {
+			if (gzstream_header_byte(z, *src++))
+				return -1;
+			len--;
+			continue;
+		}
+
+		z->s.next_in = (unsigned char *)src;
+		z->s.avail_in = len;
+
+		/* A full window may leave output pending without input left */
+		do {
+			r = inflate(&z->s, Z_NO_FLUSH);
+			if (r != Z_OK && r != Z_STREAM_END && r != Z_BUF_ERROR) {
+				printf("Error: inflate() returned %d\n", r);
+				return -1;
+			}
+			full = !z->s.avail_out;
+			if ((full || r == Z_STREAM_END) && gzstream_emit(z))
+				return -1;
+			if (r == Z_STREAM_END) {
+				z->state = GZS_TRAILER;
+				z->hlen = 0;
+				break;
+			}
+		} while ((z->s.avail_in || full) && r != Z_BUF_ERROR);
+
+		src = z->s.next_in;
+		len = z->s.avail_in;
+
+		if (r == Z_BUF_ERROR && len) {
+			printf("Error: inflate() made no progress\n");
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+int gzstream_close(struct gzstream *z)
+{
+	int ret = 0;
+
+	if (z->state != GZS_DONE) {
+		printf("Error: gzip stream truncated at %llu bytes\n",
+		       z->total);
+		ret = -1;
+	}
+
+	inflateEnd(&z->s);
+	free(z->window);
+	free(z);
+
+	return ret;
+}
+
 /*
  * Uncompress blocks compressed with zlib without headers
  */
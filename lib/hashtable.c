@@ -59,6 +59,7 @@
 
 typedef struct _ENTRY {
 	int used;
+	int changed;		/* created or changed since hclean_r() */
 	ENTRY entry;
 } _ENTRY;
 
@@ -157,6 +158,12 @@ void hdestroy_r(struct hsearch_data *htab)
 	}
 	free(htab->table);
 
+	/* Whatever gets imported next replaces all of the old entries */
+	if (htab->filled) {
+		htab->changed++;
+		htab->deleted++;
+	}
+
 	/* the sign for an existing table is an value != NULL in htable */
 	htab->table = NULL;
 }
@@ -252,6 +259,11 @@ static inline int _compare_and_overwrite_entry(ENTRY item, ACTION action,
 				return 0;
 			}
 
+			if (strcmp(item.data, htab->table[idx].entry.data)) {
+				htab->table[idx].changed = 1;
+				htab->changed++;
+			}
+
 			free(htab->table[idx].entry.data);
 			htab->table[idx].entry.data = strdup(item.data);
 			if (!htab->table[idx].entry.data) {
@@ -404,6 +416,9 @@ int hsearch_r(ENTRY item, ACTION action, ENTRY ** retval,
 			return 0;
 		}
 
+		htab->table[idx].changed = 1;
+		htab->changed++;
+
 		/* return new entry */
 		*retval = &htab->table[idx].entry;
 		return 1;
@@ -474,6 +489,9 @@ int hdelete_r(const char *key, struct hsearch_data *htab, int flag)
 
 	_hdelete(key, htab, ep, idx);
 
+	htab->changed++;
+	htab->deleted++;
+
 	return 1;
 }
 
@@ -621,6 +639,9 @@ ssize_t hexport_r(struct hsearch_data *htab, const char sep, int flag,
 			if ((flag & H_HIDE_DOT) && ep->key[0] == '.')
 				continue;
 
+			if ((flag & H_CHANGED) && !htab->table[i].changed)
+				continue;
+
 			list[n++] = ep;
 
 			totlen += strlen(ep->key) + 2;
@@ -979,3 +1000,24 @@ int hwalk_r(struct hsearch_data *htab, int (*callback)(ENTRY *))
 
 	return 0;
 }
+
+/*
+ * hclean_r()
+ */
+
+/*
+ * Forget which entries were created, changed or deleted, typically once
+ * the table has been written to or read from persistent storage.
+ */
+void hclean_r(struct hsearch_data *htab)
+{
+	int i;
+
+	if (htab->table) {
+		for (i = 1; i <= htab->size; ++i)
+			htab->table[i].changed = 0;
+	}
+
+	htab->changed = 0;
+	htab->deleted = 0;
+}
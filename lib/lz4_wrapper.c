@@ -6,8 +6,11 @@
 
 #include <common.h>
 #include <compiler.h>
+#include <malloc.h>
+#include <memalign.h>
 #include <linux/kernel.h>
 #include <linux/types.h>
+#include <asm/unaligned.h>
 
 static u16 LZ4_readLE16(const void *src) { return le16_to_cpu(*(u16 *)src); }
 static void LZ4_copy4(void *dst, const void *src) { *(u32 *)dst = *(u32 *)src; }
@@ -137,3 +140,217 @@ int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn)
 	*dstn = out - dst;
 	return ret;
 }
+
+/*
+ * Incremental LZ4 frame decoder. Input is pushed in pieces of any size;
+ * each block is decoded as soon as it is complete and handed to the
+ * output callback, so only one compressed and one decoded block have to
+ * be held in memory. Like ulz4fn() only independent blocks are supported.
+ */
+enum ulz4stream_state {
+	ULZ4S_FRAME,		/* frame header */
+	ULZ4S_BLOCK,		/* block header */
+	ULZ4S_DATA,		/* block data */
+	ULZ4S_DONE,
+};
+
+struct ulz4stream {
+	enum ulz4stream_state state;
+	u8 hdr[sizeof(struct lz4_frame_header) + sizeof(u64) + sizeof(u8)];
+	size_t hlen;		/* bytes collected in hdr or inbuf */
+	size_t want;		/* bytes needed to complete the state */
+	size_t skip;
+	int has_block_checksum;
+	int has_content_checksum;
+	struct lz4_block_header b;
+	size_t max_block;
+	u8 *inbuf;
+	u8 *outbuf;
+	u64 total;
+	int (*out)(void *priv, const void *buf, unsigned long len);
+	void *priv;
+};
+
+static int ulz4stream_frame(struct ulz4stream *z)
+{
+	const struct lz4_frame_header *h = (void *)z->hdr;
+
+	if (z->hlen == sizeof(*h)) {
+		if (le32_to_cpu(h->magic) != LZ4F_MAGIC || h->version != 1)
+			return -EPROTONOSUPPORT;
+		if (h->reserved0 || h->reserved1 || h->reserved2)
+			return -EINVAL;
+		if (!h->independent_blocks)
+			return -EPROTONOSUPPORT;
+		if (h->max_block_size < 4)
+			return -EINVAL;
+
+		/* Rest of the header: optional content size and checksum */
+		z->want = sizeof(*h) + sizeof(u8);
+		if (h->has_content_size)
+			z->want += sizeof(u64);
+		return 0;
+	}
+
+	z->has_block_checksum = h->has_block_checksum;
+	z->has_content_checksum = h->has_content_checksum;
+	z->max_block = 1 << (8 + 2 * h->max_block_size);
+	z->inbuf = malloc_cache_aligned(z->max_block);
+	z->outbuf = malloc_cache_aligned(z->max_block);
+	if (!z->inbuf || !z->outbuf)
+		return -ENOMEM;
+
+	z->state = ULZ4S_BLOCK;
+	z->want = sizeof(struct lz4_block_header);
+	z->hlen = 0;
+
+	return 0;
+}
+
+static int ulz4stream_block(struct ulz4stream *z, const u8 *in)
+{
+	int ret;
+
+	if (z->b.not_compressed) {
+		ret = z->out(z->priv, in, z->b.size);
+		z->total += z->b.size;
+	} else {
+		/* constant folding essential, do not touch params! */
+		ret = LZ4_decompress_generic((const void *)in,
+				(void *)z->outbuf, z->b.size,
+				z->max_block, endOnInputSize,
+				full, 0, noDict, z->outbuf, NULL, 0);
+		if (ret < 0)
+			return -EPROTO;
+		z->total += ret;
+		ret = z->out(z->priv, z->outbuf, ret);
+	}
+	if (ret)
+		return ret;
+
+	z->skip = z->has_block_checksum ? sizeof(u32) : 0;
+	z->state = ULZ4S_BLOCK;
+	z->want = sizeof(struct lz4_block_header);
+	z->hlen = 0;
+
+	return 0;
+}
+
+struct ulz4stream *ulz4stream_open(int (*out)(void *priv, const void *buf,
+					       unsigned long len),
+				   void *priv)
+{
+	struct ulz4stream *z;
+
+	z = calloc(1, sizeof(*z));
+	if (!z)
+		return NULL;
+
+	z->state = ULZ4S_FRAME;
+	z->want = sizeof(struct lz4_frame_header);
+	z->out = out;
+	z->priv = priv;
+
+	return z;
+}
+
+int ulz4stream_write(struct ulz4stream *z, const void *buf, unsigned long len)
+{
+	const u8 *in = buf;
+	size_t n;
+	int ret;
+
+	while (len) {
+		if (z->skip) {
+			n = min_t(size_t, len, z->skip);
+			z->skip -= n;
+			in += n;
+			len -= n;
+			continue;
+		}
+
+		switch (z->state) {
+		case ULZ4S_FRAME:
+		case ULZ4S_BLOCK:
+			n = min_t(size_t, len, z->want - z->hlen);
+			memcpy(z->hdr + z->hlen, in, n);
+			z->hlen += n;
+			in += n;
+			len -= n;
+			if (z->hlen < z->want)
+				break;
+
+			if (z->state == ULZ4S_FRAME) {
+				ret = ulz4stream_frame(z);
+				if (ret)
+					goto err;
+				break;
+			}
+
+			z->b.raw = get_unaligned_le32(z->hdr);
+			z->hlen = 0;
+			if (!z->b.size) {
+				/* EndMark */
+				z->skip = z->has_content_checksum ?
+					  sizeof(u32) : 0;
+				z->state = ULZ4S_DONE;
+			} else if (z->b.size > z->max_block) {
+				ret = -EINVAL;
+				goto err;
+			} else {
+				z->state = ULZ4S_DATA;
+				z->want = z->b.size;
+			}
+			break;
+
+		case ULZ4S_DATA:
+			/* Decode straight from the input if it holds the block */
+			if (!z->hlen && len >= z->want) {
+				ret = ulz4stream_block(z, in);
+				if (ret)
+					goto err;
+				in += z->b.size;
+				len -= z->b.size;
+				break;
+			}
+
+			n = min_t(size_t, len, z->want - z->hlen);
+			memcpy(z->inbuf + z->hlen, in, n);
+			z->hlen += n;
+			in += n;
+			len -= n;
+			if (z->hlen == z->want) {
+				ret = ulz4stream_block(z, z->inbuf);
+				if (ret)
+					goto err;
+			}
+			break;
+
+		default:
+			/* Anything after the frame is ignored */
+			return 0;
+		}
+	}
+
+	return 0;
+
+err:
+	printf("Error: LZ4 stream failed at %llu bytes (%d)\n", z->total, ret);
+	return ret;
+}
+
+int ulz4stream_close(struct ulz4stream *z)
+{
+	int ret = 0;
+
+	if (z->state != ULZ4S_DONE || z->skip) {
+		printf("Error: LZ4 stream truncated at %llu bytes\n", z->total);
+		ret = -EINVAL;
+	}
+
+	free(z->inbuf);
+	free(z->outbuf);
+	free(z);
+
+	return ret;
+}
@@ -12,6 +12,7 @@
 #include <common.h>
 
 #include "arp.h"
+#include "dual.h"
 
 #ifndef	CONFIG_ARP_TIMEOUT
 /* Milliseconds before trying ARP again */
@@ -34,9 +35,16 @@ uchar	       *arp_wait_packet_ethaddr;
 int		arp_wait_tx_packet_size;
 ulong		arp_wait_timer_start;
 int		arp_wait_try;
+/*
+ * The waiting packet is kept aside: other connections go on using
+ * net_tx_packet while the reply is outstanding.
+ */
+uchar	       *arp_wait_tx_packet;
+int		arp_wait_port;
 
 static uchar   *arp_tx_packet;	/* THE ARP transmit packet */
 static uchar	arp_tx_packet_buf[PKTSIZE_ALIGN + PKTALIGN];
+static uchar	arp_wait_tx_packet_buf[PKTSIZE_ALIGN + PKTALIGN];
 
 void arp_init(void)
 {
@@ -47,6 +55,8 @@ void arp_init(void)
 	arp_wait_tx_packet_size = 0;
 	arp_tx_packet = &arp_tx_packet_buf[0] + (PKTALIGN - 1);
 	arp_tx_packet -= (ulong)arp_tx_packet % PKTALIGN;
+	arp_wait_tx_packet = &arp_wait_tx_packet_buf[0] + (PKTALIGN - 1);
+	arp_wait_tx_packet -= (ulong)arp_wait_tx_packet % PKTALIGN;
 }
 
 void arp_raw_request(struct in_addr source_ip, const uchar *target_ethaddr,
@@ -110,15 +120,26 @@ int arp_timeout_check(void)
 		arp_wait_try++;
 
 		if (arp_wait_try >= ARP_TIMEOUT_COUNT) {
-			puts("\nARP Retry count exceeded; starting again\n");
 			arp_wait_try = 0;
+			if (arp_wait_port) {
+				/* The protocol on the second port copes */
+				net_arp_wait_packet_ip.s_addr = 0;
+				return 0;
+			}
+			puts("\nARP Retry count exceeded; starting again\n");
 			net_set_state(NETLOOP_FAIL);
 		} else {
+			int prev_port = net_port;
+
 			arp_wait_timer_start = t;
+			net_port_select(arp_wait_port);
 			arp_request();
+			net_port_select(prev_port);
 		}
 	}
-	return 1;
+
+	/* Only a wait on the primary port holds off the protocol timeout */
+	return !arp_wait_port;
 }
 
 void arp_receive(struct ethernet_hdr *et, struct ip_udp_hdr *ip, int len)
@@ -219,9 +240,10 @@ void arp_receive(struct ethernet_hdr *et, struct ip_udp_hdr *ip, int len)
 
 			/* set the mac address in the waiting packet's header
 			   and transmit it */
-			memcpy(((struct ethernet_hdr *)net_tx_packet)->et_dest,
+			memcpy(((struct ethernet_hdr *)arp_wait_tx_packet)->et_dest,
 			       &arp->ar_sha, ARP_HLEN);
-			net_send_packet(net_tx_packet, arp_wait_tx_packet_size);
+			net_send_packet(arp_wait_tx_packet,
+					arp_wait_tx_packet_size);
 
 			/* no arp request pending now */
 			net_arp_wait_packet_ip.s_addr = 0;
@@ -18,6 +18,9 @@ extern struct in_addr net_arp_wait_packet_ip;
 /* MAC address of waiting packet's destination */
 extern uchar *arp_wait_packet_ethaddr;
 extern int arp_wait_tx_packet_size;
+/* Copy of the waiting packet and the port (see dual.h) it leaves on */
+extern uchar *arp_wait_tx_packet;
+extern int arp_wait_port;
 extern ulong arp_wait_timer_start;
 extern int arp_wait_try;
 
@@ -0,0 +1,111 @@
+/*
+ * Second Ethernet port for parallel fetches
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+/*
+ * net_loop() drives one device (eth_current) with one set of addresses
+ * (net_ip, net_ethaddr). To use a second device in the same loop, its
+ * context is swapped into those globals around every eth_rx() and every
+ * transmission for it, so ARP replies, the IP destination check and
+ * header construction work for that port unchanged.
+ *
+ * Port 0 is ethact. Port 1 is the next registered device; it needs its
+ * own address in eth<index>ipaddr (e.g. eth1ipaddr), netmask and
+ * gatewayip are shared.
+ */
+
+#include <common.h>
+#include <errno.h>
+#include <net.h>
+#include "dual.h"
+
+DECLARE_GLOBAL_DATA_PTR;
+
+struct net_port_ctx {
+	struct eth_device *dev;
+	struct in_addr ip;
+	uchar ethaddr[6];
+};
+
+static struct net_port_ctx net_ports[2];
+int net_port;
+int net_dual_active;
+
+void net_port_select(int port)
+{
+	struct net_port_ctx *p;
+
+	if (port == net_port)
+		return;
+
+	p = &net_ports[net_port];
+	p->dev = eth_current;
+	p->ip = net_ip;
+	memcpy(p->ethaddr, net_ethaddr, 6);
+
+	p = &net_ports[port];
+	eth_current = p->dev;
+	net_ip = p->ip;
+	memcpy(net_ethaddr, p->ethaddr, 6);
+
+	net_port = port;
+}
+
+int net_dual_start(void)
+{
+	struct net_port_ctx *p = &net_ports[1];
+	struct eth_device *dev = eth_get_dev();
+	char name[16];
+
+	if (!dev)
+		return -ENODEV;
+
+	if (net_dual_active)
+		return 0;
+
+	if (dev->next == dev)
+		return -ENODEV;
+	dev = dev->next;
+
+	sprintf(name, "eth%dipaddr", dev->index);
+	p->ip = getenv_ip(name);
+	if (!p->ip.s_addr || p->ip.s_addr == net_ip.s_addr)
+		return -EINVAL;
+
+	if (dev->init(dev, gd->bd) < 0) {
+		printf("%s: not usable as second port\n", dev->name);
+		return -EIO;
+	}
+	dev->state = ETH_STATE_ACTIVE;
+
+	p->dev = dev;
+	memcpy(p->ethaddr, dev->enetaddr, 6);
+	net_dual_active = 1;
+
+	printf("Using %s device as second port; its IP address is %pI4\n",
+	       dev->name, &p->ip);
+
+	return 0;
+}
+
+void net_dual_stop(void)
+{
+	struct eth_device *dev = net_ports[1].dev;
+
+	if (!net_dual_active)
+		return;
+
+	net_port_select(0);
+	dev->halt(dev);
+	dev->state = ETH_STATE_PASSIVE;
+	net_dual_active = 0;
+}
+
+void net_dual_rx(void)
+{
+	net_port_select(1);
+	eth_rx();
+	net_port_select(0);
+}
@@ -0,0 +1,34 @@
+/*
+ * Second Ethernet port for parallel fetches
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef __DUAL_H__
+#define __DUAL_H__
+
+#include <errno.h>
+
+#ifdef CONFIG_NET_DUAL_FETCH
+/* Port whose device and addresses are selected: 0 is ethact */
+extern int net_port;
+/* Port 1 is up and polled by net_loop() */
+extern int net_dual_active;
+
+/* Bring up port 1 next to ethact; 0 on success */
+int net_dual_start(void);
+void net_dual_stop(void);
+/* Swap the device, net_ip and net_ethaddr of @port in */
+void net_port_select(int port);
+/* Receive on port 1; called from net_loop() */
+void net_dual_rx(void);
+#else
+#define net_port		0
+#define net_dual_active		0
+static inline int net_dual_start(void) { return -ENOSYS; }
+static inline void net_dual_stop(void) {}
+static inline void net_port_select(int port) {}
+static inline void net_dual_rx(void) {}
+#endif
+
+#endif /* __DUAL_H__ */
@@ -0,0 +1,578 @@
+/*
+ * Plain HTTP/1.0 GET client on top of net/tcp.c
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+/*
+ * The body is fetched by one or two transfers. The first is a plain
+ * GET on port 0. With CONFIG_NET_DUAL_FETCH and a second port up, a
+ * second transfer asks for the upper part of a large body with an
+ * open-ended "Range: bytes=N-" on port 1; once the server confirms with
+ * 206 the first transfer stops at N and resets its connection.
+ *
+ * Each transfer owns [from, end) of the body. Since every request runs
+ * to the end of the file, a transfer that dies can be taken over by one
+ * that is still running just by moving its end, or else re-requested
+ * from where it stopped on a port that still works.
+ *
+ * A firmware upgrade consumes the body strictly in order: data at the
+ * stream position goes straight to the upgrade stream, data beyond it
+ * waits at its place at the load address until the gap is filled.
+ */
+
+#include <common.h>
+#include <command.h>
+#include <div64.h>
+#include <mapmem.h>
+#include <net.h>
+#include <linux/sizes.h>
+#include "dual.h"
+#include "http.h"
+#include "tcp.h"
+#include "../common/moxa_bios/moxa_upgrade.h"
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/* Largest response header we are prepared to parse */
+#define HTTP_HDR_MAX		1024
+/* Bytes of body per "loading" hash */
+#define HTTP_HASH_SIZE		(64 * 1024)
+/* Number of "loading" hashes per line */
+#define HASHES_PER_LINE		65
+/* Smaller bodies are not worth a second connection */
+#define HTTP_DUAL_MIN		SZ_1M
+
+extern int tftp_upgrade_start;
+
+enum {
+	HTTP_XFER_IDLE,
+	HTTP_XFER_ACTIVE,
+	HTTP_XFER_DONE,
+};
+
+struct http_xfer {
+	int state;
+	struct tcp_conn *conn;
+	/* Ethernet port, see dual.h */
+	int port;
+	/* Asked for "bytes=from-" rather than the whole body */
+	int ranged;
+
+	/* Response header as received so far */
+	char hdr[HTTP_HDR_MAX + 1];
+	unsigned hdr_len;
+	int in_body;
+
+	/* Body bytes [from, end) are ours; offset is the next one to come */
+	u64 from;
+	u64 offset;
+	u64 end;
+};
+
+static struct in_addr http_server_ip;
+static int http_server_port;
+static char http_path[1024];
+
+static struct http_xfer http_xfers[2];
+/* Content-Length of the body, or -1 if the server did not send one */
+static long long http_content_length;
+/* The server answered a range request with 206 */
+static int http_range_ok;
+/* Ports that lost a transfer are not used again */
+static int http_port_failed[2];
+/* Next body byte for the firmware upgrade stream */
+static u64 http_stream_pos;
+/* Body bytes stored so far, by all transfers */
+static u64 http_received;
+static ulong http_num_hash;
+static int http_done;
+static ulong time_start;
+
+static void http_handler(void *priv, enum tcp_event event, const uchar *data,
+			 unsigned len);
+
+static void http_fail(const char *msg)
+{
+	int i;
+
+	if (msg)
+		printf("\n%s\n", msg);
+	http_done = 1;
+	for (i = 0; i < ARRAY_SIZE(http_xfers); i++)
+		if (http_xfers[i].state == HTTP_XFER_ACTIVE)
+			tcp_abort(http_xfers[i].conn);
+	net_set_state(NETLOOP_FAIL);
+}
+
+static void http_complete(void)
+{
+	ulong ms = get_timer(time_start);
+
+	/* All of it must have gone to the upgrade stream, in order */
+	if (tftp_upgrade_start && http_stream_pos != http_received) {
+		http_fail("Firmware stream incomplete");
+		return;
+	}
+
+	http_done = 1;
+	if (ms > 0) {
+		puts("\n\t ");	/* Line up with "Loading: " */
+		print_size(lldiv(http_received, ms) * 1000, "/s");
+		printf(", %lu out-of-order segments", tcp_ooo_segs);
+	}
+	puts("\ndone\n");
+	net_set_state(NETLOOP_SUCCESS);
+}
+
+/* Done once no transfer is running any more */
+static void http_check_done(void)
+{
+	int i;
+
+	if (http_done)
+		return;
+	for (i = 0; i < ARRAY_SIZE(http_xfers); i++)
+		if (http_xfers[i].state == HTTP_XFER_ACTIVE)
+			return;
+
+	if (http_content_length >= 0 &&
+	    http_received < (u64)http_content_length)
+		http_fail("Body incomplete");
+	else
+		http_complete();
+}
+
+/*
+ * Request the body from @start on; what the transfer stored from @from
+ * up to @start earlier stays its own.
+ */
+static int http_xfer_start(struct http_xfer *x, int port, u64 from,
+			   u64 start, int ranged, u64 end)
+{
+	memset(x, 0, sizeof(*x));
+	x->port = port;
+	x->ranged = ranged;
+	x->from = from;
+	x->offset = start;
+	x->end = end;
+
+	x->conn = tcp_connect(port, http_server_ip, http_server_port,
+			      http_handler, x);
+	if (!x->conn)
+		return -1;
+	x->state = HTTP_XFER_ACTIVE;
+
+	return 0;
+}
+
+/* The transfer has everything it owns */
+static void http_xfer_end(struct http_xfer *x)
+{
+	x->state = HTTP_XFER_DONE;
+	/* Stop the server short of the end of the file */
+	if (http_content_length >= 0 && x->end < (u64)http_content_length)
+		tcp_abort(x->conn);
+	else
+		tcp_close(x->conn);
+	http_check_done();
+}
+
+/* Hand what is left of a transfer that stopped to someone else */
+static void http_xfer_drop(struct http_xfer *x)
+{
+	struct http_xfer *other = &http_xfers[x == http_xfers];
+	u64 rem = max(x->offset, x->from);
+	int port;
+
+	x->state = HTTP_XFER_DONE;
+	if (rem >= x->end) {
+		http_check_done();
+		return;
+	}
+
+	/* A running transfer goes on to the end of the file anyway */
+	if (other->state == HTTP_XFER_ACTIVE && other->from <= rem &&
+	    other->end >= rem) {
+		other->end = max(other->end, x->end);
+		return;
+	}
+
+	if (!http_range_ok) {
+		http_fail("No way to fetch the rest");
+		return;
+	}
+	for (port = 0; port < ARRAY_SIZE(http_port_failed); port++)
+		if (!http_port_failed[port] && (port == 0 || net_dual_active))
+			break;
+	if (port == ARRAY_SIZE(http_port_failed) ||
+	    http_xfer_start(x, port, x->from, rem, 1, x->end))
+		http_fail("No way to fetch the rest");
+}
+
+/* A transfer went wrong: its port is not used again */
+static void http_xfer_failed(struct http_xfer *x, const char *msg)
+{
+	x->state = HTTP_XFER_DONE;
+	if (http_content_length < 0 || (!x->ranged && !x->in_body)) {
+		http_fail(msg);
+		return;
+	}
+	printf("\nPort %d: %s\n\t ", x->port, msg);
+	http_port_failed[x->port] = 1;
+
+	http_xfer_drop(x);
+}
+
+static void http_send_request(struct http_xfer *x)
+{
+	char req[TCP_MSS];
+	char range[32] = "";
+	int len;
+
+	if (x->ranged)
+		sprintf(range, "Range: bytes=%llu-\r\n", x->offset);
+
+	/* HTTP/1.0 keeps the body unchunked and the server closes after it */
+	len = snprintf(req, sizeof(req),
+		       "GET %s HTTP/1.0\r\n"
+		       "Host: %pI4:%d\r\n"
+		       "User-Agent: U-Boot\r\n"
+		       "%s"
+		       "Connection: close\r\n"
+		       "\r\n",
+		       http_path, &http_server_ip, http_server_port, range);
+	if (len >= (int)sizeof(req)) {
+		http_fail("HTTP request too long");
+		return;
+	}
+
+	tcp_send(x->conn, req, len);
+}
+
+/* Value of header field @name, or NULL */
+static const char *http_header_field(struct http_xfer *x, const char *name)
+{
+	int n = strlen(name);
+	char *p, *q;
+
+	for (p = strstr(x->hdr, "\r\n"); p; p = strstr(p + 2, "\r\n")) {
+		if (strncasecmp(p + 2, name, n))
+			continue;
+		for (q = p + 2 + n; *q == ' ' || *q == '\t'; q++)
+			;
+		return q;
+	}
+
+	return NULL;
+}
+
+/* Start fetching the upper part of the body on the second port */
+static void http_start_split(void)
+{
+	u64 len = http_content_length;
+	u64 half;
+
+	if (!net_dual_active || len < HTTP_DUAL_MIN)
+		return;
+	/* The upgrade stream needs room to park the upper part */
+	if (tftp_upgrade_start &&
+	    load_addr + len > gd->start_addr_sp - SZ_1M)
+		return;
+
+	half = roundup(len / 2, HTTP_HASH_SIZE);
+	http_xfer_start(&http_xfers[1], 1, half, half, 1, len);
+}
+
+/* A range request was granted: take the part over from the other one */
+static void http_take_over(struct http_xfer *x)
+{
+	struct http_xfer *other = &http_xfers[x == http_xfers];
+
+	http_range_ok = 1;
+	if (other->state != HTTP_XFER_ACTIVE || other->from >= x->from ||
+	    other->end <= x->from)
+		return;
+
+	/* What the other one already has is not fetched twice */
+	other->end = max(x->from, other->offset);
+	x->from = other->end;
+	if (other->offset >= other->end)
+		http_xfer_end(other);
+}
+
+/* Check the status line and pick up Content-Length */
+static int http_check_header(struct http_xfer *x)
+{
+	char *p = strchr(x->hdr, ' ');
+	const char *q;
+	int status = p ? simple_strtoul(p + 1, NULL, 10) : 0;
+
+	if (strncmp(x->hdr, "HTTP/", 5) || status != (x->ranged ? 206 : 200)) {
+		tcp_abort(x->conn);
+		if (x->ranged && status == 200) {
+			/* Nothing wrong with the port, it is the server */
+			printf("\nServer ignores range requests\n\t ");
+			http_xfer_drop(x);
+			return -1;
+		}
+		p = strchr(x->hdr, '\r');
+		if (p)
+			*p = '\0';
+		printf("\nServer answered '%s'\n", x->hdr);
+		http_xfer_failed(x, "Unexpected response");
+		return -1;
+	}
+
+	if (x->ranged) {
+		/* "Content-Range: bytes first-last/length" */
+		q = http_header_field(x, "Content-Range:");
+		if (!q || strncasecmp(q, "bytes ", 6) ||
+		    simple_strtoull(q + 6, NULL, 10) != x->offset) {
+			tcp_abort(x->conn);
+			http_xfer_failed(x, "Bad Content-Range");
+			return -1;
+		}
+		http_take_over(x);
+		return 0;
+	}
+
+	q = http_header_field(x, "Content-Length:");
+	if (q) {
+		http_content_length = simple_strtoull(q, NULL, 10);
+		x->end = http_content_length;
+		printf("Size is 0x%llx Bytes = ", http_content_length);
+		print_size(http_content_length, "\n");
+	}
+
+	puts("Loading: *\b");
+	if (http_content_length >= 0)
+		http_start_split();
+	return 0;
+}
+
+/*
+ * Collect the response header, which may span segments.
+ * Returns the number of bytes consumed, or -1 on error.
+ */
+static int http_receive_header(struct http_xfer *x, const uchar *data,
+			       unsigned len)
+{
+	unsigned i;
+
+	for (i = 0; i < len; i++) {
+		if (x->hdr_len == HTTP_HDR_MAX) {
+			tcp_abort(x->conn);
+			http_xfer_failed(x, "HTTP response header too long");
+			return -1;
+		}
+		x->hdr[x->hdr_len++] = data[i];
+		if (x->hdr_len >= 4 &&
+		    !memcmp(&x->hdr[x->hdr_len - 4], "\r\n\r\n", 4)) {
+			x->hdr[x->hdr_len] = '\0';
+			if (http_check_header(x))
+				return -1;
+			x->in_body = 1;
+			return i + 1;
+		}
+	}
+
+	return len;
+}
+
+static int http_stream(u64 offset, const void *src, ulong len)
+{
+	if (fw_stream_store(offset, src, len) || fw_stream_flush(0)) {
+		http_fail("Firmware stream failed");
+		return -1;
+	}
+	http_stream_pos = offset + len;
+
+	return 0;
+}
+
+/* Feed what the transfers parked at the load address to the stream */
+static void http_stream_drain(void)
+{
+	int i, progress = 1;
+
+	while (progress && !http_done) {
+		progress = 0;
+		for (i = 0; i < ARRAY_SIZE(http_xfers); i++) {
+			struct http_xfer *x = &http_xfers[i];
+			ulong len = x->offset - http_stream_pos;
+			void *ptr;
+
+			if (x->state == HTTP_XFER_IDLE ||
+			    x->from > http_stream_pos ||
+			    x->offset <= http_stream_pos)
+				continue;
+			ptr = map_sysmem(load_addr + http_stream_pos, len);
+			http_stream(http_stream_pos, ptr, len);
+			unmap_sysmem(ptr);
+			progress = 1;
+		}
+	}
+}
+
+static void http_store(struct http_xfer *x, const uchar *src, unsigned len)
+{
+	ulong skip = 0;
+	void *ptr;
+
+	/* Bytes below from are another transfer's */
+	if (x->offset < x->from)
+		skip = min_t(u64, len, x->from - x->offset);
+	x->offset += skip;
+	src += skip;
+	len -= skip;
+	len = min_t(u64, len, x->end - x->offset);
+	if (!len)
+		return;
+
+	if (tftp_upgrade_start && x->offset == http_stream_pos) {
+		/* Firmware upgrade: data goes to eMMC, not to load_addr */
+		if (http_stream(x->offset, src, len))
+			return;
+	} else {
+		ptr = map_sysmem(load_addr + x->offset, len);
+		memcpy(ptr, src, len);
+		unmap_sysmem(ptr);
+	}
+
+	x->offset += len;
+	if (tftp_upgrade_start)
+		http_stream_drain();
+
+	http_received += len;
+	/* A streamed image may not fit; the upgrade asks the stream */
+	if (!tftp_upgrade_start)
+		net_boot_file_size = http_received;
+
+	while (http_num_hash < http_received / HTTP_HASH_SIZE) {
+		putc('#');
+		if (++http_num_hash % HASHES_PER_LINE == 0)
+			puts("\n\t ");
+	}
+}
+
+static void http_handler(void *priv, enum tcp_event event, const uchar *data,
+			 unsigned len)
+{
+	struct http_xfer *x = priv;
+	int n;
+
+	if (http_done || x->state != HTTP_XFER_ACTIVE)
+		return;
+
+	switch (event) {
+	case TCP_CONNECTED:
+		http_send_request(x);
+		break;
+
+	case TCP_DATA:
+		if (!x->in_body) {
+			n = http_receive_header(x, data, len);
+			if (n < 0)
+				return;
+			data += n;
+			len -= n;
+		}
+		if (len)
+			http_store(x, data, len);
+		if (!http_done && x->state == HTTP_XFER_ACTIVE &&
+		    x->in_body && x->offset >= x->end)
+			http_xfer_end(x);
+		break;
+
+	case TCP_CLOSED:
+		if (!x->in_body) {
+			http_xfer_failed(x,
+					 "Connection closed before the response header");
+		} else if (http_content_length < 0) {
+			/* The end of the connection is the end of the body */
+			x->state = HTTP_XFER_DONE;
+			http_check_done();
+		} else if (x->offset < x->end) {
+			http_xfer_failed(x,
+					 "Connection closed before the end of the body");
+		} else {
+			x->state = HTTP_XFER_DONE;
+			http_check_done();
+		}
+		break;
+
+	case TCP_RESET:
+		http_xfer_failed(x, "Connection reset by server");
+		break;
+
+	case TCP_TIMEOUT:
+		http_xfer_failed(x, "Retry count exceeded; giving up");
+		break;
+	}
+}
+
+void http_start(void)
+{
+	char *name = net_boot_file_name;
+	char *p, *ep;
+
+	http_server_ip = net_server_ip;
+	http_server_port = HTTP_SERVICE_PORT;
+	ep = getenv("httpport");
+	if (ep != NULL)
+		http_server_port = simple_strtol(ep, NULL, 10);
+
+	p = strchr(name, ':');
+	if (p != NULL) {
+		http_server_ip = string_to_ip(name);
+		name = p + 1;
+	}
+	if (name[0] == '\0') {
+		puts("*** ERROR: no path given\n");
+		net_set_state(NETLOOP_FAIL);
+		return;
+	}
+	snprintf(http_path, sizeof(http_path), "%s%s",
+		 name[0] == '/' ? "" : "/", name);
+
+	printf("Using %s device\n", eth_get_name());
+	net_dual_start();
+	printf("HTTP from server %pI4:%d; our IP address is %pI4",
+	       &http_server_ip, http_server_port, &net_ip);
+
+	/* Check if we need to send across this subnet */
+	if (net_gateway.s_addr && net_netmask.s_addr) {
+		struct in_addr our_net;
+		struct in_addr remote_net;
+
+		our_net.s_addr = net_ip.s_addr & net_netmask.s_addr;
+		remote_net.s_addr = http_server_ip.s_addr & net_netmask.s_addr;
+		if (our_net.s_addr != remote_net.s_addr)
+			printf("; sending through gateway %pI4", &net_gateway);
+	}
+	putc('\n');
+
+	printf("Filename '%s'.\n", http_path);
+	printf("Load address: 0x%lx\n", load_addr);
+
+	/* Connections of an earlier run must not reach the new transfers */
+	tcp_reset_all();
+	memset(http_xfers, 0, sizeof(http_xfers));
+	memset(http_port_failed, 0, sizeof(http_port_failed));
+	http_content_length = -1;
+	http_range_ok = 0;
+	http_stream_pos = 0;
+	http_received = 0;
+	http_num_hash = 0;
+	http_done = 0;
+	tcp_ooo_segs = 0;
+	time_start = get_timer(0);
+
+	/* The whole body from the beginning, also when net_loop() restarts */
+	if (tftp_upgrade_start)
+		fw_stream_restart();
+
+	if (http_xfer_start(&http_xfers[0], 0, 0, 0, 0, ~0ULL))
+		http_fail("No free TCP connection");
+}
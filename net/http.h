@@ -0,0 +1,14 @@
+/*
+ * Plain HTTP/1.0 GET client on top of net/tcp.c
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef __HTTP_H__
+#define __HTTP_H__
+
+#define HTTP_SERVICE_PORT	80
+
+void http_start(void);	/* Begin HTTP GET */
+
+#endif /* __HTTP_H__ */
@@ -100,6 +100,10 @@
 #if defined(CONFIG_CMD_DNS)
 #include "dns.h"
 #endif
+#include "dual.h"
+#if defined(CONFIG_CMD_HTTPGET)
+#include "http.h"
+#endif
 #include "link_local.h"
 #include "nfs.h"
 #include "ping.h"
@@ -107,6 +111,9 @@
 #if defined(CONFIG_CMD_SNTP)
 #include "sntp.h"
 #endif
+#if defined(CONFIG_CMD_HTTPGET)
+#include "tcp.h"
+#endif
 
 DECLARE_GLOBAL_DATA_PTR;
 
@@ -475,6 +482,10 @@ static void net_clear_handlers(void)
 static void net_cleanup_loop(void)
 {
 	net_clear_handlers();
+#if defined(CONFIG_CMD_HTTPGET)
+	tcp_reset_all();
+#endif
+	net_dual_stop();
 }
 
 void net_init(void)
@@ -632,6 +643,11 @@ restart:
 		case LINKLOCAL:
 			link_local_start();
 			break;
+#endif
+#if defined(CONFIG_CMD_HTTPGET)
+		case HTTPGET:
+			http_start();
+			break;
 #endif
 		default:
 			break;
@@ -676,6 +692,8 @@ restart:
 		 *	errors that may have happened.
 		 */
 		eth_rx();
+		if (net_dual_active)
+			net_dual_rx();
 
 		/*
 		 *	Abort if ctrl-c was pressed.
@@ -725,8 +743,11 @@ restart:
 			(*x)();
 		}
 
-		if (net_state == NETLOOP_FAIL)
+		if (net_state == NETLOOP_FAIL) {
+			/* before ethact may rotate onto the second port */
+			net_dual_stop();
 			ret = net_start_again();
+		}
 
 		switch (net_state) {
 		case NETLOOP_RESTART:
@@ -925,6 +946,11 @@ int net_send_udp_packet(uchar *ether, struct in_addr dest, int dport, int sport,
 	net_set_udp_header(pkt, dest, dport, sport, payload_len);
 	pkt_hdr_size = eth_hdr_size + IP_UDP_HDR_SIZE;
 
+	return net_send_ip_packet(ether, dest, pkt_hdr_size + payload_len);
+}
+
+int net_send_ip_packet(uchar *ether, struct in_addr dest, int len)
+{
 	/* if MAC address was not discovered yet, do an ARP request */
 	if (memcmp(ether, net_null_ethaddr, 6) == 0) {
 		debug_cond(DEBUG_DEV_PKT, "sending ARP for %pI4\n", &dest);
@@ -933,8 +959,10 @@ int net_send_udp_packet(uchar *ether, struct in_addr dest, int dport, int sport,
 		net_arp_wait_packet_ip = dest;
 		arp_wait_packet_ethaddr = ether;
 
-		/* size of the waiting packet */
-		arp_wait_tx_packet_size = pkt_hdr_size + payload_len;
+		/* keep the waiting packet, net_tx_packet gets reused */
+		memcpy(arp_wait_tx_packet, net_tx_packet, len);
+		arp_wait_tx_packet_size = len;
+		arp_wait_port = net_port;
 
 		/* and do the ARP request */
 		arp_wait_try = 1;
@@ -942,9 +970,9 @@ int net_send_udp_packet(uchar *ether, struct in_addr dest, int dport, int sport,
 		arp_request();
 		return 1;	/* waiting */
 	} else {
-		debug_cond(DEBUG_DEV_PKT, "sending UDP to %pI4/%pM\n",
+		debug_cond(DEBUG_DEV_PKT, "sending IP to %pI4/%pM\n",
 			   &dest, ether);
-		net_send_packet(net_tx_packet, pkt_hdr_size + payload_len);
+		net_send_packet(net_tx_packet, len);
 		return 0;	/* transmitted */
 	}
 }
@@ -1338,6 +1366,11 @@ void net_process_received_packet(uchar *in_packet, int len)
 		if (ip->ip_p == IPPROTO_ICMP) {
 			receive_icmp(ip, len, src_ip, et);
 			return;
+#if defined(CONFIG_CMD_HTTPGET)
+		} else if (ip->ip_p == IPPROTO_TCP) {
+			tcp_receive((struct ip_hdr *)ip, len, src_ip);
+			return;
+#endif
 		} else if (ip->ip_p != IPPROTO_UDP) {	/* Only UDP packets */
 			return;
 		}
@@ -1455,6 +1488,9 @@ static int net_check_prereq(enum proto_t protocol)
 		/* Fall through */
 	case TFTPGET:
 	case TFTPPUT:
+#if defined(CONFIG_CMD_HTTPGET)
+	case HTTPGET:
+#endif
 		if (net_server_ip.s_addr == 0) {
 			puts("*** ERROR: `serverip' not set\n");
 			return 1;
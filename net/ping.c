@@ -50,13 +50,16 @@ static int ping_send(void)
 
 	net_arp_wait_packet_ip = net_ping_ip;
 
-	eth_hdr_size = net_set_ether(net_tx_packet, net_null_ethaddr, PROT_IP);
-	pkt = (uchar *)net_tx_packet + eth_hdr_size;
+	/* arp_receive() sends the waiting packet from its own buffer */
+	eth_hdr_size = net_set_ether(arp_wait_tx_packet, net_null_ethaddr,
+				     PROT_IP);
+	pkt = arp_wait_tx_packet + eth_hdr_size;
 
 	set_icmp_header(pkt, net_ping_ip);
 
 	/* size of the waiting packet */
 	arp_wait_tx_packet_size = eth_hdr_size + IP_ICMP_HDR_SIZE;
+	arp_wait_port = 0;
 
 	/* and do the ARP request */
 	arp_wait_try = 1;
@@ -0,0 +1,622 @@
+/*
+ * Minimal TCP client for net_loop() based protocols
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+/*
+ * A few client connections, driven by net_loop() like the UDP protocols.
+ * The receive side is what matters for downloads:
+ *
+ *  - a segment beyond rcv_nxt is answered with a duplicate ACK so the
+ *    peer fast-retransmits the hole, and kept in a small queue shared by
+ *    all connections until the hole is filled (no SACK). Dropping it
+ *    instead would turn every loss into one per segment in flight, and
+ *    the peer's retransmission timeout backs off further with each one
+ *  - the advertised window is fixed at CONFIG_TCP_RCV_WND; the payload is
+ *    consumed synchronously by the owner, so the window only has to cover
+ *    what the Ethernet RX ring can hold while the owner is busy
+ *  - ACKs are delayed: every second segment is acknowledged at once,
+ *    a lone segment after TCP_DELACK_MS
+ *
+ * The send side only carries short requests: one segment of at most
+ * TCP_MSS bytes may be outstanding and is retransmitted on timeout.
+ *
+ * net_loop() has a single timeout handler; each connection keeps its own
+ * deadline and the handler is armed for the earliest one.
+ */
+
+#include <common.h>
+#include <net.h>
+#include <asm/unaligned.h>
+#include "dual.h"
+#include "tcp.h"
+
+/* Delayed ACK timer for a lone segment */
+#define TCP_DELACK_MS	20UL
+/* Initial retransmission timeout for SYN and request, doubled per retry */
+#define TCP_RTO_MS	1000UL
+/* Millisecs without any segment before we poke the peer */
+#define TCP_IDLE_MS	5000UL
+#ifndef	CONFIG_NET_RETRY_COUNT
+/* # of timeouts before giving up */
+# define TCP_RETRIES	10
+#else
+# define TCP_RETRIES	(CONFIG_NET_RETRY_COUNT * 2)
+#endif
+
+/* Connections that may be open at the same time */
+#define TCP_MAX_CONNS	4
+
+#ifndef CONFIG_TCP_RCV_WND
+#define CONFIG_TCP_RCV_WND	(16 * TCP_MSS)
+#endif
+/* No window scaling, so the window field is all we have */
+#define TCP_RCV_WND	min_t(unsigned, CONFIG_TCP_RCV_WND, 0xffff)
+
+/* Out-of-order segments kept, a window's worth for each of two ports */
+#define TCP_OOO_SEGS	(2 * DIV_ROUND_UP(CONFIG_TCP_RCV_WND, TCP_MSS))
+
+/* Sequence number comparison, modulo 2^32 */
+#define seq_before(a, b)	((s32)((a) - (b)) < 0)
+#define seq_after(a, b)		seq_before(b, a)
+
+enum {
+	TCP_STATE_CLOSED,
+	TCP_STATE_SYN_SENT,
+	TCP_STATE_ESTABLISHED,
+	TCP_STATE_FIN_SENT,
+};
+
+struct tcp_conn {
+	int state;
+	tcp_handler_f *handler;
+	void *priv;
+
+	/* Ethernet port (see dual.h) the connection is bound to */
+	int port;
+	struct in_addr remote_ip;
+	uchar remote_ethaddr[6];
+	int remote_port;
+	int our_port;
+
+	/* Oldest unacknowledged and next sequence number we send */
+	u32 snd_una;
+	u32 snd_nxt;
+	/* Next sequence number we expect from the peer */
+	u32 rcv_nxt;
+
+	/* The outstanding request, kept for retransmission */
+	uchar tx_data[TCP_MSS];
+	unsigned tx_len;
+
+	/* Segments received since our last ACK */
+	int unacked_segs;
+	int retries;
+
+	/* Deadline of this connection's timer */
+	ulong timer_start;
+	ulong timer_ms;
+};
+
+static struct tcp_conn tcp_conns[TCP_MAX_CONNS];
+
+/* A segment that arrived before an earlier one of its connection */
+struct tcp_ooo_seg {
+	struct tcp_conn *conn;		/* NULL if the slot is free */
+	u32 seq;
+	unsigned len;
+	uchar data[TCP_MSS];
+};
+
+static struct tcp_ooo_seg tcp_ooo[TCP_OOO_SEGS];
+
+/* Segments that arrived before an earlier missing one */
+ulong tcp_ooo_segs;
+
+/* Forget the out-of-order segments of @c, or of all connections if NULL */
+static void tcp_ooo_purge(struct tcp_conn *c)
+{
+	int i;
+
+	for (i = 0; i < TCP_OOO_SEGS; i++)
+		if (!c || tcp_ooo[i].conn == c)
+			tcp_ooo[i].conn = NULL;
+}
+
+/* Keep a segment beyond rcv_nxt; it is dropped if no slot is free */
+static void tcp_ooo_queue(struct tcp_conn *c, u32 seq, const uchar *data,
+			  unsigned len)
+{
+	struct tcp_ooo_seg *slot = NULL;
+	int i;
+
+	if (!len || len > TCP_MSS || seq - c->rcv_nxt >= TCP_RCV_WND)
+		return;
+
+	for (i = 0; i < TCP_OOO_SEGS; i++) {
+		struct tcp_ooo_seg *o = &tcp_ooo[i];
+
+		/* Slots of a connection no longer established are free */
+		if (!o->conn || o->conn->state != TCP_STATE_ESTABLISHED)
+			slot = slot ? slot : o;
+		else if (o->conn == c && o->seq == seq && o->len >= len)
+			return;		/* already have it */
+	}
+	if (!slot)
+		return;
+
+	slot->conn = c;
+	slot->seq = seq;
+	slot->len = len;
+	memcpy(slot->data, data, len);
+}
+
+/*
+ * Pass on the queued segments which the last in-order one made
+ * contiguous. Returns nonzero if any data was passed on.
+ */
+static int tcp_ooo_deliver(struct tcp_conn *c)
+{
+	int i, found, delivered = 0;
+	unsigned off;
+
+	do {
+		found = 0;
+		for (i = 0; i < TCP_OOO_SEGS; i++) {
+			struct tcp_ooo_seg *o = &tcp_ooo[i];
+
+			if (o->conn != c || seq_after(o->seq, c->rcv_nxt))
+				continue;
+
+			found = 1;
+			o->conn = NULL;
+			off = c->rcv_nxt - o->seq;
+			if (off >= o->len)
+				continue;
+
+			c->rcv_nxt += o->len - off;
+			c->unacked_segs++;
+			delivered = 1;
+			c->handler(c->priv, TCP_DATA, o->data + off,
+				   o->len - off);
+			if (c->state != TCP_STATE_ESTABLISHED)
+				return delivered;
+		}
+	} while (found);
+
+	return delivered;
+}
+
+static unsigned tcp_checksum(struct in_addr src, struct in_addr dst,
+			     const void *seg, unsigned len)
+{
+	struct {
+		struct in_addr	src;
+		struct in_addr	dst;
+		u8		zero;
+		u8		proto;
+		u16		len;
+	} ph;
+
+	net_copy_ip(&ph.src, &src);
+	net_copy_ip(&ph.dst, &dst);
+	ph.zero = 0;
+	ph.proto = IPPROTO_TCP;
+	ph.len = htons(len);
+
+	return add_ip_checksums(sizeof(ph), compute_ip_checksum(&ph, sizeof(ph)),
+				compute_ip_checksum(seg, len));
+}
+
+static void tcp_send_segment(struct tcp_conn *c, u8 flags, u32 seq,
+			     const void *data, unsigned len)
+{
+	int prev_port = net_port;
+	uchar *pkt = net_tx_packet;
+	struct ip_hdr *ip;
+	struct tcp_hdr *tcp;
+	int eth_hdr_size;
+	unsigned hlen = TCP_HDR_SIZE;
+
+	/* Source addresses and device are those of the connection's port */
+	net_port_select(c->port);
+
+	eth_hdr_size = net_set_ether(pkt, c->remote_ethaddr, PROT_IP);
+	ip = (struct ip_hdr *)(pkt + eth_hdr_size);
+	tcp = (struct tcp_hdr *)((uchar *)ip + IP_HDR_SIZE);
+
+	if (flags & TCP_SYN) {
+		uchar *opt = (uchar *)tcp + TCP_HDR_SIZE;
+
+		/* Announce our MSS, the peer would assume 536 otherwise */
+		opt[0] = 2;
+		opt[1] = 4;
+		put_unaligned_be16(TCP_MSS, &opt[2]);
+		hlen += 4;
+	}
+	if (len)
+		memcpy((uchar *)tcp + hlen, data, len);
+
+	tcp->tcp_src   = htons(c->our_port);
+	tcp->tcp_dst   = htons(c->remote_port);
+	put_unaligned_be32(seq, &tcp->tcp_seq);
+	put_unaligned_be32((flags & TCP_ACK) ? c->rcv_nxt : 0, &tcp->tcp_ack);
+	tcp->tcp_hlen  = (hlen / 4) << 4;
+	tcp->tcp_flags = flags;
+	tcp->tcp_win   = htons(TCP_RCV_WND);
+	tcp->tcp_xsum  = 0;
+	tcp->tcp_urg   = 0;
+	tcp->tcp_xsum  = tcp_checksum(net_ip, c->remote_ip, tcp, hlen + len);
+
+	net_set_ip_header((uchar *)ip, c->remote_ip, net_ip);
+	ip->ip_len = htons(IP_HDR_SIZE + hlen + len);
+	ip->ip_p   = IPPROTO_TCP;
+	ip->ip_sum = compute_ip_checksum(ip, IP_HDR_SIZE);
+
+	if (flags & TCP_ACK)
+		c->unacked_segs = 0;
+
+	net_send_ip_packet(c->remote_ethaddr, c->remote_ip,
+			   eth_hdr_size + IP_HDR_SIZE + hlen + len);
+
+	net_port_select(prev_port);
+}
+
+static void tcp_send_ack(struct tcp_conn *c)
+{
+	tcp_send_segment(c, TCP_ACK, c->snd_nxt, NULL, 0);
+}
+
+static void tcp_timeout_handler(void);
+
+/* Arm net_loop()'s timeout for the earliest connection deadline */
+static void tcp_update_timer(void)
+{
+	ulong now = get_timer(0);
+	ulong ms = ~0UL, left, elapsed;
+	int i;
+
+	for (i = 0; i < TCP_MAX_CONNS; i++) {
+		struct tcp_conn *c = &tcp_conns[i];
+
+		if (c->state == TCP_STATE_CLOSED || !c->timer_ms)
+			continue;
+		elapsed = now - c->timer_start;
+		left = elapsed < c->timer_ms ? c->timer_ms - elapsed : 0;
+		ms = min(ms, left);
+	}
+
+	/* An interval of 0 would cancel the timeout instead of arming it */
+	if (ms != ~0UL)
+		net_set_timeout_handler(max(ms, 1UL), tcp_timeout_handler);
+}
+
+static void tcp_arm_timer(struct tcp_conn *c)
+{
+	if (c->unacked_segs)
+		c->timer_ms = TCP_DELACK_MS;
+	else if (c->state == TCP_STATE_SYN_SENT || c->tx_len)
+		c->timer_ms = TCP_RTO_MS << min(c->retries, 3);
+	else
+		c->timer_ms = TCP_IDLE_MS;
+	c->timer_start = get_timer(0);
+
+	tcp_update_timer();
+}
+
+static void tcp_conn_timeout(struct tcp_conn *c)
+{
+	if (c->unacked_segs) {
+		tcp_send_ack(c);
+		tcp_arm_timer(c);
+		return;
+	}
+
+	/* We are done with it; do not wait for the peer's FIN forever */
+	if (c->state == TCP_STATE_FIN_SENT) {
+		c->state = TCP_STATE_CLOSED;
+		return;
+	}
+
+	if (++c->retries > TCP_RETRIES) {
+		c->state = TCP_STATE_CLOSED;
+		c->handler(c->priv, TCP_TIMEOUT, NULL, 0);
+		return;
+	}
+
+	if (c->state == TCP_STATE_SYN_SENT)
+		tcp_send_segment(c, TCP_SYN, c->snd_una, NULL, 0);
+	else if (c->tx_len)
+		tcp_send_segment(c, TCP_ACK | TCP_PSH, c->snd_una, c->tx_data,
+				 c->tx_len);
+	else
+		/* Repeat our ACK in case the last one was lost */
+		tcp_send_ack(c);
+
+	tcp_arm_timer(c);
+}
+
+static void tcp_timeout_handler(void)
+{
+	ulong now = get_timer(0);
+	int i;
+
+	for (i = 0; i < TCP_MAX_CONNS; i++) {
+		struct tcp_conn *c = &tcp_conns[i];
+
+		if (c->state != TCP_STATE_CLOSED && c->timer_ms &&
+		    now - c->timer_start >= c->timer_ms)
+			tcp_conn_timeout(c);
+	}
+
+	tcp_update_timer();
+}
+
+struct tcp_conn *tcp_connect(int port, struct in_addr dest, int dport,
+			     tcp_handler_f *handler, void *priv)
+{
+	struct tcp_conn *c = NULL;
+	u32 iss = (u32)get_ticks();
+	int i;
+
+	for (i = 0; i < TCP_MAX_CONNS && !c; i++)
+		if (tcp_conns[i].state == TCP_STATE_CLOSED)
+			c = &tcp_conns[i];
+	if (!c)
+		return NULL;
+
+	c->handler = handler;
+	c->priv = priv;
+	c->port = port;
+	c->remote_ip = dest;
+	c->remote_port = dport;
+	/* A fresh ephemeral port so stale segments of a previous run miss */
+	c->our_port = 49152 + ((get_timer(0) + i) % 16384);
+	/* zero out remote ether in case the server ip has changed */
+	memset(c->remote_ethaddr, 0, 6);
+
+	c->snd_una = iss;
+	c->snd_nxt = iss + 1;
+	c->rcv_nxt = 0;
+	c->tx_len = 0;
+	c->unacked_segs = 0;
+	c->retries = 0;
+	c->state = TCP_STATE_SYN_SENT;
+	tcp_ooo_purge(c);
+
+	tcp_send_segment(c, TCP_SYN, iss, NULL, 0);
+	tcp_arm_timer(c);
+
+	return c;
+}
+
+int tcp_send(struct tcp_conn *c, const void *data, unsigned len)
+{
+	if (c->state != TCP_STATE_ESTABLISHED || c->tx_len || len > TCP_MSS)
+		return -1;
+
+	memcpy(c->tx_data, data, len);
+	c->tx_len = len;
+	tcp_send_segment(c, TCP_ACK | TCP_PSH, c->snd_nxt, c->tx_data, len);
+	c->snd_nxt += len;
+	tcp_arm_timer(c);
+
+	return 0;
+}
+
+void tcp_close(struct tcp_conn *c)
+{
+	if (c->state != TCP_STATE_ESTABLISHED)
+		return;
+
+	tcp_send_segment(c, TCP_FIN | TCP_ACK, c->snd_nxt, NULL, 0);
+	c->snd_nxt++;
+	c->state = TCP_STATE_FIN_SENT;
+	tcp_arm_timer(c);
+}
+
+void tcp_abort(struct tcp_conn *c)
+{
+	if (c->state == TCP_STATE_CLOSED)
+		return;
+
+	if (c->state != TCP_STATE_SYN_SENT)
+		tcp_send_segment(c, TCP_RST | TCP_ACK, c->snd_nxt, NULL, 0);
+	c->state = TCP_STATE_CLOSED;
+}
+
+void tcp_reset_all(void)
+{
+	int i;
+
+	/*
+	 * Connections of an earlier net_loop() run still point at their
+	 * owner's state, which the new run has reinitialised. Drop them
+	 * without a word; their ephemeral ports keep the peer's late
+	 * segments from matching a new connection.
+	 */
+	for (i = 0; i < TCP_MAX_CONNS; i++) {
+		struct tcp_conn *c = &tcp_conns[i];
+
+		c->state = TCP_STATE_CLOSED;
+		c->handler = NULL;
+		c->priv = NULL;
+		c->timer_ms = 0;
+	}
+	tcp_ooo_purge(NULL);
+}
+
+/* Handle SYN+ACK in state SYN_SENT */
+static void tcp_receive_synack(struct tcp_conn *c, u8 flags, u32 seq, u32 ack)
+{
+	if ((flags & (TCP_SYN | TCP_ACK)) != (TCP_SYN | TCP_ACK) ||
+	    ack != c->snd_nxt)
+		return;
+
+	c->rcv_nxt = seq + 1;
+	c->snd_una = ack;
+	c->retries = 0;
+	c->state = TCP_STATE_ESTABLISHED;
+
+	c->handler(c->priv, TCP_CONNECTED, NULL, 0);
+
+	/* Acknowledge the SYN unless the owner's request already did */
+	if (c->state == TCP_STATE_ESTABLISHED && c->snd_una == c->snd_nxt)
+		tcp_send_ack(c);
+}
+
+static struct tcp_conn *tcp_find_conn(struct in_addr src_ip, int sport,
+				      int dport)
+{
+	int i;
+
+	for (i = 0; i < TCP_MAX_CONNS; i++) {
+		struct tcp_conn *c = &tcp_conns[i];
+
+		if (c->state != TCP_STATE_CLOSED && c->port == net_port &&
+		    c->remote_ip.s_addr == src_ip.s_addr &&
+		    c->remote_port == sport && c->our_port == dport)
+			return c;
+	}
+
+	return NULL;
+}
+
+static void tcp_receive_segment(struct ip_hdr *ip, unsigned len,
+				struct in_addr src_ip)
+{
+	struct tcp_hdr *tcp = (struct tcp_hdr *)((uchar *)ip + IP_HDR_SIZE);
+	struct tcp_conn *c;
+	unsigned seg_len, hlen, dlen;
+	uchar *data;
+	u32 seq, ack, off;
+	u8 flags;
+
+	if (len < IP_HDR_SIZE + TCP_HDR_SIZE)
+		return;
+	seg_len = len - IP_HDR_SIZE;
+
+	c = tcp_find_conn(src_ip, ntohs(tcp->tcp_src), ntohs(tcp->tcp_dst));
+	if (!c)
+		return;
+
+	if (tcp_checksum(src_ip, net_read_ip(&ip->ip_dst), tcp, seg_len) &
+	    0xfffe) {
+		debug("TCP checksum bad\n");
+		return;
+	}
+
+	hlen = (tcp->tcp_hlen >> 4) * 4;
+	if (hlen < TCP_HDR_SIZE || hlen > seg_len)
+		return;
+	data = (uchar *)tcp + hlen;
+	dlen = seg_len - hlen;
+	flags = tcp->tcp_flags;
+	seq = get_unaligned_be32(&tcp->tcp_seq);
+	ack = get_unaligned_be32(&tcp->tcp_ack);
+
+	if (flags & TCP_RST) {
+		/* Only trust a reset that matches our view of the stream */
+		if (c->state == TCP_STATE_SYN_SENT ?
+		    (!(flags & TCP_ACK) || ack != c->snd_nxt) :
+		    seq != c->rcv_nxt)
+			return;
+		c->state = TCP_STATE_CLOSED;
+		c->handler(c->priv, TCP_RESET, NULL, 0);
+		return;
+	}
+
+	if (c->state == TCP_STATE_SYN_SENT) {
+		tcp_receive_synack(c, flags, seq, ack);
+		if (c->state != TCP_STATE_CLOSED)
+			tcp_arm_timer(c);
+		return;
+	}
+
+	if (flags & TCP_SYN) {
+		/* Retransmitted SYN+ACK: our ACK of it got lost */
+		tcp_send_ack(c);
+		return;
+	}
+
+	if ((flags & TCP_ACK) && seq_after(ack, c->snd_una) &&
+	    !seq_after(ack, c->snd_nxt)) {
+		c->snd_una = ack;
+		if (c->snd_una == c->snd_nxt)
+			c->tx_len = 0;
+		c->retries = 0;
+	}
+
+	if (dlen || (flags & TCP_FIN)) {
+		if (seq_after(seq, c->rcv_nxt)) {
+			/* A segment before this one is missing */
+			tcp_ooo_segs++;
+			if (c->state == TCP_STATE_ESTABLISHED)
+				tcp_ooo_queue(c, seq, data, dlen);
+			tcp_send_ack(c);
+			return;
+		}
+
+		/* Skip what we already have; a pure retransmission is ACKed */
+		off = c->rcv_nxt - seq;
+		if (off > dlen || (off == dlen && !(flags & TCP_FIN))) {
+			tcp_send_ack(c);
+			return;
+		}
+		data += off;
+		dlen -= off;
+
+		if (dlen) {
+			/* After tcp_close() data is only acknowledged */
+			c->rcv_nxt += dlen;
+			c->unacked_segs++;
+			c->retries = 0;
+			if (c->state == TCP_STATE_ESTABLISHED)
+				c->handler(c->priv, TCP_DATA, data, dlen);
+			if (c->state == TCP_STATE_CLOSED)
+				return;
+
+			/* A filled hole is acknowledged at once (RFC 5681) */
+			if (c->state == TCP_STATE_ESTABLISHED &&
+			    tcp_ooo_deliver(c)) {
+				if (c->state == TCP_STATE_CLOSED)
+					return;
+				tcp_send_ack(c);
+			}
+		}
+
+		if (flags & TCP_FIN) {
+			c->rcv_nxt++;
+			if (c->state == TCP_STATE_ESTABLISHED) {
+				tcp_send_segment(c, TCP_FIN | TCP_ACK,
+						 c->snd_nxt++, NULL, 0);
+				c->state = TCP_STATE_CLOSED;
+				c->handler(c->priv, TCP_CLOSED, NULL, 0);
+			} else {
+				tcp_send_ack(c);
+				c->state = TCP_STATE_CLOSED;
+			}
+			return;
+		}
+
+		/* RFC 1122: ACK at least every second full-sized segment */
+		if (c->unacked_segs >= 2)
+			tcp_send_ack(c);
+	}
+
+	if (c->state != TCP_STATE_CLOSED)
+		tcp_arm_timer(c);
+}
+
+void tcp_receive(struct ip_hdr *ip, unsigned len, struct in_addr src_ip)
+{
+	tcp_receive_segment(ip, len, src_ip);
+
+	/*
+	 * Every segment re-arms the net_loop() timeout, so while one
+	 * connection streams the timeout may never fire. Serve the other
+	 * connections' expired deadlines here.
+	 */
+	tcp_timeout_handler();
+}
@@ -0,0 +1,80 @@
+/*
+ * Minimal TCP client
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef __TCP_H__
+#define __TCP_H__
+
+/*
+ *	TCP header (RFC 793), without options.
+ */
+struct tcp_hdr {
+	u16		tcp_src;	/* Source port			*/
+	u16		tcp_dst;	/* Destination port		*/
+	u32		tcp_seq;	/* Sequence number		*/
+	u32		tcp_ack;	/* Acknowledgement number	*/
+	u8		tcp_hlen;	/* Data offset (high nibble)	*/
+	u8		tcp_flags;	/* Control bits			*/
+	u16		tcp_win;	/* Receive window		*/
+	u16		tcp_xsum;	/* Checksum			*/
+	u16		tcp_urg;	/* Urgent pointer		*/
+};
+
+#define TCP_HDR_SIZE		(sizeof(struct tcp_hdr))
+
+#define TCP_FIN		0x01
+#define TCP_SYN		0x02
+#define TCP_RST		0x04
+#define TCP_PSH		0x08
+#define TCP_ACK		0x10
+
+/* Largest segment we accept: an untagged Ethernet frame minus IP + TCP */
+#define TCP_MSS		(1500 - IP_HDR_SIZE - TCP_HDR_SIZE)
+
+/* Events reported to the connection owner */
+enum tcp_event {
+	TCP_CONNECTED,		/* handshake done, tcp_send() may be used */
+	TCP_DATA,		/* in-order payload received */
+	TCP_CLOSED,		/* peer sent FIN, all data delivered */
+	TCP_RESET,		/* peer refused or reset the connection */
+	TCP_TIMEOUT,		/* peer stopped answering */
+};
+
+struct tcp_conn;
+
+/*
+ * Connection callback, with the @priv given to tcp_connect(). @data/@len
+ * are only valid for TCP_DATA and only until the handler returns.
+ */
+typedef void tcp_handler_f(void *priv, enum tcp_event event,
+			   const uchar *data, unsigned len);
+
+/* Segments that arrived before an earlier missing one; reset by the user */
+extern ulong tcp_ooo_segs;
+
+/*
+ * Open a connection on Ethernet port @port (0 unless CONFIG_NET_DUAL_FETCH,
+ * see dual.h); the handshake is completed from net_loop(). Returns NULL
+ * if all connection slots are busy.
+ */
+struct tcp_conn *tcp_connect(int port, struct in_addr dest, int dport,
+			     tcp_handler_f *handler, void *priv);
+
+/* Queue @len bytes (at most TCP_MSS) for the peer */
+int tcp_send(struct tcp_conn *conn, const void *data, unsigned len);
+
+/* Send our FIN and stop accepting data */
+void tcp_close(struct tcp_conn *conn);
+
+/* Reset the connection, the peer stops sending at once */
+void tcp_abort(struct tcp_conn *conn);
+
+/* Close every connection without notifying its owner */
+void tcp_reset_all(void);
+
+/* Called by net_process_received_packet() for IPPROTO_TCP datagrams */
+void tcp_receive(struct ip_hdr *ip, unsigned len, struct in_addr src_ip);
+
+#endif /* __TCP_H__ */
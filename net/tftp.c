@@ -8,6 +8,7 @@
 
 #include <common.h>
 #include <command.h>
+#include <div64.h>
 #include <mapmem.h>
 #include <net.h>
 #include <net/tftp.h>
@@ -45,7 +46,6 @@ static ulong timeout_ms = TIMEOUT;
 static int timeout_count_max = TIMEOUT_COUNT;
 static ulong time_start;   /* Record time we started tftp */
 extern int tftp_upgrade_start;
-unsigned int fw_tftp_size = 0;
 
 /*
  * These globals govern the timeout behavior when attempting a connection to a
@@ -82,7 +82,9 @@ static ulong	tftp_prev_block;
 /* count of sequence number wraparounds */
 static ulong	tftp_block_wrap;
 /* memory offset due to wrapping */
-static ulong	tftp_block_wrap_offset;
+static u64	tftp_block_wrap_offset;
+/* bytes received; unlike net_boot_file_size this holds a streamed image */
+static u64	tftp_received;
 static int	tftp_state;
 #ifdef CONFIG_TFTP_TSIZE
 /* The file size reported by the server */
@@ -137,6 +139,27 @@ static char tftp_filename[MAX_LEN];
 static unsigned short tftp_block_size = TFTP_BLOCK_SIZE;
 static unsigned short tftp_block_size_option = TFTP_MTU_BLOCKSIZE;
 
+/*
+ * RFC 7440 window: the server sends this many blocks before it waits
+ * for an ACK. A window of 1 is plain lock-step RFC 1350.
+ */
+#ifdef CONFIG_TFTP_WINDOWSIZE
+#define TFTP_WINDOWSIZE CONFIG_TFTP_WINDOWSIZE
+#else
+#define TFTP_WINDOWSIZE 1
+#endif
+
+static unsigned short tftp_windowsize = 1;
+static unsigned short tftp_windowsize_option = TFTP_WINDOWSIZE;
+/* block which ends the current window and has to be ACKed */
+static ulong	tftp_next_ack;
+/* last in-order block we have already rolled the server back to */
+static ulong	tftp_last_nack;
+/* out-of-order blocks since that rollback ACK */
+static ulong	tftp_nack_skipped;
+/* count of windows restarted because a block went missing */
+static ulong	tftp_rollbacks;
+
 #ifdef CONFIG_MCAST_TFTP
 #include <malloc.h>
 #define MTFTP_BITMAPSIZE	0x1000
@@ -169,10 +192,10 @@ static void mcast_cleanup(void)
 
 static inline void store_block(int block, uchar *src, unsigned len)
 {
-	ulong offset = block * tftp_block_size + tftp_block_wrap_offset;
-	ulong newsize = offset + len;
+	/* 64 bits: a firmware stream goes past 4 GiB */
+	u64 offset = (u64)block * tftp_block_size + tftp_block_wrap_offset;
+	u64 newsize = offset + len;
 
-	offset = offset % EMMC_COPY_LIMIT_SIZE;
 #ifdef CONFIG_SYS_DIRECT_FLASH_TFTP
 	int i, rc = 0;
 
@@ -195,7 +218,13 @@ static inline void store_block(int block, uchar *src, unsigned len)
 		}
 	} else
 #endif /* CONFIG_SYS_DIRECT_FLASH_TFTP */
-	{
+	if (tftp_upgrade_start) {
+		/* Firmware upgrade: data goes to eMMC, not to load_addr */
+		if (fw_stream_store(offset, src, len)) {
+			net_set_state(NETLOOP_FAIL);
+			return;
+		}
+	} else {
 		void *ptr = map_sysmem(load_addr + offset, len);
 
 		memcpy(ptr, src, len);
@@ -206,7 +235,13 @@ static inline void store_block(int block, uchar *src, unsigned len)
 		ext2_set_bit(block, tftp_mcast_bitmap);
 #endif
 
-	if (net_boot_file_size < newsize)
+	if (tftp_received < newsize)
+		tftp_received = newsize;
+	/*
+	 * A streamed image never was in memory and may not fit in 32 bits;
+	 * the upgrade takes its size from the stream instead.
+	 */
+	if (!tftp_upgrade_start && net_boot_file_size < newsize)
 		net_boot_file_size = newsize;
 }
 
@@ -216,6 +251,11 @@ static void new_transfer(void)
 	tftp_prev_block = 0;
 	tftp_block_wrap = 0;
 	tftp_block_wrap_offset = 0;
+	tftp_received = 0;
+	tftp_next_ack = tftp_windowsize;
+	tftp_last_nack = -1;
+	tftp_nack_skipped = 0;
+	tftp_rollbacks = 0;
 #ifdef CONFIG_CMD_TFTPPUT
 	tftp_put_final_block_sent = 0;
 #endif
@@ -323,8 +363,12 @@ static void tftp_complete(void)
 	time_start = get_timer(time_start);
 	if (time_start > 0) {
 		puts("\n\t ");	/* Line up with "Loading: " */
-		print_size(net_boot_file_size /
-			time_start * 1000, "/s");
+		/* tftpput sends net_boot_file_size bytes */
+		print_size(lldiv(tftp_put_active ? net_boot_file_size :
+				 tftp_received, time_start) * 1000, "/s");
+		if (tftp_windowsize > 1)
+			printf(", window %d, %lu rollbacks", tftp_windowsize,
+			       tftp_rollbacks);
 	}
 	puts("\ndone\n");
 	net_set_state(NETLOOP_SUCCESS);
@@ -377,6 +421,9 @@ static void tftp_send(void)
 		/* try for more effic. blk size */
 		pkt += sprintf((char *)pkt, "blksize%c%d%c",
 				0, tftp_block_size_option, 0);
+		if (tftp_state == STATE_SEND_RRQ && tftp_windowsize_option > 1)
+			pkt += sprintf((char *)pkt, "windowsize%c%d%c",
+					0, tftp_windowsize_option, 0);
 #ifdef CONFIG_MCAST_TFTP
 		/* Check all preconditions before even trying the option */
 		if (!tftp_mcast_disabled) {
@@ -545,6 +592,16 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 				debug("Blocksize ack: %s, %d\n",
 				      (char *)pkt + i + 8, tftp_block_size);
 			}
+			if (i + 11 < len &&
+			    strcmp((char *)pkt + i, "windowsize") == 0) {
+				tftp_windowsize = (unsigned short)
+					simple_strtoul((char *)pkt + i + 11,
+						       NULL, 10);
+				if (tftp_windowsize == 0)
+					tftp_windowsize = 1;
+				debug("Windowsize ack: %s, %d\n",
+				      (char *)pkt + i + 11, tftp_windowsize);
+			}
 #ifdef CONFIG_TFTP_TSIZE
 			if (strcmp((char *)pkt+i, "tsize") == 0) {
 				tftp_tsize = simple_strtoul((char *)pkt + i + 6,
@@ -575,8 +632,6 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 		len -= 2;
 		tftp_cur_block = ntohs(*(__be16 *)pkt);
 
-		update_block_number();
-
 		if (tftp_state == STATE_SEND_RRQ)
 			debug("Server did not acknowledge timeout option!\n");
 
@@ -586,13 +641,16 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			tftp_state = STATE_DATA;
 			tftp_remote_port = src;
 			new_transfer();
+			if (tftp_upgrade_start)
+				fw_stream_restart();
 
 #ifdef CONFIG_MCAST_TFTP
 			if (tftp_mcast_active) { /* start!=1 common if mcast */
 				tftp_prev_block = tftp_cur_block - 1;
 			} else
 #endif
-			if (tftp_cur_block != 1) {	/* Assertion */
+			/* A windowed transfer rolls back to block 1 below */
+			if (tftp_cur_block != 1 && tftp_windowsize == 1) {
 				puts("\nTFTP error: ");
 				printf("First block is not block 1 (%ld)\n",
 				       tftp_cur_block);
@@ -607,6 +665,35 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			break;
 		}
 
+		/*
+		 * Within a window only the block following the last one we
+		 * stored is of any use: the data is stored (or streamed to
+		 * eMMC) strictly in order. Anything else means a block of
+		 * the window was lost or the server is repeating an old
+		 * window, so ACK the last good block to make the server
+		 * restart its window right after it. If another window's
+		 * worth of blocks goes by without the one we want, that ACK
+		 * was lost and is sent again.
+		 */
+		if (tftp_windowsize > 1 &&
+		    tftp_cur_block != (ushort)(tftp_prev_block + 1)) {
+			debug("Got block %ld, expected %ld\n", tftp_cur_block,
+			      (ulong)(ushort)(tftp_prev_block + 1));
+			tftp_cur_block = tftp_prev_block;
+			if (tftp_last_nack != tftp_prev_block ||
+			    ++tftp_nack_skipped >= tftp_windowsize) {
+				tftp_last_nack = tftp_prev_block;
+				tftp_nack_skipped = 0;
+				tftp_next_ack = (ushort)(tftp_prev_block +
+							 tftp_windowsize);
+				tftp_rollbacks++;
+				tftp_send();
+			}
+			break;
+		}
+
+		update_block_number();
+
 		tftp_prev_block = tftp_cur_block;
 		timeout_count_max = tftp_timeout_count_max;
 		net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
@@ -643,12 +730,21 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			}
 		}
 #endif
-		tftp_send();
+		/* Only the last block of a window (or file) is ACKed */
+		if (tftp_windowsize == 1 || tftp_cur_block == tftp_next_ack ||
+		    len < tftp_block_size) {
+			tftp_next_ack = (ushort)(tftp_cur_block +
+						 tftp_windowsize);
+			tftp_send();
 
-		if(tftp_upgrade_start) {
-			fw_tftp_size += len;
-			if((net_boot_file_size % EMMC_COPY_LIMIT_SIZE) == 0)
-				copy_tftp_firmware_to_emmc();
+			/*
+			 * The ACK is already on the wire, so the server sends
+			 * the next window while a full slot is written to eMMC.
+			 */
+			if (tftp_upgrade_start && fw_stream_flush(0)) {
+				net_set_state(NETLOOP_FAIL);
+				break;
+			}
 		}
 
 #ifdef CONFIG_MCAST_TFTP
@@ -662,9 +758,6 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 		} else
 #endif
 		if (len < tftp_block_size) {
-			if(tftp_upgrade_start)
-				copy_tftp_firmware_to_emmc();
-
 			tftp_complete();
 		}
 
@@ -706,6 +799,10 @@ static void tftp_timeout_handler(void)
 	} else {
 		puts("T ");
 		net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
+		/* The server restarts its window after the block we ACK */
+		if (tftp_state == STATE_DATA && !tftp_put_active)
+			tftp_next_ack = (ushort)(tftp_cur_block +
+						 tftp_windowsize);
 		if (tftp_state != STATE_RECV_WRQ)
 			tftp_send();
 	}
@@ -726,6 +823,10 @@ void tftp_start(enum proto_t protocol)
 	if (ep != NULL)
 		tftp_block_size_option = simple_strtol(ep, NULL, 10);
 
+	ep = getenv("tftpwindowsize");
+	if (ep != NULL)
+		tftp_windowsize_option = simple_strtol(ep, NULL, 10);
+
 	ep = getenv("tftptimeout");
 	if (ep != NULL)
 		timeout_ms = simple_strtol(ep, NULL, 10);
@@ -747,8 +848,8 @@ void tftp_start(enum proto_t protocol)
 	}
 #endif
 
-	debug("TFTP blocksize = %i, timeout = %ld ms\n",
-	      tftp_block_size_option, timeout_ms);
+	debug("TFTP blocksize = %i, windowsize = %i, timeout = %ld ms\n",
+	      tftp_block_size_option, tftp_windowsize_option, timeout_ms);
 
 	tftp_remote_ip = net_server_ip;
 	if (net_boot_file_name[0] == '\0') {
@@ -850,6 +951,7 @@ void tftp_start(enum proto_t protocol)
 	memset(net_server_ethaddr, 0, 6);
 	/* Revert tftp_block_size to dflt */
 	tftp_block_size = TFTP_BLOCK_SIZE;
+	tftp_windowsize = 1;
 #ifdef CONFIG_MCAST_TFTP
 	mcast_cleanup();
 #endif
@@ -879,6 +981,7 @@ void tftp_start_server(void)
 
 	/* Revert tftp_block_size to dflt */
 	tftp_block_size = TFTP_BLOCK_SIZE;
+	tftp_windowsize = 1;
 	tftp_cur_block = 0;
 	tftp_our_port = WELL_KNOWN_PORT;
 
@@ -0,0 +1,197 @@
+/*
+ * Test vectors for the secure boot keystream XOR in
+ * common/moxa_src/common/moxa_crypt.c
+ *
+ * Every key combination the boot loader can pick is run over a set of
+ * image and key sizes and base alignments, against the original byte at a
+ * time walk from do_encryption_func(). Both must leave the image (and the
+ * bytes past its end that the walk can reach) bit-identical, and applying
+ * the keystream twice must give back the original image.
+ *
+ * With -t it instead times both over a 6 MiB image for every jump and
+ * direction. That is the host's speed, not the board's.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../common/moxa_src/common/moxa_crypt.h"
+
+#define ARRAY_SIZE(x)	(sizeof(x) / sizeof((x)[0]))
+
+static const unsigned long start_offset[16] = {
+	0x5DC00, 0x5EB00, 0x60900, 0x73500, 0x86100, 0xAB900, 0xD1100, 0xF6900,
+	0x25800, 0x4B000, 0x96000, 0xBB800, 0xE1000, 0xD7A00, 0xCE400, 0x79E00
+};
+
+/* Distinct values of jump_offset[], selected by key3 */
+static const unsigned long jumps[] = { 2, 4, 6, 8, 10 };
+
+static const unsigned long image_sizes[] = {
+	0x100001,	/* past every start offset */
+	0x3ffff,	/* before most start offsets */
+	0x2a,
+};
+
+static const unsigned long key_sizes[] = { 1, 7, 4096, 0x50001 };
+
+/* The walk as it was in do_encryption_func(), which had img volatile */
+static void ref_xor_keystream(volatile unsigned char *img, unsigned long fs1,
+			      const unsigned char *key, unsigned long fs2,
+			      unsigned long pos, int up, unsigned long jump)
+{
+	unsigned long size = fs1 / jump;
+	unsigned long baddr = 0;
+	unsigned long i;
+	unsigned long j = 1;
+
+	if (fs1 % jump)
+		size++;
+
+	for (i = 0; i < size; i++) {
+		img[pos] ^= key[baddr];
+
+		if (i == ((fs2 * j) - 1)) {
+			baddr = 0;
+			j++;
+		} else {
+			baddr++;
+		}
+
+		if (up) {
+			if (pos < jump)
+				pos = fs1 - jump;
+			else
+				pos -= jump;
+		} else {
+			pos += jump;
+			if (pos > fs1)
+				pos -= fs1;
+		}
+	}
+}
+
+static void fill(unsigned char *buf, unsigned long len)
+{
+	unsigned long i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = rand();
+}
+
+static int time_keystream(void)
+{
+	unsigned long isize = 6 << 20;
+	unsigned long ksize = 0x40000;
+	unsigned char *img, *key;
+	clock_t t, ref = 0, new = 0;
+	unsigned int ji, up;
+
+	img = malloc(isize + start_offset[7] + 0x10);
+	key = malloc(ksize);
+	if (!img || !key) {
+		fprintf(stderr, "out of memory\n");
+		return EXIT_FAILURE;
+	}
+
+	fill(img, isize + start_offset[7] + 0x10);
+	fill(key, ksize);
+
+	for (ji = 0; ji < ARRAY_SIZE(jumps); ji++)
+	for (up = 0; up < 2; up++) {
+		t = clock();
+		ref_xor_keystream(img, isize, key, ksize, start_offset[0], up,
+				  jumps[ji]);
+		ref += clock() - t;
+
+		t = clock();
+		moxa_xor_keystream(img, isize, key, ksize, start_offset[0], up,
+				   jumps[ji]);
+		new += clock() - t;
+	}
+
+	printf("byte walk %.3f s, moxa_xor_keystream %.3f s\n",
+	       (double)ref / CLOCKS_PER_SEC, (double)new / CLOCKS_PER_SEC);
+
+	free(img);
+	free(key);
+
+	return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned char *orig, *key, *ref, *buf, *img;
+	unsigned long isize, ksize, start, jump, span;
+	unsigned int si, ii, ki, ji, up;
+	int runs = 0;
+	int fails = 0;
+
+	srand(0x4d4f5841);
+
+	if (argc > 1 && !strcmp(argv[1], "-t"))
+		return time_keystream();
+
+	/* Room for the largest start offset plus a jump past the image */
+	span = image_sizes[0] + start_offset[7] + 0x10;
+	orig = malloc(span);
+	ref = malloc(span);
+	buf = malloc(span + 4);
+	key = malloc(key_sizes[3]);
+	if (!orig || !ref || !buf || !key) {
+		fprintf(stderr, "%s: out of memory\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	fill(orig, span);
+	fill(key, key_sizes[3]);
+
+	for (ii = 0; ii < ARRAY_SIZE(image_sizes); ii++)
+	for (ki = 0; ki < ARRAY_SIZE(key_sizes); ki++)
+	for (si = 0; si < ARRAY_SIZE(start_offset); si++)
+	for (ji = 0; ji < ARRAY_SIZE(jumps); ji++)
+	for (up = 0; up < 2; up++) {
+		isize = image_sizes[ii];
+		ksize = key_sizes[ki];
+		start = start_offset[si];
+		jump = jumps[ji];
+		span = (start > isize ? start : isize) + jump + 1;
+
+		/* Run the word path from every base alignment */
+		img = buf + runs % 4;
+
+		memcpy(ref, orig, span);
+		memcpy(img, orig, span);
+
+		ref_xor_keystream(ref, isize, key, ksize, start, up, jump);
+		moxa_xor_keystream(img, isize, key, ksize, start, up, jump);
+
+		if (memcmp(ref, img, span)) {
+			printf("FAIL: size 0x%lx key 0x%lx start 0x%lx %s jump %lu\n",
+			       isize, ksize, start, up ? "UP" : "DOWN", jump);
+			fails++;
+		}
+
+		moxa_xor_keystream(img, isize, key, ksize, start, up, jump);
+
+		if (memcmp(orig, img, span)) {
+			printf("FAIL: size 0x%lx key 0x%lx start 0x%lx %s jump %lu: not reversible\n",
+			       isize, ksize, start, up ? "UP" : "DOWN", jump);
+			fails++;
+		}
+
+		runs++;
+	}
+
+	printf("%d runs, %d failures\n", runs, fails);
+
+	free(orig);
+	free(ref);
+	free(buf);
+	free(key);
+
+	return fails ? EXIT_FAILURE : EXIT_SUCCESS;
+}